@@ -0,0 +1,35 @@
+#include "Aot.h"
+#include "RomLibrary.h"
+#include <vector>
+
+//Filled during static initialization, so it has to be constructed on first use.
+static std::vector<AotProgram const*>& Programs()
+{
+	static std::vector<AotProgram const*> programs;
+	return programs;
+}
+
+void RegisterAotProgram(AotProgram const& program)
+{
+	Programs().push_back(&program);
+}
+
+//Only hashes the ROM if some program has its size, so builds without any translated ROM pay nothing.
+AotProgram const* FindAotProgram(uint8_t const* data, size_t size)
+{
+	uint64_t hash = 0;
+	bool hashed = false;
+	for (AotProgram const* program : Programs()) {
+		if (program->size != size) {
+			continue;
+		}
+		if (!hashed) {
+			hash = Xxh64(data, size);
+			hashed = true;
+		}
+		if (program->hash == hash) {
+			return program;
+		}
+	}
+	return nullptr;
+}
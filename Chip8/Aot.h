@@ -0,0 +1,70 @@
+//Ahead-of-time translated ROMs for Chip8::Core::Aot.
+//chip8_aot (AotCompiler.cpp) turns a whole ROM into C++: it follows the control flow from 0x200
+//through jumps, calls, returns and skips, and emits one straight-line block per entry it found.
+//Linking the generated file in registers the program, and every Chip8 that loads the same ROM
+//image runs it. What was not translated goes through the interpreter, one opcode at a time:
+//Bnnn and 00EE targets the compiler never saw, code outside the ROM, and any block the program
+//has overwritten since (until a rewind puts the original bytes back).
+
+#ifndef CHIP_8_AOT_H
+#define CHIP_8_AOT_H
+
+#include <cstddef>
+#include <cstdint>
+
+class Chip8;
+
+//The machine as translated code sees it. Opcodes that touch the display, the RNG or the caches
+//call back into the Chip8 they came from.
+struct AotContext
+{
+	uint8_t* registers;
+	uint8_t* memory;
+	uint16_t* index;
+	uint16_t* stack;
+	uint8_t* sPtr;
+	uint8_t* faults;			//Chip8::Fault bits
+	uint8_t* delay;
+	uint8_t* sound;
+	uint8_t const* input;
+	uint8_t const* stale;		//per block entry address, nonzero if its code was overwritten
+
+	Chip8* machine;
+	void (*draw)(Chip8& machine, uint8_t Vx, uint8_t Vy, uint8_t n);
+	void (*clear)(Chip8& machine);
+	uint8_t (*random)(Chip8& machine);
+	bool (*waitKey)(Chip8& machine, uint8_t Vx);
+	void (*written)(Chip8& machine, uint16_t address, unsigned int length);	//after Fx33/Fx55, updates stale
+};
+
+struct AotBlock
+{
+	uint16_t address;
+	uint16_t bytes;		//guest bytes translated, to find blocks hit by a write
+};
+
+struct AotProgram
+{
+	char const* name;
+	uint64_t hash;				//Xxh64 of the ROM image
+	size_t size;
+	uint8_t const* image;		//the ROM, to tell whether a written block still holds its original code
+	AotBlock const* blocks;
+	size_t blockCount;
+
+	//Runs translated blocks from `counter` while they fit in `cycles`, which it decrements.
+	//Returns the program counter where it stopped: out of cycles, or at an address it has no
+	//(current) code for.
+	uint16_t (*run)(AotContext& context, uint16_t counter, uint64_t& cycles);
+};
+
+void RegisterAotProgram(AotProgram const& program);
+AotProgram const* FindAotProgram(uint8_t const* data, size_t size);	//nullptr if that ROM was not translated
+
+//Generated files register themselves through a static one of these.
+struct AotRegistration
+{
+	explicit AotRegistration(AotProgram const& program) { RegisterAotProgram(program); }
+};
+
+#endif
@@ -0,0 +1,385 @@
+//chip8_aot: translates a ROM to C++ for Chip8::Core::Aot (see Aot.h).
+//
+//The control flow is recovered from 0x200: 1nnn and 2nnn targets, the return address after every
+//2nnn, both successors of every skip (3xkk..9xy0, Ex9E/ExA1) and of Fx0A. 00EE and Bnnn targets are
+//only known at runtime, so they go through a switch over every entry found, and anything else
+//lands back in the interpreter. Each entry starts a straight-line block that runs to the next
+//branch, the next entry, or MAX_BLOCK_LENGTH instructions, and is charged its full length up front.
+//Every opcode does exactly what the switch core does with it, invalid ones included (no-ops).
+
+#include "Chip8.h"
+#include "RomFile.h"
+#include "RomLibrary.h"
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+const unsigned int MAX_BLOCK_LENGTH = 32;	//instructions, so a block still fits in small Run() budgets
+
+struct Program
+{
+	uint8_t const* rom;
+	size_t size;
+
+	bool Contains(uint32_t address) const		//a whole opcode at `address` is ROM
+	{
+		return address >= START_ADDRESS && address + 2u <= START_ADDRESS + size;
+	}
+
+	uint16_t Opcode(uint32_t address) const
+	{
+		return (rom[address - START_ADDRESS] << 8u) | rom[address + 1u - START_ADDRESS];
+	}
+};
+
+//How an opcode leaves the block it is in.
+enum class Flow
+{
+	Next,		//falls through
+	Jump,		//1nnn
+	Call,		//2nnn
+	Return,		//00EE
+	Skip,		//3xkk, 4xkk, 5xy0, 9xy0, Ex9E, ExA1
+	Computed,	//Bnnn
+	KeyWait,	//Fx0A, repeats itself until a key is down
+};
+
+static Flow FlowOf(uint16_t op)
+{
+	switch (op >> 12u)
+	{
+		case 0x0: return (op & 0xFu) == 0xEu ? Flow::Return : Flow::Next;
+		case 0x1: return Flow::Jump;
+		case 0x2: return Flow::Call;
+		case 0x3: case 0x4: case 0x5: case 0x9: return Flow::Skip;
+		case 0xB: return Flow::Computed;
+		case 0xE: return ((op & 0xFu) == 0xEu || (op & 0xFu) == 0x1u) ? Flow::Skip : Flow::Next;
+		case 0xF: return (op & 0xFFu) == 0x0Au ? Flow::KeyWait : Flow::Next;
+	}
+	return Flow::Next;
+}
+
+//Addresses execution can continue at after the opcode at `address`, when they are known statically.
+static std::vector<uint32_t> Successors(uint32_t address, uint16_t op)
+{
+	switch (FlowOf(op))
+	{
+		case Flow::Next: return { address + 2u };
+		case Flow::Jump: return { op & 0xFFFu };
+		case Flow::Call: return { op & 0xFFFu, address + 2u };
+		case Flow::Skip: return { address + 2u, address + 4u };
+		case Flow::KeyWait: return { address, address + 2u };
+		case Flow::Return:
+		case Flow::Computed: break;
+	}
+	return {};
+}
+
+//Every address reachable from START_ADDRESS. Entries are where some branch lands.
+static std::set<uint32_t> FindEntries(Program const& program)
+{
+	std::set<uint32_t> entries{ START_ADDRESS };
+	std::vector<bool> visited(MEMORY_SIZE + 4);
+	std::vector<uint32_t> work{ START_ADDRESS };
+
+	while (!work.empty()) {
+		uint32_t address = work.back();
+		work.pop_back();
+		if (!program.Contains(address) || visited[address]) {
+			continue;
+		}
+		visited[address] = true;
+
+		uint16_t op = program.Opcode(address);
+		for (uint32_t next : Successors(address, op)) {
+			if (FlowOf(op) != Flow::Next) {
+				entries.insert(next);
+			}
+			work.push_back(next);
+		}
+	}
+
+	//Only entries with code behind them get a block
+	for (auto it = entries.begin(); it != entries.end();) {
+		it = program.Contains(*it) ? std::next(it) : entries.erase(it);
+	}
+	return entries;
+}
+
+static std::string Hex(unsigned int value, int digits = 3)
+{
+	char text[16];
+	std::snprintf(text, sizeof(text), "0x%0*X", digits, value);
+	return text;
+}
+
+static std::string Label(uint32_t address)
+{
+	char text[16];
+	std::snprintf(text, sizeof(text), "L%03X", address);
+	return text;
+}
+
+//Continues at a statically known address: straight to its block, or back to the caller.
+static std::string GoTo(std::set<uint32_t> const& entries, uint32_t address)
+{
+	if (entries.count(address) != 0) {
+		return "goto " + Label(address) + ";";
+	}
+	return "EXIT(" + Hex(address) + ");";
+}
+
+//Body of one opcode, the same operations in the same order as RunSwitch.
+//`done` is how many instructions of the block have run once this one has.
+static void EmitOpcode(std::ostream& out, std::set<uint32_t> const& entries, uint32_t block, unsigned int length,
+	unsigned int done, uint32_t address, uint16_t op)
+{
+	unsigned int x = (op >> 8u) & 0xFu;
+	unsigned int y = (op >> 4u) & 0xFu;
+	unsigned int kk = op & 0xFFu;
+	unsigned int nnn = op & 0xFFFu;
+	std::string Vx = "V[" + Hex(x, 1) + "]";
+	std::string Vy = "V[" + Hex(y, 1) + "]";
+	std::string next = Hex(address + 2u);
+	char opcode[8];
+	std::snprintf(opcode, sizeof(opcode), "%04X", op);
+
+	out << "\t//" << Hex(address) << ": " << opcode << "\n";
+	auto skipIf = [&](std::string const& condition) {
+		out << "\tif (" << condition << ") " << GoTo(entries, address + 4u) << "\n"
+			<< "\t" << GoTo(entries, address + 2u) << "\n";
+	};
+
+	switch (op >> 12u)
+	{
+		case 0x0:
+			if ((op & 0xFu) == 0x0u) {
+				out << "\tc.clear(*c.machine);\n";
+			} else if ((op & 0xFu) == 0xEu) {
+				out << "\tfaults |= ((int8_t)sPtr <= 0) * Chip8::FAULT_STACK_UNDERFLOW;\n\t--sPtr;\n\tpc = stack[sPtr & STACK_MASK];\n\tgoto dispatch;\n";
+			}
+			break;
+		case 0x1:
+			//A jump to itself would be a loop with no side effect, which the C++ compiler folds into a
+			//single subtraction from `left`. Leave it to the caller instead, like any Idle::Halt.
+			out << "\t" << (nnn == address ? "EXIT(" + Hex(address) + ");" : GoTo(entries, nnn)) << "\n";
+			break;
+		case 0x2:
+			out << "\tfaults |= ((int8_t)sPtr >= (int)STACK_SIZE) * Chip8::FAULT_STACK_OVERFLOW;\n"
+				<< "\tstack[sPtr & STACK_MASK] = " << next << ";\n\t++sPtr;\n\t" << GoTo(entries, nnn) << "\n";
+			break;
+		case 0x3: skipIf(Vx + " == " + Hex(kk, 2)); break;
+		case 0x4: skipIf(Vx + " != " + Hex(kk, 2)); break;
+		case 0x5: skipIf(Vx + " == " + Vy); break;
+		case 0x6: out << "\t" << Vx << " = " << Hex(kk, 2) << ";\n"; break;
+		case 0x7: out << "\t" << Vx << " += " << Hex(kk, 2) << ";\n"; break;
+		case 0x8:
+			switch (op & 0xFu)
+			{
+				case 0x0: out << "\t" << Vx << " = " << Vy << ";\n"; break;
+				case 0x1: out << "\t" << Vx << " |= " << Vy << ";\n"; break;
+				case 0x2: out << "\t" << Vx << " &= " << Vy << ";\n"; break;
+				case 0x3: out << "\t" << Vx << " ^= " << Vy << ";\n"; break;
+				case 0x4:
+					out << "\t{ unsigned int sum = " << Vx << " + " << Vy << "; V[0xF] = sum > 255u; " << Vx << " = sum & 0xFFu; }\n";
+					break;
+				case 0x5: out << "\tV[0xF] = " << Vx << " > " << Vy << ";\n\t" << Vx << " -= " << Vy << ";\n"; break;
+				case 0x6: out << "\tV[0xF] = " << Vx << " & 0x1u;\n\t" << Vx << " >>= 1;\n"; break;
+				case 0x7: out << "\tV[0xF] = " << Vy << " > " << Vx << ";\n\t" << Vx << " = " << Vy << " - " << Vx << ";\n"; break;
+				case 0xE: out << "\tV[0xF] = (" << Vx << " & 0x80u) >> 7u;\n\t" << Vx << " <<= 1;\n"; break;
+			}
+			break;
+		case 0x9: skipIf(Vx + " != " + Vy); break;
+		case 0xA: out << "\tI = " << Hex(nnn) << ";\n"; break;
+		case 0xB: out << "\tpc = " << Hex(nnn) << " + V[0x0];\n\tgoto dispatch;\n"; break;
+		case 0xC: out << "\t" << Vx << " = c.random(*c.machine) & " << Hex(kk, 2) << ";\n"; break;
+		case 0xD: out << "\tc.draw(*c.machine, " << Hex(x, 1) << ", " << Hex(y, 1) << ", " << Hex(op & 0xFu, 1) << ");\n"; break;
+		case 0xE:
+			if ((op & 0xFu) == 0xEu) {
+				skipIf("c.input[" + Vx + " & KEY_MASK]");
+			} else if ((op & 0xFu) == 0x1u) {
+				skipIf("!c.input[" + Vx + " & KEY_MASK]");
+			}
+			break;
+		case 0xF:
+		{
+			//Writes: if the block that is running was overwritten, the rest of it goes to the interpreter
+			std::string leave = "\tif (stale[" + Hex(block) + "]) { left += " + std::to_string(length - done)
+				+ "; EXIT(" + next + "); }\n";
+			switch (kk)
+			{
+				case 0x07: out << "\t" << Vx << " = delay;\n"; break;
+				case 0x0A:
+					out << "\tif (!c.waitKey(*c.machine, " << Hex(x, 1) << ")) " << GoTo(entries, address) << "\n"
+						<< "\t" << GoTo(entries, address + 2u) << "\n";
+					break;
+				case 0x15: out << "\tdelay = " << Vx << ";\n"; break;
+				case 0x18: out << "\tsound = " << Vx << ";\n"; break;
+				case 0x1E: out << "\tI += " << Vx << ";\n"; break;
+				case 0x29: out << "\tI = FONTSET_START + (5 * " << Vx << ");\n"; break;
+				case 0x33:
+					out << "\t{ uint8_t value = " << Vx << "; mem[(I + 2) & MEMORY_MASK] = value % 10; mem[(I + 1) & MEMORY_MASK] = (value / 10) % 10; mem[I & MEMORY_MASK] = value / 100; }\n"
+						<< "\tc.written(*c.machine, I, 3);\n" << leave;
+					break;
+				case 0x55:
+					out << "\tfor (unsigned int i = 0; i <= " << x << "; i++) { mem[(I + i) & MEMORY_MASK] = V[i]; }\n"
+						<< "\tc.written(*c.machine, I, " << x + 1 << ");\n" << leave;
+					break;
+				case 0x65:
+					out << "\tfor (unsigned int i = 0; i <= " << x << "; i++) { V[i] = mem[(I + i) & MEMORY_MASK]; }\n";
+					break;
+			}
+		} break;
+	}
+}
+
+static std::string Identifier(std::string const& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	std::string name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+	name = name.substr(0, name.find('.'));
+	for (char& c : name) {
+		if (!std::isalnum((unsigned char)c)) {
+			c = '_';
+		}
+	}
+	if (name.empty() || std::isdigit((unsigned char)name[0])) {
+		name = "rom_" + name;
+	}
+	return name;
+}
+
+static void Usage(char const* name)
+{
+	std::cerr << "Usage: " << name << " <ROM> <output.cpp> [--name identifier]\n"
+		<< "  Translates a chip8 ROM to C++ for the aot core. Link the output into any program using chip8core.\n";
+	std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		Usage(argv[0]);
+	}
+	char const* romName = argv[1];
+	char const* outputName = argv[2];
+	std::string name = Identifier(romName);
+	for (int i = 3; i < argc; i++) {
+		if (std::strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+			name = argv[++i];
+		} else {
+			Usage(argv[0]);
+		}
+	}
+
+	RomFile rom;
+	RomError error = rom.Open(romName);
+	if (error != RomError::None) {
+		std::cerr << "Could not load " << romName << ": " << RomErrorText(error) << "\n";
+		return EXIT_FAILURE;
+	}
+	Program program{ rom.Data(), rom.Size() };
+
+	//Blocks are cut at the next entry, and long runs are split into more entries
+	std::set<uint32_t> entries = FindEntries(program);
+	struct Block { uint32_t address; std::vector<uint16_t> ops; };
+	std::vector<Block> blocks;
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		Block block{ *it, {} };
+		uint32_t address = block.address;
+		for (;;) {
+			uint16_t op = program.Opcode(address);
+			block.ops.push_back(op);
+			address += 2;
+			if (FlowOf(op) != Flow::Next || entries.count(address) != 0 || !program.Contains(address)) {
+				break;
+			}
+			if (block.ops.size() == MAX_BLOCK_LENGTH) {
+				entries.insert(address);	//after `it`, so its block comes later in this loop
+				break;
+			}
+		}
+		blocks.push_back(block);
+	}
+
+	bool computed = false;		//any 00EE or Bnnn, which go back through the switch
+	for (Block const& block : blocks) {
+		Flow flow = FlowOf(block.ops.back());
+		computed = computed || flow == Flow::Return || flow == Flow::Computed;
+	}
+
+	char hash[32];
+	std::snprintf(hash, sizeof(hash), "0x%016llXull", (unsigned long long)Xxh64(program.rom, program.size));
+
+	std::ostringstream out;
+	unsigned int instructions = 0;
+	out << "//Generated by chip8_aot from " << romName << ", do not edit.\n"
+		<< "\n#include \"Aot.h\"\n#include \"Chip8.h\"\n#include <cstdint>\n\n"
+		<< "namespace {\n\n";
+
+	out << "uint8_t const image[] = {";
+	for (size_t i = 0; i < program.size; i++) {
+		out << (i % 16 == 0 ? "\n\t" : " ") << Hex(program.rom[i], 2) << ",";
+	}
+	out << "\n};\n\nAotBlock const blocks[] = {\n";
+	for (Block const& block : blocks) {
+		out << "\t{ " << Hex(block.address) << ", " << block.ops.size() * 2 << " },\n";
+	}
+	out << "};\n\n";
+
+	out << "#define EXIT(address) do { cycles = left; return (address); } while (0)\n\n"
+		<< "uint16_t Run(AotContext& c, uint16_t counter, uint64_t& cycles)\n{\n"
+		<< "\tuint8_t* const V = c.registers;\n"
+		<< "\tuint8_t* const mem = c.memory;\n"
+		<< "\tuint16_t& I = *c.index;\n"
+		<< "\t[[maybe_unused]] uint16_t* const stack = c.stack;\n"
+		<< "\t[[maybe_unused]] uint8_t& sPtr = *c.sPtr;\n"
+		<< "\t[[maybe_unused]] uint8_t& faults = *c.faults;\n"
+		<< "\t[[maybe_unused]] uint8_t& delay = *c.delay;\n"
+		<< "\t[[maybe_unused]] uint8_t& sound = *c.sound;\n"
+		<< "\tuint8_t const* const stale = c.stale;\n"
+		<< "\tuint64_t left = cycles;\n"
+		<< "\tuint32_t pc = counter;\n\n"
+		<< (computed ? "dispatch:\n" : "") << "\tswitch (pc)\n\t{\n";
+	for (Block const& block : blocks) {
+		out << "\t\tcase " << Hex(block.address) << ": goto " << Label(block.address) << ";\n";
+	}
+	out << "\t\tdefault: EXIT(pc);\n\t}\n";
+
+	for (Block const& block : blocks) {
+		unsigned int length = (unsigned int)block.ops.size();
+		instructions += length;
+		out << "\n" << Label(block.address) << ":\n"
+			<< "\tif (stale[" << Hex(block.address) << "] || left < " << length << ") EXIT(" << Hex(block.address) << ");\n"
+			<< "\tleft -= " << length << ";\n";
+		for (unsigned int i = 0; i < length; i++) {
+			EmitOpcode(out, entries, block.address, length, i + 1, block.address + 2 * i, block.ops[i]);
+		}
+		uint32_t end = block.address + 2 * length;
+		if (FlowOf(block.ops.back()) == Flow::Next) {
+			out << "\t" << GoTo(entries, end) << "\n";
+		}
+	}
+	out << "}\n\n#undef EXIT\n\n"
+		<< "AotProgram const program = {\n"
+		<< "\t\"" << name << "\", " << hash << ", " << program.size << ",\n"
+		<< "\timage, blocks, sizeof(blocks) / sizeof(blocks[0]), Run,\n};\n\n"
+		<< "AotRegistration registration(program);\n\n}\n";
+
+	std::ofstream file(outputName, std::ios::binary);
+	file << out.str();
+	if (!file.flush()) {
+		std::cerr << "Could not write " << outputName << "\n";
+		return EXIT_FAILURE;
+	}
+	std::cout << romName << ": " << blocks.size() << " blocks, " << instructions << " instructions -> " << outputName << "\n";
+	return 0;
+}
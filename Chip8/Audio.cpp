@@ -0,0 +1,106 @@
+#include "Audio.h"
+#include "Scheduler.h"
+#include <algorithm>
+
+const int16_t BEEP_LEVEL = 6000;			//about -15 dBFS, a square wave is loud
+const unsigned int TARGET_FRAMES = 3;		//device buffer level that RateAdjust() steers towards
+const double MAX_RATE_ADJUST = 0.005;		//pitch shifts under 0.5% are inaudible
+
+static void PutLittle(std::ofstream& file, uint32_t value, int bytes)
+{
+	for (int i = 0; i < bytes; i++) {
+		file.put((char)((value >> (8 * i)) & 0xFFu));
+	}
+}
+
+WavAudio::~WavAudio()
+{
+	Close();
+}
+
+bool WavAudio::Open(char const* filename, unsigned int sampleRate)
+{
+	file.open(filename, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		return false;
+	}
+
+	//Canonical 44 byte header. The two sizes are zero until Close() knows them.
+	dataBytes = 0;
+	file.write("RIFF", 4);
+	PutLittle(file, 0, 4);
+	file.write("WAVEfmt ", 8);
+	PutLittle(file, 16, 4);					//fmt chunk size
+	PutLittle(file, 1, 2);					//PCM
+	PutLittle(file, 1, 2);					//mono
+	PutLittle(file, sampleRate, 4);
+	PutLittle(file, sampleRate * 2, 4);		//bytes per second
+	PutLittle(file, 2, 2);					//bytes per sample frame
+	PutLittle(file, 16, 2);					//bits per sample
+	file.write("data", 4);
+	PutLittle(file, 0, 4);
+	return (bool)file;
+}
+
+void WavAudio::Write(int16_t const* samples, size_t count)
+{
+	if (!file.is_open()) {
+		return;
+	}
+	for (size_t i = 0; i < count; i++) {
+		PutLittle(file, (uint16_t)samples[i], 2);
+	}
+	dataBytes += (uint32_t)(count * 2);
+}
+
+bool WavAudio::Close()
+{
+	if (!file.is_open()) {
+		return true;
+	}
+	file.seekp(4);
+	PutLittle(file, 36 + dataBytes, 4);
+	file.seekp(40);
+	PutLittle(file, dataBytes, 4);
+	bool good = (bool)file;
+	file.close();
+	return good;
+}
+
+Beeper::Beeper(AudioSink& sink, unsigned int sampleRate, unsigned int tone)
+	: sink(sink), sampleRate(sampleRate), level(BEEP_LEVEL),
+	step((uint32_t)(((uint64_t)tone << 32u) / sampleRate)),
+	targetBuffered(sampleRate * TARGET_FRAMES / FRAME_RATE)
+{}
+
+//Frame n ends at sample n * rate / 60 exactly, so 44100hz gets 735 per frame and rates that do not
+//divide evenly alternate between the two nearest counts instead of drifting.
+void Beeper::Frame(bool on)
+{
+	frames++;
+	size_t count = (size_t)(frames * sampleRate / FRAME_RATE - samples);
+	samples += count;
+	scratch.resize(count);
+
+	if (!on) {
+		phase = 0;		//every beep starts on the same edge
+		std::fill(scratch.begin(), scratch.end(), (int16_t)0);
+	} else {
+		for (size_t i = 0; i < count; i++) {
+			scratch[i] = (phase & 0x80000000u) ? (int16_t)-level : level;
+			phase += step;
+		}
+	}
+	sink.Write(scratch.data(), count);
+}
+
+//Proportional control: a buffer at the target leaves the 60hz period alone, an empty one runs
+//emulation 0.5% fast and a buffer twice the target (or more) runs it 0.5% slow.
+double Beeper::RateAdjust() const
+{
+	if (!sink.Realtime()) {
+		return 1.0;
+	}
+	double error = ((double)sink.Buffered() - (double)targetBuffered) / (double)targetBuffered;
+	return 1.0 + MAX_RATE_ADJUST * std::min(1.0, std::max(-1.0, error));
+}
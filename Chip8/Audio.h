@@ -0,0 +1,77 @@
+//Beeper. The Chip8 has a single tone that sounds while the sound timer is above zero; Beeper turns
+//that into a square wave one 60hz frame at a time and hands the samples to an AudioSink.
+//
+//Sinks: NullAudio (discards, for timing), WavAudio (a file, for headless tests) and SdlAudio
+//(SdlAudio.h, the real device). The device consumes samples at its own clock; RateAdjust() says
+//how much to stretch the frame period so emulation follows that clock and the buffer neither
+//runs dry nor overflows (dynamic rate control).
+
+#ifndef CHIP_8_AUDIO_H
+#define CHIP_8_AUDIO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+const unsigned int DEFAULT_SAMPLE_RATE = 44100;
+const unsigned int DEFAULT_TONE = 440;			//Hz
+
+class AudioSink
+{
+	public:
+		virtual ~AudioSink() = default;
+		virtual void Write(int16_t const* samples, size_t count) = 0;
+		virtual size_t Buffered() const { return 0; }	//samples written but not played yet
+		virtual bool Realtime() const { return false; }	//played by a device clock, so Buffered() can pace emulation
+};
+
+class NullAudio : public AudioSink
+{
+	public:
+		void Write(int16_t const*, size_t count) override { written += count; }
+		uint64_t Written() const { return written; }
+
+	private:
+		uint64_t written{};
+};
+
+//16-bit mono PCM. The header's sizes are filled in by Close() (or the destructor).
+class WavAudio : public AudioSink
+{
+	public:
+		~WavAudio() override;
+		bool Open(char const* filename, unsigned int sampleRate = DEFAULT_SAMPLE_RATE);
+		bool Close();
+		void Write(int16_t const* samples, size_t count) override;
+
+	private:
+		std::ofstream file;
+		uint32_t dataBytes{};
+};
+
+class Beeper
+{
+	public:
+		explicit Beeper(AudioSink& sink, unsigned int sampleRate = DEFAULT_SAMPLE_RATE, unsigned int tone = DEFAULT_TONE);
+
+		void Frame(bool on);	//one frame of samples: the tone if on, else silence. The phase carries across frames.
+
+		//Factor for Scheduler::SetRateAdjust, from how full the sink's buffer is against its target
+		//(a few frames). Above 1 slows emulation down, below 1 speeds it up, never more than 0.5%.
+		double RateAdjust() const;
+		size_t TargetBuffered() const { return targetBuffered; }
+
+	private:
+		AudioSink& sink;
+		unsigned int sampleRate;
+		int16_t level;
+		uint32_t phase{};			//fraction of a period, 2^32 = one period
+		uint32_t step;				//phase advance per sample
+		uint64_t frames{};
+		uint64_t samples{};			//written so far, to spread the fractional samples per frame evenly
+		size_t targetBuffered;
+		std::vector<int16_t> scratch;
+};
+
+#endif
@@ -0,0 +1,206 @@
+//Batch runner. Pushes many independent ROM sessions through a work-stealing pool on every core
+//and prints one CSV line per run with its final state. Each ROM runs on the machine its detected
+//platform needs (RomInfo::profile): Chip8, SuperChip8 or XoChip8.
+
+#include "BatchRunner.h"
+#include "RomLibrary.h"
+#include "Scheduler.h"
+#include "ThreadPool.h"
+#include "WideChip8.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+const unsigned int DEFAULT_RUNS = 1000;
+const uint64_t DEFAULT_BUDGET = 100000;
+
+static void Usage(char const* name)
+{
+	std::cerr << "Usage: " << name << " [options] <ROM or directory>...\n"
+		<< "  -n <runs>       runs per ROM (default " << DEFAULT_RUNS << ")\n"
+		<< "  -j <threads>    worker threads (default: one per hardware thread)\n"
+		<< "  -i <count>      instruction budget per run (default " << DEFAULT_BUDGET << ")\n"
+		<< "  --ipf <count>   instructions per frame (default " << DEFAULT_INSTRUCTIONS_PER_FRAME << ")\n"
+		<< "  --seed <n>      RNG seed of the first run, run k uses seed + k (default 1)\n"
+		<< "  --input <file>  input script, one \"<frame> <key> <pressed>\" per line\n"
+		<< "  --state <file>  start every run from this save state instead of reset (chip8 ROMs only)\n"
+		<< "  --core <name>   interpreter core for chip8 ROMs: table, switch, cached, jit\n"
+		<< "  --index <file>  ROM index to reuse and update, so unchanged ROMs are not read again\n"
+		<< "  --wide          run chip8 seeds " << WIDE_LANES << " at a time on the lockstep SIMD core\n"
+		<< "  -q              summary only, no per-run CSV\n";
+	std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int runs = DEFAULT_RUNS;
+	unsigned int threads = 0;
+	uint32_t seed = 1;
+	bool quiet = false;
+	bool wide = false;
+	BatchJob base;
+	base.instructions = DEFAULT_BUDGET;
+	base.instructionsPerFrame = DEFAULT_INSTRUCTIONS_PER_FRAME;
+	std::vector<std::string> romNames;
+	char const* indexName = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = (i + 1 < argc);
+
+		if (std::strcmp(argv[i], "-q") == 0) {
+			quiet = true;
+		} else if (std::strcmp(argv[i], "--wide") == 0) {
+			wide = true;
+		} else if (argv[i][0] == '-' && !hasValue) {
+			Usage(argv[0]);
+		} else if (std::strcmp(argv[i], "-n") == 0) {
+			runs = std::stoul(argv[++i]);
+		} else if (std::strcmp(argv[i], "-j") == 0) {
+			threads = std::stoul(argv[++i]);
+		} else if (std::strcmp(argv[i], "-i") == 0) {
+			base.instructions = std::stoull(argv[++i]);
+		} else if (std::strcmp(argv[i], "--ipf") == 0) {
+			base.instructionsPerFrame = std::stoul(argv[++i]);
+		} else if (std::strcmp(argv[i], "--seed") == 0) {
+			seed = std::stoul(argv[++i]);
+		} else if (std::strcmp(argv[i], "--input") == 0) {
+			InputScript script;
+			if (!LoadInputScript(argv[++i], script)) {
+				std::cerr << "Could not read input script " << argv[i] << "\n";
+				return EXIT_FAILURE;
+			}
+			base.input = std::make_shared<InputScript const>(std::move(script));
+		} else if (std::strcmp(argv[i], "--state") == 0) {
+			//Loaded through a scratch machine, which also checks the version
+			Chip8 loader;
+			auto snapshot = std::make_shared<Snapshot>();
+			if (!loader.LoadState(argv[++i])) {
+				std::cerr << "Could not load save state " << argv[i] << "\n";
+				return EXIT_FAILURE;
+			}
+			loader.SaveState(*snapshot);
+			base.start = snapshot;
+		} else if (std::strcmp(argv[i], "--index") == 0) {
+			indexName = argv[++i];
+		} else if (std::strcmp(argv[i], "--core") == 0) {
+			if (!Chip8::CoreFromName(argv[++i], base.core)) {
+				Usage(argv[0]);
+			}
+		} else if (argv[i][0] == '-') {
+			Usage(argv[0]);
+		} else {
+			romNames.push_back(argv[i]);
+		}
+	}
+
+	if (romNames.empty() || base.instructionsPerFrame == 0) {
+		Usage(argv[0]);
+	}
+
+	//Directories are expanded through the library, which only opens ROMs the index does not know yet.
+	RomLibrary library;
+	if (indexName) {
+		library.LoadIndex(indexName);
+	}
+	std::vector<RomInfo> roms;
+	for (std::string const& name : romNames) {
+		if (std::filesystem::is_directory(name)) {
+			size_t rejected = library.Scan(name, roms);
+			if (rejected > 0) {
+				std::cerr << "Skipped " << rejected << " unusable ROMs in " << name << "\n";
+			}
+			continue;
+		}
+
+		RomError error;
+		RomInfo const* rom = library.Add(name, error);
+		if (!rom) {
+			std::cerr << "Could not load " << name << ": " << RomErrorText(error) << "\n";
+			return EXIT_FAILURE;
+		}
+		roms.push_back(*rom);
+	}
+	if (indexName && !library.SaveIndex(indexName)) {
+		std::cerr << "Could not write ROM index " << indexName << "\n";
+	}
+
+	//A save state is a classic machine's, it cannot start a SUPER-CHIP or XO-CHIP run
+	if (base.start) {
+		size_t extended = roms.size();
+		roms.erase(std::remove_if(roms.begin(), roms.end(), [](RomInfo const& rom) { return rom.profile != RomProfile::Chip8; }),
+			roms.end());
+		extended -= roms.size();
+		if (extended > 0) {
+			std::cerr << "Skipped " << extended << " schip/xochip ROMs, --state only applies to chip8 ROMs\n";
+		}
+	}
+
+	//Every ROM is read once, all of its runs (and all copies of it) share the same image.
+	std::vector<BatchJob> jobs;
+	std::vector<size_t> romOfJob;
+	for (size_t r = 0; r < roms.size(); r++) {
+		auto rom = library.Image(roms[r]);
+		if (!rom) {
+			std::cerr << "Could not load " << roms[r].path << ": file changed while scanning\n";
+			return EXIT_FAILURE;
+		}
+
+		for (unsigned int k = 0; k < runs; k++) {
+			BatchJob job = base;
+			job.rom = rom;
+			job.seed = seed + k;
+			job.profile = roms[r].profile;
+			jobs.push_back(job);
+			romOfJob.push_back(r);
+		}
+	}
+	if (jobs.empty()) {
+		std::cerr << "No ROMs found\n";
+		return EXIT_FAILURE;
+	}
+
+	ThreadPool pool(threads);
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<BatchResult> results = RunBatch(jobs, pool, wide);
+	auto end = std::chrono::steady_clock::now();
+
+	uint64_t totalInstructions = 0;
+	for (size_t i = 0; i < results.size(); i++) {
+		BatchResult const& result = results[i];
+		totalInstructions += result.instructions;
+
+		if (quiet) {
+			continue;
+		}
+
+		if (i == 0) {
+			std::printf("rom,seed,instructions,frames,pc,index");
+			for (unsigned int v = 0; v < REGISTER_COUNT; v++) {
+				std::printf(",v%X", v);
+			}
+			std::printf(",display_hash\n");
+		}
+
+		std::printf("%s,%u,%llu,%llu,0x%03X,0x%03X", roms[romOfJob[i]].path.c_str(), jobs[i].seed,
+			(unsigned long long)result.instructions, (unsigned long long)result.frames, result.counter, result.index);
+		for (unsigned int v = 0; v < REGISTER_COUNT; v++) {
+			std::printf(",%u", result.registers[v]);
+		}
+		std::printf(",%016llx\n", (unsigned long long)result.displayHash);
+	}
+
+	double seconds = std::chrono::duration<double>(end - start).count();
+	std::fprintf(stderr, "%zu ROMs, %zu read from disk\n", roms.size(), library.FilesRead());
+	std::fprintf(stderr, "%zu runs on %u threads in %.3f s: %.0f runs/s, %.0f instructions/s\n",
+		results.size(), pool.Threads(), seconds, results.size() / seconds, totalInstructions / seconds);
+
+	return 0;
+}
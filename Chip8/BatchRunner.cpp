@@ -0,0 +1,191 @@
+#include "BatchRunner.h"
+#include "Chip8Pool.h"
+#include "ExtendedChip8.h"
+#include "ThreadPool.h"
+#include "WideChip8.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+
+bool LoadInputScript(char const* filename, InputScript& script)
+{
+	InputLog log;
+	if (log.Load(filename)) {
+		script = log.events;
+		return true;
+	}
+
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line)) {
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream fields(line);
+		uint64_t frame;
+		unsigned int key, pressed;
+		if (!(fields >> frame >> std::hex >> key >> std::dec >> pressed)) {
+			continue;	//blank or comment line
+		}
+		if (key >= KEY_COUNT) {
+			return false;
+		}
+		script.push_back(InputEvent{ frame, (uint8_t)key, (uint8_t)(pressed != 0) });
+	}
+
+	std::stable_sort(script.begin(), script.end(),
+		[](InputEvent const& a, InputEvent const& b) { return a.frame < b.frame; });
+	return true;
+}
+
+//Same frame structure as Scheduler::RunFrame (instructions, then one timer tick), without pacing.
+//Machine is Chip8, SuperChip8 or XoChip8, loaded and seeded.
+template <typename Machine>
+static BatchResult RunFrames(Machine& machine, BatchJob const& job)
+{
+	size_t nextEvent = 0;
+	uint64_t executed = 0;
+	uint64_t frames = 0;
+	while (executed < job.instructions) {
+		if (job.input) {
+			InputScript const& input = *job.input;
+			for (; nextEvent < input.size() && input[nextEvent].frame <= frames; nextEvent++) {
+				machine.input[input[nextEvent].key] = input[nextEvent].pressed;
+			}
+		}
+
+		uint64_t count = std::min<uint64_t>(job.instructionsPerFrame, job.instructions - executed);
+		machine.Run(count - machine.SkipIdle(count));
+		machine.TickTimers();
+		executed += count;
+		frames++;
+	}
+
+	BatchResult result;
+	for (unsigned int i = 0; i < REGISTER_COUNT; i++) {
+		result.registers[i] = machine.Register(i);
+	}
+	result.counter = machine.ProgramCounter();
+	result.index = machine.Index();
+	result.displayHash = machine.DisplayHash();
+	result.instructions = executed;
+	result.frames = frames;
+	return result;
+}
+
+template <typename Machine>
+static BatchResult RunExtendedJob(BatchJob const& job)
+{
+	std::unique_ptr<Machine> machine = std::make_unique<Machine>();	//XO-CHIP's 64 KB is too large for a worker's stack
+	machine->LoadROM(job.rom->data(), job.rom->size());
+	machine->Seed(job.seed);
+	return RunFrames(*machine, job);
+}
+
+//Chip8 machines come from a pool per worker thread, so a sweep of short jobs is not dominated by construction.
+BatchResult RunBatchJob(BatchJob const& job)
+{
+	if (job.profile == RomProfile::SuperChip) {
+		return RunExtendedJob<SuperChip8>(job);
+	}
+	if (job.profile == RomProfile::XoChip) {
+		return RunExtendedJob<XoChip8>(job);
+	}
+
+	thread_local Chip8Pool machines;
+	std::unique_ptr<Chip8> machine = machines.Acquire();
+	Chip8& chip8 = *machine;
+	chip8.SetCore(job.core);
+	chip8.LoadROM(job.rom->data(), job.rom->size());
+	if (job.start) {
+		chip8.LoadState(*job.start);
+	}
+	chip8.Seed(job.seed);		//after the snapshot, so every run in a sweep still gets its own numbers
+
+	BatchResult result = RunFrames(chip8, job);
+	machines.Release(std::move(machine));
+	return result;
+}
+
+//Same frame loop as RunBatchJob, every lane getting the same input.
+void RunWideBatchJobs(BatchJob const* jobs, size_t count, BatchResult* results)
+{
+	std::unique_ptr<WideChip8> wide(new WideChip8());	//too large for a worker's stack
+	BatchJob const& job = jobs[0];
+
+	wide->LoadROM(job.rom->data(), job.rom->size());
+	for (size_t l = 0; l < count; l++) {
+		if (job.start) {
+			wide->LoadState((unsigned int)l, *job.start);
+		}
+		wide->Seed((unsigned int)l, jobs[l].seed);
+	}
+
+	size_t nextEvent = 0;
+	uint64_t executed = 0;
+	uint64_t frames = 0;
+	while (executed < job.instructions) {
+		if (job.input) {
+			InputScript const& input = *job.input;
+			for (; nextEvent < input.size() && input[nextEvent].frame <= frames; nextEvent++) {
+				for (unsigned int l = 0; l < WIDE_LANES; l++) {
+					wide->input[l][input[nextEvent].key] = input[nextEvent].pressed;
+				}
+			}
+		}
+
+		uint64_t frameCount = std::min<uint64_t>(job.instructionsPerFrame, job.instructions - executed);
+		wide->Run(frameCount);
+		wide->TickTimers();
+		executed += frameCount;
+		frames++;
+	}
+
+	for (size_t l = 0; l < count; l++) {
+		BatchResult& result = results[l];
+		for (unsigned int i = 0; i < REGISTER_COUNT; i++) {
+			result.registers[i] = wide->Register((unsigned int)l, i);
+		}
+		result.counter = wide->ProgramCounter((unsigned int)l);
+		result.index = wide->Index((unsigned int)l);
+		result.displayHash = wide->DisplayHash((unsigned int)l);
+		result.instructions = executed;
+		result.frames = frames;
+	}
+}
+
+static bool SameSweep(BatchJob const& a, BatchJob const& b)
+{
+	return a.rom == b.rom && a.input == b.input && a.start == b.start && a.instructions == b.instructions
+		&& a.instructionsPerFrame == b.instructionsPerFrame;
+}
+
+//Jobs share nothing but the read-only ROM and input images, and each writes only its own result
+//slot, so throughput scales with the number of workers.
+std::vector<BatchResult> RunBatch(std::vector<BatchJob> const& jobs, ThreadPool& pool, bool wide)
+{
+	std::vector<BatchResult> results(jobs.size());
+
+	for (size_t i = 0; i < jobs.size();) {
+		size_t count = 1;
+		bool lanes = wide && jobs[i].profile == RomProfile::Chip8;
+		while (lanes && count < WIDE_LANES && i + count < jobs.size() && SameSweep(jobs[i], jobs[i + count])) {
+			count++;
+		}
+
+		if (lanes) {
+			pool.Submit([&jobs, &results, i, count] { RunWideBatchJobs(&jobs[i], count, &results[i]); });
+		} else {
+			pool.Submit([&jobs, &results, i] { results[i] = RunBatchJob(jobs[i]); });
+		}
+		i += count;
+	}
+	pool.Wait();
+
+	return results;
+}
@@ -0,0 +1,54 @@
+//Runs many independent sessions across all cores, on Chip8 or, for SUPER-CHIP and XO-CHIP ROMs,
+//on the machines in ExtendedChip8.h.
+//Every job gets its own machine, RNG seed, input script and instruction budget, and reports
+//the final machine state, so regression and fuzz campaigns can compare runs by value.
+
+#ifndef CHIP_8_BATCH_RUNNER_H
+#define CHIP_8_BATCH_RUNNER_H
+
+#include "Chip8.h"
+#include "InputLog.h"
+#include "RomLibrary.h"
+#include "Snapshot.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+//Text format, one event per line: "<frame> <key in hex> <1 = pressed, 0 = released>". '#' starts a comment.
+//A binary input log recorded by the front-end (InputLog.h) is accepted too.
+bool LoadInputScript(char const* filename, InputScript& script);
+
+struct BatchJob
+{
+	std::shared_ptr<std::vector<uint8_t> const> rom;	//shared by every job running the same ROM
+	std::shared_ptr<InputScript const> input;			//sorted by frame, may be null
+	std::shared_ptr<Snapshot const> start;				//state to start from instead of reset, may be null. Chip8 only
+	uint32_t seed{};
+	uint64_t instructions{};							//budget, the last frame is cut short to fit
+	unsigned int instructionsPerFrame{ 10 };
+	Chip8::Core core{ Chip8::CHIP8_DEFAULT_CORE };		//Chip8 only, the extended machines have one core
+	RomProfile profile{ RomProfile::Chip8 };			//which machine runs the job
+};
+
+struct BatchResult
+{
+	uint8_t registers[REGISTER_COUNT];
+	uint16_t counter;
+	uint16_t index;
+	uint64_t displayHash;
+	uint64_t instructions;	//executed
+	uint64_t frames;		//timer ticks
+};
+
+BatchResult RunBatchJob(BatchJob const& job);
+
+//Up to WIDE_LANES jobs on one WideChip8. They must share ROM, input, budget and frame size,
+//only the seeds differ (a seed sweep). `core` is ignored.
+void RunWideBatchJobs(BatchJob const* jobs, size_t count, BatchResult* results);
+
+//With `wide`, consecutive Chip8 jobs that differ only by seed are packed into RunWideBatchJobs calls.
+std::vector<BatchResult> RunBatch(std::vector<BatchJob> const& jobs, ThreadPool& pool, bool wide = false);
+
+#endif
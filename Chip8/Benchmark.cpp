@@ -0,0 +1,353 @@
+//Throughput benchmark suite. Runs every ROM in "ROM Tests" for a fixed instruction count
+//and reports the median of several runs, so numbers are comparable between builds.
+//A ROM that halts (1nnn to itself) before the count is only reported, not timed: past the halt every
+//core would be timing the same one-instruction loop. bench_loop.ch8 is the workload that never halts.
+//Each ROM is timed on every interpreter core to compare dispatch strategies directly,
+//and the table core against its unchecked build (Chip8::RunUnchecked) to show what the masks cost.
+//then as a 32-seed sweep: 32 separate machines against one WideChip8, with a check that the lanes
+//really diverged (bench_loop.ch8 draws at Cxkk positions, so every seed ends on its own display).
+//Then the cost of a save state round trip (Chip8::SaveState + LoadState) and of recording
+//ten minutes of rewind history. Last, the software renderer drawing a full frame at common scales.
+
+#include "Aot.h"
+#include "Chip8.h"
+#include "Renderer.h"
+#include "Rewind.h"
+#include "Scheduler.h"
+#include "Snapshot.h"
+#include "WideChip8.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifndef CHIP8_ROM_DIR
+#define CHIP8_ROM_DIR "ROM Tests"
+#endif
+
+const uint64_t BENCH_INSTRUCTIONS = 20000000;
+const int BENCH_REPEATS = 5;
+const int BENCH_SNAPSHOTS = 1000000;
+const int BENCH_REWIND_FRAMES = 60 * 60 * 10;
+const unsigned int BENCH_REWIND_IPF = 34;	//one bench_loop.ch8 iteration, so one Dxyn per frame
+const int BENCH_RENDER_FRAMES = 2000;
+const uint64_t BENCH_HALT_CHUNK = 64;	//instructions between halt checks while probing a ROM
+const int BENCH_HARDENING_REPEATS = 51;	//the difference is within the noise of 5 long runs, so many short ones
+const uint64_t BENCH_HARDENING_INSTRUCTIONS = BENCH_INSTRUCTIONS / 5;
+
+char const* const benchRoms[] = {
+	"bench_loop.ch8",
+	"test_opcode.ch8",
+	"BC_test.ch8",
+};
+
+struct BenchCore
+{
+	char const* name;
+	Chip8::Core core;
+};
+
+BenchCore const benchCores[] = {
+	{ "table", Chip8::Core::Table },
+	{ "switch", Chip8::Core::Switch },
+	{ "cached", Chip8::Core::Cached },
+	{ "jit", Chip8::Core::Jit },
+	{ "aot", Chip8::Core::Aot },
+};
+
+//Times one run of `instructions` cycles on a freshly loaded machine.
+//Construction and ROM loading are kept outside of the timed section.
+static double TimeRun(std::string const& path, Chip8::Core core, uint64_t instructions)
+{
+	Chip8 chip8;
+	chip8.SetCore(core);
+	chip8.LoadROM(path.c_str());
+
+	auto start = std::chrono::steady_clock::now();
+	chip8.Run(instructions);
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double>(end - start).count();
+}
+
+//The table core, either hardened (Core::Table) or with the masks compiled out.
+static void RunTable(Chip8& chip8, bool hardened, uint64_t instructions)
+{
+	if (hardened) {
+		chip8.Run(instructions);
+	} else {
+		chip8.RunUnchecked(instructions);
+	}
+}
+
+//TimeRun for RunTable.
+static double TimeTable(std::string const& path, bool hardened, uint64_t instructions)
+{
+	Chip8 chip8;
+	chip8.SetCore(Chip8::Core::Table);
+	chip8.LoadROM(path.c_str());
+
+	auto start = std::chrono::steady_clock::now();
+	RunTable(chip8, hardened, instructions);
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double>(end - start).count();
+}
+
+//Whether both builds of the table core end in the same state. One that reaches outside the
+//address space runs a different program unchecked, and timing it would compare nothing.
+static bool StaysInBounds(std::string const& path, uint64_t instructions)
+{
+	Chip8 machines[2];
+	for (bool hardened : { false, true }) {
+		machines[hardened].SetCore(Chip8::Core::Table);
+		machines[hardened].Seed(1);
+		machines[hardened].LoadROM(path.c_str());
+		RunTable(machines[hardened], hardened, instructions);
+	}
+	return machines[false].SameState(machines[true]);
+}
+
+//Instructions the ROM executes before it halts, or `limit` if it runs that long.
+static uint64_t InstructionsBeforeHalt(std::string const& path, uint64_t limit)
+{
+	Chip8 chip8;
+	chip8.LoadROM(path.c_str());
+
+	uint64_t executed = 0;
+	while (executed < limit && chip8.IdleState() != Chip8::Idle::Halt) {
+		uint64_t chunk = std::min(BENCH_HALT_CHUNK, limit - executed);
+		chip8.Run(chunk);
+		executed += chunk;
+	}
+	return executed;
+}
+
+//Whether this build linked an ahead-of-time translation of the ROM. Without one, the aot core
+//would only be timing the switch core it falls back to.
+static bool Translated(std::string const& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::vector<uint8_t> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return FindAotProgram(image.data(), image.size()) != nullptr;
+}
+
+//Seed sweep over WIDE_LANES seeds, `instructions` per seed. Returns seconds.
+static double TimeSweep(std::vector<uint8_t> const& rom, bool wide, uint64_t instructions)
+{
+	if (wide) {
+		static WideChip8 machine;	//too large for the stack
+		machine = WideChip8();
+		machine.LoadROM(rom.data(), rom.size());
+		for (unsigned int l = 0; l < WIDE_LANES; l++) {
+			machine.Seed(l, l + 1);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		machine.Run(instructions);
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double>(end - start).count();
+	}
+
+	std::vector<Chip8> machines(WIDE_LANES);
+	for (unsigned int l = 0; l < WIDE_LANES; l++) {
+		machines[l].SetCore(Chip8::Core::Switch);
+		machines[l].LoadROM(rom.data(), rom.size());
+		machines[l].Seed(l + 1);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (Chip8& machine : machines) {
+		machine.Run(instructions);
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - start).count();
+}
+
+//Lanes of a seed sweep that end on a display no other lane has. Only a ROM that uses Cxkk in a
+//way that reaches its control flow or drawing can make the lanes diverge at all.
+static unsigned int DistinctLanes(std::vector<uint8_t> const& rom, uint64_t instructions)
+{
+	static WideChip8 machine;	//too large for the stack
+	machine = WideChip8();
+	machine.LoadROM(rom.data(), rom.size());
+	for (unsigned int l = 0; l < WIDE_LANES; l++) {
+		machine.Seed(l, l + 1);
+	}
+	machine.Run(instructions);
+
+	std::vector<uint64_t> hashes;
+	for (unsigned int l = 0; l < WIDE_LANES; l++) {
+		hashes.push_back(machine.DisplayHash(l));
+	}
+	std::sort(hashes.begin(), hashes.end());
+	return (unsigned int)(std::unique(hashes.begin(), hashes.end()) - hashes.begin());
+}
+
+//ARG consists of:
+//	Optional ROM directory (defaults to the one CMake points at)
+int main(int argc, char** argv)
+{
+	std::string romDir = (argc > 1) ? argv[1] : CHIP8_ROM_DIR;
+
+	std::printf("%-20s %-8s %16s %12s %10s\n", "ROM", "core", "instructions/s", "ns/instr", "speedup");
+	std::vector<char const*> timedRoms;
+	for (char const* rom : benchRoms) {
+		std::string path = romDir + "/" + rom;
+		uint64_t beforeHalt = InstructionsBeforeHalt(path, BENCH_INSTRUCTIONS);
+		if (beforeHalt < BENCH_INSTRUCTIONS) {
+			std::printf("%-20s halts within %llu instructions, not timed\n", rom, (unsigned long long)beforeHalt);
+			continue;
+		}
+		timedRoms.push_back(rom);
+		double baseline = 0;
+
+		for (BenchCore const& bench : benchCores) {
+			if (bench.core == Chip8::Core::Aot && !Translated(path)) {
+				std::printf("%-20s %-8s not in CHIP8_AOT_ROMS, not timed\n", rom, bench.name);
+				continue;
+			}
+
+			TimeRun(path, bench.core, BENCH_INSTRUCTIONS / 10);	//warm up caches and clocks
+
+			std::vector<double> samples;
+			for (int i = 0; i < BENCH_REPEATS; i++) {
+				samples.push_back(TimeRun(path, bench.core, BENCH_INSTRUCTIONS));
+			}
+			std::sort(samples.begin(), samples.end());
+			double median = samples[samples.size() / 2];
+
+			if (baseline == 0) {
+				baseline = median;	//first core listed is the reference
+			}
+
+			std::printf("%-20s %-8s %16.0f %12.2f %9.2fx\n", rom, bench.name,
+				BENCH_INSTRUCTIONS / median, median * 1e9 / BENCH_INSTRUCTIONS, baseline / median);
+		}
+	}
+
+	//Runs alternate between the two builds so both see the same clock and cache conditions.
+	std::printf("\n%-20s %-10s %14s %12s %10s\n", "ROM", "table core", "instructions/s", "ns/instr", "cost");
+	for (char const* rom : timedRoms) {
+		std::string path = romDir + "/" + rom;
+		if (!StaysInBounds(path, BENCH_HARDENING_INSTRUCTIONS)) {
+			std::printf("%-20s leaves the address space, unchecked is not comparable\n", rom);
+			continue;
+		}
+		TimeTable(path, false, BENCH_HARDENING_INSTRUCTIONS);
+		TimeTable(path, true, BENCH_HARDENING_INSTRUCTIONS);
+
+		std::vector<double> samples[2];
+		for (int i = 0; i < BENCH_HARDENING_REPEATS; i++) {
+			for (bool hardened : { false, true }) {
+				samples[hardened].push_back(TimeTable(path, hardened, BENCH_HARDENING_INSTRUCTIONS));
+			}
+		}
+
+		double unchecked = 0;
+		for (bool hardened : { false, true }) {
+			std::sort(samples[hardened].begin(), samples[hardened].end());
+			double median = samples[hardened][samples[hardened].size() / 2];
+			if (!hardened) {
+				unchecked = median;
+			}
+
+			std::printf("%-20s %-10s %14.0f %12.2f %+9.1f%%\n", rom, hardened ? "hardened" : "unchecked",
+				BENCH_HARDENING_INSTRUCTIONS / median, median * 1e9 / BENCH_HARDENING_INSTRUCTIONS, (median / unchecked - 1) * 100);
+		}
+	}
+
+	uint64_t perLane = BENCH_INSTRUCTIONS / WIDE_LANES;
+	std::printf("\n%-20s %-8s %16s %12s %10s\n", "ROM (x32 seeds)", "core", "instructions/s", "ns/instr", "speedup");
+	for (char const* rom : timedRoms) {
+		std::ifstream file(romDir + "/" + rom, std::ios::binary);
+		std::vector<uint8_t> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		double baseline = 0;
+
+		for (bool wide : { false, true }) {
+			TimeSweep(image, wide, perLane / 10);
+
+			std::vector<double> samples;
+			for (int i = 0; i < BENCH_REPEATS; i++) {
+				samples.push_back(TimeSweep(image, wide, perLane));
+			}
+			std::sort(samples.begin(), samples.end());
+			double median = samples[samples.size() / 2];
+
+			if (baseline == 0) {
+				baseline = median;
+			}
+
+			uint64_t total = perLane * WIDE_LANES;
+			std::printf("%-20s %-8s %16.0f %12.2f %9.2fx\n", rom, wide ? "wide" : "switch",
+				total / median, median * 1e9 / total, baseline / median);
+		}
+		std::printf("%-20s %u of %u lanes end on distinct displays\n", rom, DistinctLanes(image, perLane), WIDE_LANES);
+	}
+
+	Chip8 chip8;
+	chip8.LoadROM((romDir + "/" + benchRoms[0]).c_str());
+	chip8.Run(BENCH_INSTRUCTIONS / 100);
+	Snapshot snapshot;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < BENCH_SNAPSHOTS; i++) {
+		chip8.SaveState(snapshot);
+		chip8.LoadState(snapshot);
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	std::printf("\nsave state + restore (%zu bytes): %.1f ns\n", sizeof(Snapshot),
+		std::chrono::duration<double>(end - start).count() * 1e9 / BENCH_SNAPSHOTS);
+
+	//Ten minutes of bench_loop.ch8, whose registers, timers and display all change every frame.
+	//Frames run untimed in between, only Record() is measured.
+	Chip8 workload;
+	workload.LoadROM((romDir + "/bench_loop.ch8").c_str());
+	Scheduler scheduler(BENCH_REWIND_IPF);
+	Rewind rewind;
+	double recording = 0;
+	int drawnFrames = 0;
+	for (int frame = 0; frame < BENCH_REWIND_FRAMES; frame++) {
+		uint32_t generation = workload.DisplayGeneration();
+		scheduler.RunFrame(workload);
+		drawnFrames += workload.DisplayGeneration() != generation;
+
+		auto recordStart = std::chrono::steady_clock::now();
+		rewind.Record(workload);
+		recording += std::chrono::duration<double>(std::chrono::steady_clock::now() - recordStart).count();
+	}
+
+	std::printf("rewind record: %.1f ns/frame, %zu of %d frames kept in %zu bytes (%.1f bytes/frame, display changed in %d)\n",
+		recording * 1e9 / BENCH_REWIND_FRAMES, rewind.Frames(), BENCH_REWIND_FRAMES, rewind.BytesUsed(),
+		rewind.Frames() > 0 ? (double)rewind.BytesUsed() / rewind.Frames() : 0.0, drawnFrames);
+
+	//Every row redrawn every frame, the worst case. Phosphor also pays for Advance().
+	std::printf("\n%-10s %-6s %12s %10s\n", "filter", "scale", "us/frame", "GB/s");
+	for (char const* name : { "nearest", "scanline", "phosphor" }) {
+		Renderer::Filter filter;
+		Renderer::FilterFromName(name, filter);
+
+		for (unsigned int scale : { 10u, 20u }) {
+			Renderer renderer(scale, filter);
+			size_t pitch = renderer.Width() * sizeof(uint32_t);
+			std::vector<uint32_t> target(renderer.Width() * renderer.Height());
+
+			auto renderStart = std::chrono::steady_clock::now();
+			for (int frame = 0; frame < BENCH_RENDER_FRAMES; frame++) {
+				renderer.Advance(chip8.display, ALL_ROWS);
+				renderer.Render(chip8.display, 0, VIDEO_HEIGHT - 1, target.data(), pitch);
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+
+			std::printf("%-10s %-6u %12.1f %10.2f\n", name, scale, seconds * 1e6 / BENCH_RENDER_FRAMES,
+				(double)target.size() * sizeof(uint32_t) * BENCH_RENDER_FRAMES / seconds / 1e9);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,482 @@
+#include "Capture.h"
+#include "Scheduler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+const uint32_t CAPTURE_ON = 0xFFFFFF;		//RGB
+const uint32_t CAPTURE_OFF = 0x000000;
+const uint64_t GIF_MIN_DELAY = 2;			//viewers show anything shorter as 1/10 s
+
+Capture::~Capture()
+{
+	Close();
+}
+
+bool Capture::FormatFromName(char const* filename, Format& found)
+{
+	static struct { char const* extension; Format format; } const names[] = {
+		{ ".gif", Format::Gif },
+		{ ".png", Format::Png },
+		{ ".y4m", Format::Y4m },
+	};
+
+	size_t length = std::strlen(filename);
+	for (auto const& entry : names) {
+		if (length >= 4 && std::strcmp(filename + length - 4, entry.extension) == 0) {
+			found = entry.format;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Capture::Open(char const* filename, Format captureFormat, unsigned int captureScale, bool waitForRoom, size_t queueFrames)
+{
+	Close();
+
+	format = captureFormat;
+	scale = std::max(1u, captureScale);
+	capacity = std::max<size_t>(1, queueFrames);
+	lossless = waitForRoom;
+	name = filename;
+	failed = false;
+	frames = duplicates = dropped = 0;
+	hasCurrent = hasGifPending = false;
+	gifTime = 0;
+	indices.resize((size_t)VIDEO_WIDTH * scale * VIDEO_HEIGHT * scale);
+
+	if (format != Format::Png) {
+		file.open(filename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+	}
+	if (format == Format::Gif && !WriteGifHeader()) {
+		file.close();
+		return false;
+	}
+	if (format == Format::Y4m) {
+		file << "YUV4MPEG2 W" << VIDEO_WIDTH * scale << " H" << VIDEO_HEIGHT * scale << " F" << FRAME_RATE
+			<< ":1 Ip A1:1 C420jpeg\n";
+	}
+
+	closing = false;
+	open = true;
+	worker = std::thread(&Capture::Encoder, this);
+	return true;
+}
+
+void Capture::Submit(uint64_t const* display)
+{
+	if (!open) {
+		return;
+	}
+
+	uint64_t frame = frames++;
+	if (hasCurrent && std::memcmp(current.display, display, sizeof(current.display)) == 0) {
+		current.length++;
+		duplicates++;
+		return;
+	}
+
+	if (hasCurrent) {
+		Push(current);
+	}
+	std::memcpy(current.display, display, sizeof(current.display));
+	current.first = frame;
+	current.length = 1;
+	hasCurrent = true;
+}
+
+void Capture::Push(Frame const& frame)
+{
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		if (lossless) {
+			room.wait(guard, [this] { return queue.size() < capacity; });
+		} else if (queue.size() >= capacity) {
+			dropped++;
+			return;
+		}
+		queue.push_back(frame);
+	}
+	wake.notify_one();
+}
+
+bool Capture::Close()
+{
+	if (!open) {
+		return !failed;
+	}
+
+	if (hasCurrent) {
+		lossless = true;		//the last frame is never dropped
+		Push(current);
+		hasCurrent = false;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		closing = true;
+	}
+	wake.notify_one();
+	worker.join();
+
+	if (format == Format::Gif) {
+		if (hasGifPending) {
+			uint64_t end = gifPending.first + gifPending.length;
+			uint64_t delay = std::max(GIF_MIN_DELAY, (end * 100 + FRAME_RATE / 2) / FRAME_RATE - gifTime);
+			failed |= !WriteGifFrame(gifPending, delay);
+			hasGifPending = false;
+		}
+		file.put(0x3B);		//trailer
+	}
+	if (file.is_open()) {
+		file.close();
+		failed |= file.fail();
+	}
+
+	open = false;
+	return !failed;
+}
+
+void Capture::Encoder()
+{
+	for (;;) {
+		Frame frame;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this] { return closing || !queue.empty(); });
+			if (queue.empty()) {
+				return;		//closing and drained
+			}
+			frame = queue.front();
+			queue.pop_front();
+		}
+		room.notify_one();
+
+		if (!failed && !Write(frame)) {
+			failed = true;
+		}
+	}
+}
+
+bool Capture::Write(Frame const& frame)
+{
+	switch (format)
+	{
+		case Format::Gif:
+		{
+			//A frame's delay is only known once the next one arrives. Frames too short for a GIF
+			//delay are replaced by the next one, which takes over their start time.
+			bool ok = true;
+			if (hasGifPending) {
+				uint64_t delay = (frame.first * 100 + FRAME_RATE / 2) / FRAME_RATE - gifTime;
+				if (delay >= GIF_MIN_DELAY) {
+					ok = WriteGifFrame(gifPending, delay);
+					gifTime += delay;
+					gifPending = frame;
+				} else {
+					uint64_t first = gifPending.first;
+					gifPending = frame;
+					gifPending.length += frame.first - first;
+					gifPending.first = first;
+				}
+			} else {
+				gifPending = frame;
+			}
+			hasGifPending = true;
+			return ok;
+		}
+		case Format::Png: return WritePng(frame);
+		case Format::Y4m: return WriteY4mFrame(frame);
+	}
+	return false;
+}
+
+void Capture::ExpandIndices(Frame const& frame)
+{
+	size_t width = (size_t)VIDEO_WIDTH * scale;
+	uint8_t* out = indices.data();
+	for (unsigned int y = 0; y < VIDEO_HEIGHT; y++) {
+		uint8_t* first = out;
+		for (unsigned int x = 0; x < VIDEO_WIDTH; x++) {
+			uint8_t index = (frame.display[y] >> (VIDEO_WIDTH - 1u - x)) & 1u;
+			std::memset(out, index, scale);
+			out += scale;
+		}
+		for (unsigned int r = 1; r < scale; r++, out += width) {
+			std::memcpy(out, first, width);
+		}
+	}
+}
+
+//GIF
+
+static void PutLittle16(std::vector<uint8_t>& out, unsigned int value)
+{
+	out.push_back(value & 0xFFu);
+	out.push_back((value >> 8u) & 0xFFu);
+}
+
+bool Capture::WriteGifHeader()
+{
+	std::vector<uint8_t> header = { 'G', 'I', 'F', '8', '9', 'a' };
+	PutLittle16(header, VIDEO_WIDTH * scale);
+	PutLittle16(header, VIDEO_HEIGHT * scale);
+	header.push_back(0x81);		//global colour table of 4 entries (LZW needs at least 2 bits per pixel)
+	header.push_back(0);
+	header.push_back(0);
+	for (uint32_t color : { CAPTURE_OFF, CAPTURE_ON, CAPTURE_OFF, CAPTURE_OFF }) {
+		header.push_back((color >> 16u) & 0xFFu);
+		header.push_back((color >> 8u) & 0xFFu);
+		header.push_back(color & 0xFFu);
+	}
+
+	//NETSCAPE2.0: loop forever
+	uint8_t const loop[] = { 0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01, 0x00, 0x00, 0x00 };
+	header.insert(header.end(), loop, loop + sizeof(loop));
+
+	file.write(reinterpret_cast<char const*>(header.data()), header.size());
+	return file.good();
+}
+
+//LZW with variable code width, packed LSB first into sub-blocks of up to 255 bytes.
+class GifBits
+{
+	public:
+		explicit GifBits(std::vector<uint8_t>& out) : out(out) {}
+
+		void Put(unsigned int code, unsigned int width)
+		{
+			bits |= (uint32_t)code << count;
+			count += width;
+			while (count >= 8) {
+				Byte(bits & 0xFFu);
+				bits >>= 8u;
+				count -= 8;
+			}
+		}
+
+		void Finish()
+		{
+			if (count > 0) {
+				Byte(bits & 0xFFu);
+			}
+			if (block.size() > 0) {
+				Flush();
+			}
+			out.push_back(0);		//block terminator
+		}
+
+	private:
+		void Byte(uint8_t value)
+		{
+			block.push_back(value);
+			if (block.size() == 255) {
+				Flush();
+			}
+		}
+
+		void Flush()
+		{
+			out.push_back((uint8_t)block.size());
+			out.insert(out.end(), block.begin(), block.end());
+			block.clear();
+		}
+
+		std::vector<uint8_t>& out;
+		std::vector<uint8_t> block;
+		uint32_t bits{};
+		unsigned int count{};
+};
+
+static void LzwEncode(uint8_t const* pixels, size_t count, std::vector<uint8_t>& out)
+{
+	const unsigned int MIN_CODE_SIZE = 2;
+	const unsigned int CLEAR = 1u << MIN_CODE_SIZE;
+	const unsigned int LAST_CODE = 4095;
+
+	static thread_local uint16_t next[LAST_CODE + 1][1u << MIN_CODE_SIZE];	//code for prefix + pixel, 0 = none
+	std::memset(next, 0, sizeof(next));
+
+	out.push_back(MIN_CODE_SIZE);
+	GifBits bits(out);
+	unsigned int width = MIN_CODE_SIZE + 1;
+	unsigned int maxCode = CLEAR + 1;
+
+	bits.Put(CLEAR, width);
+	unsigned int prefix = pixels[0];
+	for (size_t i = 1; i < count; i++) {
+		unsigned int pixel = pixels[i];
+		if (next[prefix][pixel] != 0) {
+			prefix = next[prefix][pixel];
+			continue;
+		}
+
+		bits.Put(prefix, width);
+		next[prefix][pixel] = (uint16_t)++maxCode;
+		if (maxCode >= (1u << width)) {
+			width++;
+		}
+		if (maxCode == LAST_CODE) {
+			bits.Put(CLEAR, width);
+			std::memset(next, 0, sizeof(next));
+			width = MIN_CODE_SIZE + 1;
+			maxCode = CLEAR + 1;
+		}
+		prefix = pixel;
+	}
+	bits.Put(prefix, width);
+	bits.Put(CLEAR + 1, width);		//end of information
+	bits.Finish();
+}
+
+bool Capture::WriteGifFrame(Frame const& frame, uint64_t delay)
+{
+	ExpandIndices(frame);
+
+	encoded.clear();
+	uint8_t const control[] = { 0x21, 0xF9, 0x04, 0x00, 0, 0, 0x00, 0x00 };	//graphic control: delay only
+	encoded.insert(encoded.end(), control, control + sizeof(control));
+	delay = std::min<uint64_t>(delay, 0xFFFF);
+	encoded[4] = delay & 0xFFu;
+	encoded[5] = (delay >> 8u) & 0xFFu;
+
+	encoded.push_back(0x2C);		//image descriptor, whole screen, no local colour table
+	PutLittle16(encoded, 0);
+	PutLittle16(encoded, 0);
+	PutLittle16(encoded, VIDEO_WIDTH * scale);
+	PutLittle16(encoded, VIDEO_HEIGHT * scale);
+	encoded.push_back(0);
+
+	LzwEncode(indices.data(), indices.size(), encoded);
+	file.write(reinterpret_cast<char const*>(encoded.data()), encoded.size());
+	return file.good();
+}
+
+//PNG: 1-bit palette image, stored (uncompressed) deflate blocks. Small enough at these sizes
+//and needs no zlib.
+
+static uint32_t Crc32(uint8_t const* data, size_t size)
+{
+	struct Table
+	{
+		uint32_t entries[256];
+		Table()
+		{
+			for (uint32_t n = 0; n < 256; n++) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++) {
+					c = (c & 1u) ? 0xEDB88320u ^ (c >> 1u) : c >> 1u;
+				}
+				entries[n] = c;
+			}
+		}
+	};
+	static Table const table;
+
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; i++) {
+		crc = table.entries[(crc ^ data[i]) & 0xFFu] ^ (crc >> 8u);
+	}
+	return ~crc;
+}
+
+static void PutBig32(std::vector<uint8_t>& out, uint32_t value)
+{
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		out.push_back((value >> shift) & 0xFFu);
+	}
+}
+
+static void PngChunk(std::vector<uint8_t>& out, char const* type, std::vector<uint8_t> const& data)
+{
+	PutBig32(out, (uint32_t)data.size());
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	PutBig32(out, Crc32(&out[start], out.size() - start));
+}
+
+bool Capture::WritePng(Frame const& frame)
+{
+	ExpandIndices(frame);
+	unsigned int width = VIDEO_WIDTH * scale;
+	unsigned int height = VIDEO_HEIGHT * scale;
+	size_t rowBytes = 1 + (width + 7) / 8;		//filter byte, then 8 pixels per byte
+
+	std::vector<uint8_t> raw(rowBytes * height, 0);
+	for (unsigned int y = 0; y < height; y++) {
+		uint8_t* row = &raw[y * rowBytes + 1];
+		for (unsigned int x = 0; x < width; x++) {
+			row[x / 8] |= indices[(size_t)y * width + x] << (7u - x % 8);
+		}
+	}
+
+	//zlib stream: header, stored blocks of up to 65535 bytes, Adler-32
+	std::vector<uint8_t> zlib = { 0x78, 0x01 };
+	uint32_t a = 1, b = 0;
+	size_t offset = 0;
+	do {
+		size_t length = std::min<size_t>(raw.size() - offset, 0xFFFF);
+		zlib.push_back(offset + length == raw.size() ? 1 : 0);		//last block flag, stored
+		zlib.push_back(length & 0xFFu);
+		zlib.push_back((length >> 8u) & 0xFFu);
+		zlib.push_back(~length & 0xFFu);
+		zlib.push_back((~length >> 8u) & 0xFFu);
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+		for (size_t i = offset; i < offset + length; i++) {
+			a = (a + raw[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		offset += length;
+	} while (offset < raw.size());
+	PutBig32(zlib, (b << 16u) | a);
+
+	std::vector<uint8_t> header;
+	PutBig32(header, width);
+	PutBig32(header, height);
+	header.insert(header.end(), { 1, 3, 0, 0, 0 });		//1 bit, palette, deflate, no filter, no interlace
+
+	std::vector<uint8_t> palette;
+	for (uint32_t color : { CAPTURE_OFF, CAPTURE_ON }) {
+		palette.insert(palette.end(), { (uint8_t)(color >> 16u), (uint8_t)(color >> 8u), (uint8_t)color });
+	}
+
+	encoded.assign({ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' });
+	PngChunk(encoded, "IHDR", header);
+	PngChunk(encoded, "PLTE", palette);
+	PngChunk(encoded, "IDAT", zlib);
+	PngChunk(encoded, "IEND", {});
+
+	std::string base = name;
+	if (base.size() >= 4 && base.compare(base.size() - 4, 4, ".png") == 0) {
+		base.erase(base.size() - 4);
+	}
+	char number[32];
+	std::snprintf(number, sizeof(number), "_%06llu.png", (unsigned long long)frame.first);
+
+	std::ofstream out(base + number, std::ios::binary);
+	out.write(reinterpret_cast<char const*>(encoded.data()), encoded.size());
+	return out.good();
+}
+
+//Y4M: full-range luma straight from the pixels, neutral chroma.
+bool Capture::WriteY4mFrame(Frame const& frame)
+{
+	ExpandIndices(frame);
+
+	encoded.assign({ 'F', 'R', 'A', 'M', 'E', '\n' });
+	size_t start = encoded.size();
+	encoded.resize(start + indices.size() + indices.size() / 2, 128);	//Y, then U and V at quarter size
+	for (size_t i = 0; i < indices.size(); i++) {
+		encoded[start + i] = indices[i] ? 255 : 0;
+	}
+
+	for (uint64_t i = 0; i < frame.length; i++) {
+		file.write(reinterpret_cast<char const*>(encoded.data()), encoded.size());
+	}
+	return file.good();
+}
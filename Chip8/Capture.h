@@ -0,0 +1,99 @@
+//Offscreen video capture. The emulation thread hands over the display once per frame, identical
+//frames are folded into the previous one's duration, and a background thread encodes the rest
+//as an animated GIF, a numbered PNG sequence or a raw Y4M stream. The queue between them is
+//bounded: when the encoder falls behind, frames are dropped (and counted) rather than making
+//a live session wait. Needs no display or SDL, so it works from chip8_headless.
+
+#ifndef CHIP_8_CAPTURE_H
+#define CHIP_8_CAPTURE_H
+
+#include "Chip8.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const size_t DEFAULT_CAPTURE_QUEUE = 256;	//distinct frames waiting for the encoder
+
+class Capture
+{
+	public:
+		enum class Format
+		{
+			Gif,	//one animated file, delays in 1/100 s
+			Png,	//name_000123.png per distinct frame, numbered by the guest frame it appeared on
+			Y4m,	//4:2:0 at 60 fps, repeated frames written out again so timing is implicit
+		};
+
+		Capture() = default;
+		Capture(Capture const&) = delete;
+		Capture& operator=(Capture const&) = delete;
+		~Capture();
+
+		static bool FormatFromName(char const* filename, Format& found);	//by extension: .gif, .png, .y4m
+
+		//`lossless` makes Submit() wait for room instead of dropping, for offline runs that outpace the encoder.
+		bool Open(char const* filename, Format format, unsigned int scale = 4, bool lossless = false,
+			size_t queueFrames = DEFAULT_CAPTURE_QUEUE);
+		void Submit(uint64_t const* display);	//once per guest frame, only blocks on the encoder if lossless
+		bool Close();							//flushes everything queued, false if any write failed
+
+		uint64_t Frames() const { return frames; }			//submitted
+		uint64_t Duplicates() const { return duplicates; }	//folded into the frame before
+		uint64_t Dropped() const { return dropped; }		//queue was full
+
+	private:
+		struct Frame
+		{
+			uint64_t display[VIDEO_HEIGHT];
+			uint64_t first;		//guest frame it appeared on
+			uint64_t length;	//guest frames it stayed on screen
+		};
+
+		void Push(Frame const& frame);
+		void Encoder();
+		bool Write(Frame const& frame);
+
+		void ExpandIndices(Frame const& frame);		//one byte per output pixel, 0 = off, 1 = on
+		bool WriteGifHeader();
+		bool WriteGifFrame(Frame const& frame, uint64_t delay);
+		bool WritePng(Frame const& frame);
+		bool WriteY4mFrame(Frame const& frame);
+
+		Format format{};
+		unsigned int scale{ 1 };
+		size_t capacity{};
+		bool lossless{};
+		std::string name;
+		std::ofstream file;		//GIF and Y4M
+		bool open{};
+
+		//Producer side, only touched by Submit()
+		Frame current{};
+		bool hasCurrent{};
+		uint64_t frames{};
+		uint64_t duplicates{};
+		uint64_t dropped{};
+
+		std::mutex lock;
+		std::condition_variable wake;		//encoder: a frame was queued, or closing
+		std::condition_variable room;		//producer: the encoder took a frame
+		std::deque<Frame> queue;
+		bool closing{};
+		std::thread worker;
+
+		//Encoder side
+		std::vector<uint8_t> indices;
+		std::vector<uint8_t> encoded;
+		Frame gifPending{};			//written once the next frame shows how long it lasted
+		bool hasGifPending{};
+		uint64_t gifTime{};			//centiseconds written so far
+		bool failed{};
+};
+
+#endif
@@ -1,18 +1,19 @@
 //By Brendan Paing. Started 10/22/2020.
 
 #include "Chip8.h"
+#include "Profiler.h"
+#include "Snapshot.h"
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <fstream>
+#include <iterator>
 
 
-const unsigned int START_ADDRESS = 0x200;	//0x000 to 0x1FF is reserved, instructions start at 0x200
-const unsigned int FONTSET_START = 0x050;	//0x050-0x0A0
-const unsigned int FONTSET_SIZE = 80; //(16 * 10 (A) - 16 * 5 = 80)
-
 //0x050-0x0A0 requires the built-in characters (0-9, A-F)
 //in binary . . . draw the characters, convert to hex
 //Fontset size is 80, and there are 16 characters. Each character gets 5 indices.
-uint8_t fontset[FONTSET_SIZE]{
+constexpr uint8_t fontset[FONTSET_SIZE]{
 	0xF0, 0x90, 0x90, 0x90, 0xF0, //0
 	0x20, 0x60, 0x20, 0x20, 0x70, //1
 	0xF0, 0x10, 0xF0, 0x80, 0xF0, //2
@@ -31,62 +32,69 @@ uint8_t fontset[FONTSET_SIZE]{
 	0xF0, 0x80, 0xF0, 0x80, 0x80, //F
 };
 
+//Memory of a machine that was just turned on: zeroes, with the fontset at FONTSET_START.
+//Built at compile time, so a new machine starts from one copy of it.
+static constexpr std::array<uint8_t, MEMORY_SIZE> initialMemory = [] {
+	std::array<uint8_t, MEMORY_SIZE> image{};
+	for (unsigned int i = 0; i < FONTSET_SIZE; i++) {
+		image[FONTSET_START + i] = fontset[i];
+	}
+	return image;
+}();
+
+//Everything starts as OP_NULL, so invalid opcodes are ignored rather than called through a null pointer.
+template <size_t N>
+constexpr std::array<Chip8::Chip8Instruction, N> Chip8::MakeTable(std::initializer_list<TableEntry> entries)
+{
+	std::array<Chip8Instruction, N> made{};
+	for (size_t i = 0; i < N; i++) {
+		made[i] = &Chip8::OP_NULL;
+	}
+	for (TableEntry const& entry : entries) {
+		made[entry.digits] = entry.instruction;
+	}
+	return made;
+}
+
+//Function pointers for instructions, patterns link to sub tables.
+//One set of tables per Hardened value, see RunUnchecked().
+template <bool Hardened>
+std::array<Chip8::Chip8Instruction, 0xF + 1> const Chip8::table = MakeTable<0xF + 1>({
+	{ 0x0, &Chip8::Table0<Hardened> }, { 0x1, &Chip8::OP_1nnn }, { 0x2, &Chip8::OP_2nnn<Hardened> }, { 0x3, &Chip8::OP_3xkk },
+	{ 0x4, &Chip8::OP_4xkk }, { 0x5, &Chip8::OP_5xy0 }, { 0x6, &Chip8::OP_6xkk }, { 0x7, &Chip8::OP_7xkk },
+	{ 0x8, &Chip8::Table8 }, { 0x9, &Chip8::OP_9xy0 }, { 0xA, &Chip8::OP_Annn }, { 0xB, &Chip8::OP_Bnnn },
+	{ 0xC, &Chip8::OP_Cxkk }, { 0xD, &Chip8::OP_Dxyn<Hardened> }, { 0xE, &Chip8::TableE }, { 0xF, &Chip8::TableF<Hardened> },
+});
+
+//below are the sub-table assignments.
+template <bool Hardened>
+std::array<Chip8::Chip8Instruction, 0xF + 1> const Chip8::table0 = MakeTable<0xF + 1>({
+	{ 0x0, &Chip8::OP_00E0 },
+	{ 0xE, &Chip8::OP_00EE<Hardened> },
+});
+
+std::array<Chip8::Chip8Instruction, 0xF + 1> const Chip8::table8 = MakeTable<0xF + 1>({
+	{ 0x0, &Chip8::OP_8xy0 }, { 0x1, &Chip8::OP_8xy1 }, { 0x2, &Chip8::OP_8xy2 }, { 0x3, &Chip8::OP_8xy3 },
+	{ 0x4, &Chip8::OP_8xy4 }, { 0x5, &Chip8::OP_8xy5 }, { 0x6, &Chip8::OP_8xy6 }, { 0x7, &Chip8::OP_8xy7 },
+	{ 0xE, &Chip8::OP_8xyE },
+});
+
+std::array<Chip8::Chip8Instruction, 0xF + 1> const Chip8::tableE = MakeTable<0xF + 1>({
+	{ 0x1, &Chip8::OP_ExA1 },
+	{ 0xE, &Chip8::OP_Ex9E },
+});
+
+template <bool Hardened>
+std::array<Chip8::Chip8Instruction, 0xFF + 1> const Chip8::tableF = MakeTable<0xFF + 1>({
+	{ 0x07, &Chip8::OP_Fx07 }, { 0x0A, &Chip8::OP_Fx0A }, { 0x15, &Chip8::OP_Fx15 },
+	{ 0x18, &Chip8::OP_Fx18 }, { 0x1E, &Chip8::OP_Fx1E }, { 0x29, &Chip8::OP_Fx29 },
+	{ 0x33, &Chip8::OP_Fx33<Hardened> }, { 0x55, &Chip8::OP_Fx55<Hardened> }, { 0x65, &Chip8::OP_Fx65<Hardened> },
+});
+
 Chip8::Chip8()	//Generally, best practice is to seed ONCE, then extract numbers.
-	: randNumGen((unsigned int) std::chrono::system_clock::now().time_since_epoch().count()) //seed is system clock.
-{
-	counter = START_ADDRESS;
-
-	for (int i = FONTSET_START; i < FONTSET_SIZE; i++) {
-		memory[FONTSET_START + i] = fontset[i];
-	}
-
-	randByte = std::uniform_int_distribution<unsigned int>(0, 255U);
-	//grabs numbers from the generator seeded in the constructor.
-
-	//Function pointers for instructions, patterns link to sub tables.
-	table[0x0] = &Chip8::Table0;
-	table[0x1] = &Chip8::OP_1nnn;
-	table[0x2] = &Chip8::OP_2nnn;
-	table[0x3] = &Chip8::OP_3xkk;
-	table[0x4] = &Chip8::OP_4xkk;
-	table[0x5] = &Chip8::OP_5xy0;
-	table[0x6] = &Chip8::OP_6xkk;
-	table[0x7] = &Chip8::OP_7xkk;
-	table[0x8] = &Chip8::Table8;
-	table[0x9] = &Chip8::OP_9xy0;
-	table[0xA] = &Chip8::OP_Annn;
-	table[0xB] = &Chip8::OP_Bnnn;
-	table[0xC] = &Chip8::OP_Cxkk;
-	table[0xD] = &Chip8::OP_Dxyn;
-	table[0xE] = &Chip8::TableE;
-	table[0xF] = &Chip8::TableF;
-
-	//below are the sub-table assignments.
-	table0[0x0] = &Chip8::OP_00E0;
-	table0[0xE] = &Chip8::OP_00EE;
-
-	table8[0x0] = &Chip8::OP_8xy0;
-	table8[0x1] = &Chip8::OP_8xy1;
-	table8[0x2] = &Chip8::OP_8xy2;
-	table8[0x3] = &Chip8::OP_8xy3;
-	table8[0x4] = &Chip8::OP_8xy4;
-	table8[0x5] = &Chip8::OP_8xy5;
-	table8[0x6] = &Chip8::OP_8xy6;
-	table8[0x7] = &Chip8::OP_8xy7;
-	table8[0xE] = &Chip8::OP_8xyE;
-
-	tableE[0x1] = &Chip8::OP_ExA1;
-	tableE[0xE] = &Chip8::OP_Ex9E;
-
-	tableF[0x07] = &Chip8::OP_Fx07;
-	tableF[0x0A] = &Chip8::OP_Fx0A;
-	tableF[0x15] = &Chip8::OP_Fx15;
-	tableF[0x18] = &Chip8::OP_Fx18;
-	tableF[0x1E] = &Chip8::OP_Fx1E;
-	tableF[0x29] = &Chip8::OP_Fx29;
-	tableF[0x33] = &Chip8::OP_Fx33;
-	tableF[0x55] = &Chip8::OP_Fx55;
-	tableF[0x65] = &Chip8::OP_Fx65;
+{
+	random.Seed((uint32_t) std::chrono::system_clock::now().time_since_epoch().count());	//seed is system clock.
+	std::memcpy(memory, initialMemory.data(), MEMORY_SIZE);
 }
 
 //Fetch opcode from instructions
@@ -94,18 +102,167 @@ Chip8::Chip8()	//Generally, best practice is to seed ONCE, then extract numbers.
 //Execute opcode
 void Chip8::Cycle()
 {
-	//Fetch		//memory is 0x00, while opcodes are 0x0000. Shift left then add next to get full opcode
-	opcode = (memory[counter] << 8u) | memory[counter + 1];
+	Run(1);
+}
+
+void Chip8::Run(uint64_t cycles)
+{
+#ifdef CHIP8_PROFILE
+	if (profiler) {
+		RunProfiled(cycles);
+		return;
+	}
+#endif
+
+	switch (core)
+	{
+		case Core::Table:
+		{
+			RunTable(cycles);
+		} break;
+
+		case Core::Switch:
+		{
+			RunSwitch(cycles);
+		} break;
+
+		case Core::Cached:
+		{
+			RunCached(cycles);
+		} break;
+
+		case Core::Jit:
+		{
+			RunJit(cycles);
+		} break;
+
+		case Core::Aot:
+		{
+			RunAot(cycles);
+		} break;
+	}
+}
+
+uint16_t Chip8::OpcodeAt(uint16_t address) const
+{
+	return (memory[address & MEMORY_MASK] << 8u) | memory[(address + 1) & MEMORY_MASK];
+}
+
+//Matches the loop the program counter is in, at any instruction of it. Key and timer conditions are
+//checked as of the loop's first instruction, so the loop is idle from there on.
+Chip8::IdleLoop Chip8::FindIdleLoop() const
+{
+	IdleLoop const none{ Idle::None, 0, 0 };
+	uint16_t pc = counter & (MEMORY_SIZE - 1);
+	uint16_t op = OpcodeAt(pc);
+
+	if ((op & 0xF000u) == 0x1000u && (op & 0x0FFFu) == pc) {
+		return IdleLoop{ Idle::Halt, pc, 1 };
+	}
+	if ((op & 0xF0FFu) == 0xF00Au) {
+		for (unsigned int i = 0; i < KEY_COUNT; i++) {
+			if (input[i]) {
+				return none;
+			}
+		}
+		return IdleLoop{ Idle::KeyWait, pc, 1 };
+	}
+
+	for (unsigned int back = 0; back <= 4; back += 2) {
+		uint16_t head = (pc - back) & (MEMORY_SIZE - 1);
+		uint16_t first = OpcodeAt(head);
+		uint16_t second = OpcodeAt(head + 2);
+		uint8_t x = (first >> 8u) & 0xFu;
+
+		//Ex9E / ExA1, then a jump back: spins until key Vx is pressed / released
+		if (back <= 2 && second == (0x1000u | head) && ((first & 0xF0FFu) == 0xE09Eu || (first & 0xF0FFu) == 0xE0A1u)) {
+			if (registers[x] >= KEY_COUNT) {
+				return none;
+			}
+			bool skips = (input[registers[x] & KEY_MASK] != 0) == ((first & 0xFFu) == 0x9Eu);
+			return skips ? none : IdleLoop{ Idle::KeyPoll, head, 2 };
+		}
+
+		//Fx07, 3xkk / 4xkk, then a jump back: spins until the delay timer reaches (or leaves) kk
+		if ((first & 0xF0FFu) == 0xF007u && OpcodeAt(head + 4) == (0x1000u | head)
+			&& ((second & 0xFF00u) == (0x3000u | (x << 8u)) || (second & 0xFF00u) == (0x4000u | (x << 8u)))) {
+			bool skips = (delay == (second & 0xFFu)) == ((second & 0xF000u) == 0x3000u);
+			return skips ? none : IdleLoop{ Idle::TimerPoll, head, 3 };
+		}
+	}
+	return none;
+}
+
+Chip8::Idle Chip8::IdleState() const
+{
+	return FindIdleLoop().kind;
+}
+
+bool Chip8::WaitingForInput() const
+{
+	Idle kind = FindIdleLoop().kind;
+	return (kind == Idle::KeyWait || kind == Idle::KeyPoll || kind == Idle::Halt) && delay == 0 && sound == 0;
+}
+
+//Nothing but the program counter (and, for a timer poll, Vx = delay) changes from one iteration to the
+//next, so whole iterations are skipped. A partial one is left to Run() to keep the program counter exact.
+uint64_t Chip8::SkipIdle(uint64_t cycles)
+{
+#ifdef CHIP8_PROFILE
+	if (profiler) {
+		return 0;	//the profile should see every instruction, idle ones included
+	}
+#endif
 
-	//Increment counter to the next opcode before executing
-	counter += 2;
+	IdleLoop loop = FindIdleLoop();
+	if (loop.kind == Idle::None) {
+		return 0;
+	}
 
-	//Decode and Execute 
-	//Determine which group the opcode belongs in using first digit
-	//Then, shift to rightmost digit to access master table indices (0 - F).
-	//From there, function pointer does it
-	((*this).*(table[(opcode & 0xF000u) >> 12u]))();
+	uint64_t consumed = 0;
+	uint16_t pc = counter & (MEMORY_SIZE - 1);
+	if (pc != loop.head) {
+		//Mid-iteration: finish it normally, the conditions only hold from the top
+		consumed = std::min<uint64_t>(cycles, loop.length - ((pc - loop.head) & (MEMORY_SIZE - 1)) / 2u);
+		Run(consumed);
+		if (counter != loop.head) {
+			return consumed;
+		}
+		loop = FindIdleLoop();
+		if (loop.kind == Idle::None) {
+			return consumed;
+		}
+	}
 
+	uint64_t iterations = (cycles - consumed) / loop.length;
+	if (iterations > 0 && loop.kind == Idle::TimerPoll) {
+		registers[(OpcodeAt(loop.head) >> 8u) & 0xFu] = delay;
+	}
+	return consumed + iterations * loop.length;
+}
+
+bool Chip8::CoreFromName(char const* name, Core& found)
+{
+	static struct { char const* name; Core core; } const names[] = {
+		{ "table", Core::Table },
+		{ "switch", Core::Switch },
+		{ "cached", Core::Cached },
+		{ "jit", Core::Jit },
+		{ "aot", Core::Aot },
+	};
+
+	for (auto const& entry : names) {
+		if (std::strcmp(name, entry.name) == 0) {
+			found = entry.core;
+			return true;
+		}
+	}
+	return false;
+}
+
+//Called 60 times per second of guest time, independent of how many instructions ran.
+void Chip8::TickTimers()
+{
 	//Decrement the delay timer if it's been set
 	if (delay > 0)
 	{
@@ -119,45 +276,922 @@ void Chip8::Cycle()
 	}
 }
 
+uint32_t Chip8::TakeDirtyRows()
+{
+	uint32_t rows = dirtyRows;
+	dirtyRows = 0;
+	return rows;
+}
+
+uint8_t Chip8::TakeFaults()
+{
+	uint8_t raised = faults;
+	faults = 0;
+	return raised;
+}
+
+void Chip8::Seed(uint32_t seed)
+{
+	random.Seed(seed);
+}
+
+//FNV-1a over the packed rows. Two machines showing the same picture hash the same.
+uint64_t Chip8::DisplayHash() const
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (uint64_t row : display) {
+		for (unsigned int i = 0; i < sizeof(row); i++) {
+			hash ^= (row >> (i * 8u)) & 0xFFu;
+			hash *= 0x100000001B3ull;
+		}
+	}
+	return hash;
+}
+
+//What copy assignment does, but the machine state goes over as one block. The implicit operator=
+//copies each array with an element loop, several times slower. Chip8State is trivially copyable, so
+//assigning it is a single memcpy (done through the base rather than by hand, since a memcpy onto a
+//base class subobject may overwrite derived members placed in its tail padding).
+void Chip8::Reset(Chip8 const& pristine)
+{
+	if (this == &pristine) {
+		return;
+	}
+
+	static_cast<Chip8State&>(*this) = pristine;
+	core = pristine.core;
+	ClearDecoded();					//both caches end up empty and keep their storage,
+	jit = pristine.jit;				//the Jit's code buffer stays mapped
+	aot = pristine.aot;
+	aotStale = pristine.aotStale;
+	aotCode = pristine.aotCode;
+#ifdef CHIP8_PROFILE
+	profiler = pristine.profiler;
+#endif
+}
+
+bool Chip8::SameState(Chip8 const& other) const
+{
+	return std::memcmp(registers, other.registers, sizeof(registers)) == 0
+		&& std::memcmp(memory, other.memory, sizeof(memory)) == 0
+		&& index == other.index
+		&& counter == other.counter
+		&& std::memcmp(stack, other.stack, sizeof(stack)) == 0
+		&& sPtr == other.sPtr
+		&& delay == other.delay
+		&& sound == other.sound
+		&& std::memcmp(display, other.display, sizeof(display)) == 0
+		&& random.state == other.random.state;
+}
+
+void Chip8::SaveState(Snapshot& snapshot) const
+{
+	snapshot.magic = SNAPSHOT_MAGIC;
+	snapshot.version = SNAPSHOT_VERSION;
+	snapshot.random = random.state;
+	snapshot.index = index;
+	snapshot.counter = counter;
+	std::memcpy(snapshot.registers, registers, sizeof(registers));
+	std::memcpy(snapshot.stack, stack, sizeof(stack));
+	snapshot.sPtr = sPtr;
+	snapshot.delay = delay;
+	snapshot.sound = sound;
+	std::memset(snapshot.reserved, 0, sizeof(snapshot.reserved));
+	std::memcpy(snapshot.input, input, sizeof(input));
+	std::memcpy(snapshot.display, display, sizeof(display));
+	std::memcpy(snapshot.memory, memory, sizeof(memory));
+}
+
+bool Chip8::LoadState(Snapshot const& snapshot)
+{
+	if (snapshot.magic != SNAPSHOT_MAGIC || snapshot.version != SNAPSHOT_VERSION) {
+		return false;
+	}
+
+	//Decoded and translated code is only thrown away where memory actually differs,
+	//so restoring into the same program (the usual case) keeps both caches warm.
+	const unsigned int block = 64;
+	for (unsigned int address = 0; address < MEMORY_SIZE; address += block) {
+		if (std::memcmp(&memory[address], &snapshot.memory[address], block) != 0) {
+			std::memcpy(&memory[address], &snapshot.memory[address], block);
+			Invalidate(address, block);
+		}
+	}
+
+	if (std::memcmp(display, snapshot.display, sizeof(display)) != 0) {
+		std::memcpy(display, snapshot.display, sizeof(display));
+		dirtyRows = ALL_ROWS;
+		displayGeneration++;
+	}
+
+	random.state = snapshot.random;
+	index = snapshot.index;
+	counter = snapshot.counter;
+	std::memcpy(registers, snapshot.registers, sizeof(registers));
+	std::memcpy(stack, snapshot.stack, sizeof(stack));
+	sPtr = snapshot.sPtr;
+	delay = snapshot.delay;
+	sound = snapshot.sound;
+	std::memcpy(input, snapshot.input, sizeof(input));
+	return true;
+}
+
+bool Chip8::SaveState(char const* filename) const
+{
+	Snapshot snapshot;
+	SaveState(snapshot);
+
+	std::ofstream file(filename, std::ios::binary);
+	file.write(reinterpret_cast<char const*>(&snapshot), sizeof(snapshot));
+	return file.good();
+}
+
+bool Chip8::LoadState(char const* filename)
+{
+	Snapshot snapshot;
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.read(reinterpret_cast<char*>(&snapshot), sizeof(snapshot))) {
+		return false;	//missing or truncated
+	}
+	return LoadState(snapshot);
+}
+
+void Chip8::RunUnchecked(uint64_t cycles)
+{
+	RunTable<false>(cycles);
+}
+
+template <bool Hardened>
+void Chip8::RunTable(uint64_t cycles)
+{
+	for (uint64_t i = 0; i < cycles; i++) {
+		//Fetch		//memory is 0x00, while opcodes are 0x0000. Shift left then add next to get full opcode
+		size_t pc = counter;
+		opcode = !Hardened || pc < MEMORY_MASK ? (memory[pc] << 8u) | memory[pc + 1] : OpcodeAt(pc);
+
+		//Increment counter to the next opcode before executing
+		counter = pc + 2;
+
+		//Decode and Execute 
+		//Determine which group the opcode belongs in using first digit
+		//Then, shift to rightmost digit to access master table indices (0 - F).
+		//From there, function pointer does it
+		((*this).*(table<Hardened>[(opcode & 0xF000u) >> 12u]))();
+	}
+}
+
+//GCC and Clang support taking the address of a label, which lets every handler jump straight
+//to the next one (threaded dispatch) instead of going back through a single switch.
+#if defined(__GNUC__) && !defined(CHIP8_NO_COMPUTED_GOTO)
+#define CHIP8_COMPUTED_GOTO
+#endif
+
+//Flat interpreter. The opcode is decoded once into locals and the program counter
+//stays in a register until the loop exits. Sub-groups are keyed exactly like table0/8/E/F so both
+//cores treat unknown opcodes the same way.
+//With ToTranslated, it also stops as soon as the program counter reaches an address the Jit has a block
+//for, or has just seen often enough to translate. Returns the budget left over.
+template <bool ToTranslated>
+uint64_t Chip8::RunSwitch(uint64_t cycles)
+{
+	if (cycles == 0) {
+		return 0;
+	}
+
+	uint8_t* const V = registers;
+	uint8_t* const mem = memory;
+	uint16_t pc = counter;
+	unsigned int op, x, y, kk, nnn;
+
+//Past 0xFFE the opcode wraps around to 0x000. A compare the predictor always gets right is cheaper
+//than masking both bytes of every fetch.
+#define FETCH()											\
+	op = pc < MEMORY_MASK ? (mem[pc] << 8u) | mem[pc + 1] : OpcodeAt(pc);	\
+	pc += 2;											\
+	x = (op >> 8u) & 0xFu;								\
+	y = (op >> 4u) & 0xFu;								\
+	kk = op & 0xFFu;									\
+	nnn = op & 0xFFFu
+
+#ifdef CHIP8_COMPUTED_GOTO
+	static void* const dispatch[0xF + 1] = {
+		&&group0, &&op1nnn, &&op2nnn, &&op3xkk, &&op4xkk, &&op5xy0, &&op6xkk, &&op7xkk,
+		&&group8, &&op9xy0, &&opAnnn, &&opBnnn, &&opCxkk, &&opDxyn, &&groupE, &&groupF
+	};
+#define CASE(label, value) label:
+#define DISPATCH() goto *dispatch[op >> 12u];
+#define NEXT()											\
+	if (--cycles == 0) { goto done; }					\
+	if (ToTranslated && Translated(pc)) { goto done; }	\
+	FETCH();											\
+	goto *dispatch[op >> 12u]
+#else
+#define CASE(label, value) case value:
+#define DISPATCH() switch (op >> 12u)
+#define NEXT() goto next
+	for (;;) {
+#endif
+
+	FETCH();
+	DISPATCH()
+	{
+		CASE(group0, 0x0)
+			if ((op & 0xFu) == 0x0u) {			//00E0 CLS
+				ClearDisplay();
+			} else if ((op & 0xFu) == 0xEu) {	//00EE RET
+				pc = Pop();
+			}
+			NEXT();
+
+		CASE(op1nnn, 0x1)						//JP nnn
+			pc = nnn;
+			NEXT();
+
+		CASE(op2nnn, 0x2)						//CALL nnn
+			Push(pc);
+			pc = nnn;
+			NEXT();
+
+		CASE(op3xkk, 0x3)						//SE Vx, byte
+			if (V[x] == kk) {
+				pc += 2;
+			}
+			NEXT();
+
+		CASE(op4xkk, 0x4)						//SNE Vx, byte
+			if (V[x] != kk) {
+				pc += 2;
+			}
+			NEXT();
+
+		CASE(op5xy0, 0x5)						//SE Vx, Vy
+			if (V[x] == V[y]) {
+				pc += 2;
+			}
+			NEXT();
+
+		CASE(op6xkk, 0x6)						//LD Vx, byte
+			V[x] = kk;
+			NEXT();
+
+		CASE(op7xkk, 0x7)						//ADD Vx, byte
+			V[x] += kk;
+			NEXT();
+
+		CASE(group8, 0x8)
+			switch (op & 0xFu)
+			{
+				case 0x0: V[x] = V[y]; break;
+				case 0x1: V[x] |= V[y]; break;
+				case 0x2: V[x] &= V[y]; break;
+				case 0x3: V[x] ^= V[y]; break;
+				case 0x4:
+				{
+					unsigned int sum = V[x] + V[y];
+					V[0xF] = sum > 255u;
+					V[x] = sum & 0xFFu;
+				} break;
+				case 0x5:
+				{
+					V[0xF] = V[x] > V[y];
+					V[x] -= V[y];
+				} break;
+				case 0x6:
+				{
+					V[0xF] = V[x] & 0x1u;
+					V[x] >>= 1;
+				} break;
+				case 0x7:
+				{
+					V[0xF] = V[y] > V[x];
+					V[x] = V[y] - V[x];
+				} break;
+				case 0xE:
+				{
+					V[0xF] = (V[x] & 0x80u) >> 7u;
+					V[x] <<= 1;
+				} break;
+			}
+			NEXT();
+
+		CASE(op9xy0, 0x9)						//SNE Vx, Vy
+			if (V[x] != V[y]) {
+				pc += 2;
+			}
+			NEXT();
+
+		CASE(opAnnn, 0xA)						//LD I, nnn
+			index = nnn;
+			NEXT();
+
+		CASE(opBnnn, 0xB)						//JP V0, nnn
+			pc = nnn + V[0x0];
+			NEXT();
+
+		CASE(opCxkk, 0xC)						//RND Vx, byte
+			V[x] = random.NextByte() & kk;
+			NEXT();
+
+		CASE(opDxyn, 0xD)						//DRW Vx, Vy, nibble
+			DrawSprite(x, y, op & 0xFu);
+			NEXT();
+
+		CASE(groupE, 0xE)
+			if ((op & 0xFu) == 0xEu) {			//Ex9E SKP Vx
+				if (input[V[x] & KEY_MASK]) {
+					pc += 2;
+				}
+			} else if ((op & 0xFu) == 0x1u) {	//ExA1 SKNP Vx
+				if (!input[V[x] & KEY_MASK]) {
+					pc += 2;
+				}
+			}
+			NEXT();
+
+		CASE(groupF, 0xF)
+			switch (kk)
+			{
+				case 0x07: V[x] = delay; break;
+				case 0x0A:
+				{
+					if (!WaitKey(x)) {
+						pc -= 2;
+					}
+				} break;
+				case 0x15: delay = V[x]; break;
+				case 0x18: sound = V[x]; break;
+				case 0x1E: index += V[x]; break;
+				case 0x29: index = FONTSET_START + (5 * V[x]); break;
+				case 0x33:
+				{
+					uint8_t value = V[x];
+					mem[(index + 2) & MEMORY_MASK] = value % 10;
+					mem[(index + 1) & MEMORY_MASK] = (value / 10) % 10;
+					mem[index & MEMORY_MASK] = value / 100;
+					Invalidate(index, 3);
+				} break;
+				case 0x55:
+				{
+					for (unsigned int i = 0; i <= x; i++) {
+						mem[(index + i) & MEMORY_MASK] = V[i];
+					}
+					Invalidate(index, x + 1);
+				} break;
+				case 0x65:
+				{
+					for (unsigned int i = 0; i <= x; i++) {
+						V[i] = mem[(index + i) & MEMORY_MASK];
+					}
+				} break;
+			}
+			NEXT();
+	}
+
+#ifdef CHIP8_COMPUTED_GOTO
+done:
+#else
+	next:
+		if (--cycles == 0) {
+			break;
+		}
+		if (ToTranslated && Translated(pc)) {
+			break;
+		}
+	}
+#endif
+
+	counter = pc;
+	return cycles;
+
+#undef FETCH
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+}
+
+
+//Decodes the instruction at `address` all the way down to its handler.
+//Sub-groups are keyed by the same digits as table0/8/E/F.
+Chip8::Decoded Chip8::Decode(uint16_t address) const
+{
+	uint16_t op = (memory[address] << 8u) | memory[(address + 1) & (MEMORY_SIZE - 1)];
+
+	Decoded entry;
+	entry.handler = H_NULL;
+	entry.x = (op >> 8u) & 0xFu;
+	entry.y = (op >> 4u) & 0xFu;
+	entry.n = op & 0xFu;
+	entry.kk = op & 0xFFu;
+	entry.nnn = op & 0xFFFu;
+
+	static Handler const group8[0xF + 1] = {
+		H_8xy0, H_8xy1, H_8xy2, H_8xy3, H_8xy4, H_8xy5, H_8xy6, H_8xy7,
+		H_NULL, H_NULL, H_NULL, H_NULL, H_NULL, H_NULL, H_8xyE, H_NULL
+	};
+
+	switch (op >> 12u)
+	{
+		case 0x0:
+		{
+			if (entry.n == 0x0) {
+				entry.handler = H_00E0;
+			} else if (entry.n == 0xE) {
+				entry.handler = H_00EE;
+			}
+		} break;
+		case 0x1: entry.handler = H_1nnn; break;
+		case 0x2: entry.handler = H_2nnn; break;
+		case 0x3: entry.handler = H_3xkk; break;
+		case 0x4: entry.handler = H_4xkk; break;
+		case 0x5: entry.handler = H_5xy0; break;
+		case 0x6: entry.handler = H_6xkk; break;
+		case 0x7: entry.handler = H_7xkk; break;
+		case 0x8: entry.handler = group8[entry.n]; break;
+		case 0x9: entry.handler = H_9xy0; break;
+		case 0xA: entry.handler = H_Annn; break;
+		case 0xB: entry.handler = H_Bnnn; break;
+		case 0xC: entry.handler = H_Cxkk; break;
+		case 0xD: entry.handler = H_Dxyn; break;
+		case 0xE:
+		{
+			if (entry.n == 0xE) {
+				entry.handler = H_Ex9E;
+			} else if (entry.n == 0x1) {
+				entry.handler = H_ExA1;
+			}
+		} break;
+		case 0xF:
+		{
+			switch (entry.kk)
+			{
+				case 0x07: entry.handler = H_Fx07; break;
+				case 0x0A: entry.handler = H_Fx0A; break;
+				case 0x15: entry.handler = H_Fx15; break;
+				case 0x18: entry.handler = H_Fx18; break;
+				case 0x1E: entry.handler = H_Fx1E; break;
+				case 0x29: entry.handler = H_Fx29; break;
+				case 0x33: entry.handler = H_Fx33; break;
+				case 0x55: entry.handler = H_Fx55; break;
+				case 0x65: entry.handler = H_Fx65; break;
+			}
+		} break;
+	}
+
+	return entry;
+}
 
-//copied from site austinmorlan.com
-void Chip8::LoadROM(char const* filename)
+//A write to `address` changes the opcode starting there and the one starting a byte before it.
+//Only those entries are dropped, the rest of the cache stays valid.
+//True if that dropped a translated block, so a block that made the write knows to stop.
+bool Chip8::Invalidate(uint16_t address, unsigned int length)
 {
-	// Open the file as a stream of binary and move the file pointer to the end
-	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	address &= MEMORY_MASK;
+	if (address + length > MEMORY_SIZE) {		//the write wrapped around past 0xFFF
+		unsigned int end = MEMORY_SIZE - address;
+		bool dropped = Invalidate(address, end);
+		return Invalidate(0, length - end) | dropped;
+	}
 
-	if (file.is_open())
+	bool dropped = jit.Invalidate(address, length);
+	if (aot != nullptr) {
+		InvalidateAot(address, length);
+	}
+
+	if (decoded.empty()) {
+		return dropped;
+	}
+
+	unsigned int first = (address > 0) ? address - 1u : 0u;
+	unsigned int last = address + length;
+	for (unsigned int i = first; i < last && i < MEMORY_SIZE; i++) {
+		decoded[i].handler = H_DECODE;
+	}
+	return dropped;
+}
+
+//Only the entries decoded since the last call are reset, so a program that ran a few dozen
+//addresses (a fuzz input) does not pay for rewriting all MEMORY_SIZE of them.
+void Chip8::ClearDecoded()
+{
+	if (decodedUsed.size() >= MEMORY_SIZE) {	//stopped listing, reset everything
+		std::fill(decoded.begin(), decoded.end(), Decoded{ H_DECODE, 0, 0, 0, 0, 0 });
+	} else {
+		for (uint16_t address : decodedUsed) {
+			decoded[address].handler = H_DECODE;
+		}
+	}
+	decodedUsed.clear();
+}
+
+//Same loop as RunSwitch, but fetch/decode is replaced by a lookup into decoded[].
+//Each handler id maps directly to its label, so every opcode costs one indirect jump.
+void Chip8::RunCached(uint64_t cycles)
+{
+	if (cycles == 0) {
+		return;
+	}
+
+	if (decoded.empty()) {
+		decoded.assign(MEMORY_SIZE, Decoded{ H_DECODE, 0, 0, 0, 0, 0 });
+	}
+
+	uint8_t* const V = registers;
+	uint8_t* const mem = memory;
+	Decoded* const cache = decoded.data();
+	uint16_t pc = counter;
+	Decoded d;
+
+#define FETCH()											\
+	d = cache[pc & (MEMORY_SIZE - 1)];					\
+	pc += 2
+
+#ifdef CHIP8_COMPUTED_GOTO
+	static void* const dispatch[H_COUNT] = {
+		&&decode, &&opNULL, &&op00E0, &&op00EE, &&op1nnn, &&op2nnn, &&op3xkk, &&op4xkk, &&op5xy0, &&op6xkk, &&op7xkk,
+		&&op8xy0, &&op8xy1, &&op8xy2, &&op8xy3, &&op8xy4, &&op8xy5, &&op8xy6, &&op8xy7, &&op8xyE,
+		&&op9xy0, &&opAnnn, &&opBnnn, &&opCxkk, &&opDxyn, &&opEx9E, &&opExA1,
+		&&opFx07, &&opFx0A, &&opFx15, &&opFx18, &&opFx1E, &&opFx29, &&opFx33, &&opFx55, &&opFx65
+	};
+#define CASE(label, value) label:
+#define DISPATCH() goto *dispatch[d.handler];
+#define REDISPATCH() goto *dispatch[d.handler]
+#define NEXT()											\
+	if (--cycles == 0) { goto done; }					\
+	FETCH();											\
+	goto *dispatch[d.handler]
+#else
+#define CASE(label, value) case value:
+#define DISPATCH() redispatch: switch (d.handler)
+#define REDISPATCH() goto redispatch
+#define NEXT() goto next
+	for (;;) {
+#endif
+
+	FETCH();
+	DISPATCH()
 	{
-		// Get size of file and allocate a buffer to hold the contents
-		std::streampos size = file.tellg();
-		char* buffer = new char[size];
+		CASE(decode, H_DECODE)					//first visit: decode, store, then run it
+		{
+			uint16_t address = (pc - 2) & (MEMORY_SIZE - 1);
+			d = cache[address] = Decode(address);
+			if (decodedUsed.size() < MEMORY_SIZE) {
+				decodedUsed.push_back(address);
+			}
+			REDISPATCH();
+		}
+
+		CASE(opNULL, H_NULL)
+			NEXT();
+
+		CASE(op00E0, H_00E0)
+			ClearDisplay();
+			NEXT();
+
+		CASE(op00EE, H_00EE)
+			pc = Pop();
+			NEXT();
+
+		CASE(op1nnn, H_1nnn)
+			pc = d.nnn;
+			NEXT();
+
+		CASE(op2nnn, H_2nnn)
+			Push(pc);
+			pc = d.nnn;
+			NEXT();
+
+		CASE(op3xkk, H_3xkk)
+			if (V[d.x] == d.kk) {
+				pc += 2;
+			}
+			NEXT();
+
+		CASE(op4xkk, H_4xkk)
+			if (V[d.x] != d.kk) {
+				pc += 2;
+			}
+			NEXT();
 
-		// Go back to the beginning of the file and fill the buffer
-		file.seekg(0, std::ios::beg);
-		file.read(buffer, size);
-		file.close();
+		CASE(op5xy0, H_5xy0)
+			if (V[d.x] == V[d.y]) {
+				pc += 2;
+			}
+			NEXT();
+
+		CASE(op6xkk, H_6xkk)
+			V[d.x] = d.kk;
+			NEXT();
+
+		CASE(op7xkk, H_7xkk)
+			V[d.x] += d.kk;
+			NEXT();
+
+		CASE(op8xy0, H_8xy0)
+			V[d.x] = V[d.y];
+			NEXT();
+
+		CASE(op8xy1, H_8xy1)
+			V[d.x] |= V[d.y];
+			NEXT();
 
-		// Load the ROM contents into the Chip8's memory, starting at 0x200
-		for (long i = 0; i < size; ++i)
+		CASE(op8xy2, H_8xy2)
+			V[d.x] &= V[d.y];
+			NEXT();
+
+		CASE(op8xy3, H_8xy3)
+			V[d.x] ^= V[d.y];
+			NEXT();
+
+		CASE(op8xy4, H_8xy4)
 		{
-			memory[START_ADDRESS + i] = buffer[i];
+			unsigned int sum = V[d.x] + V[d.y];
+			V[0xF] = sum > 255u;
+			V[d.x] = sum & 0xFFu;
 		}
+			NEXT();
+
+		CASE(op8xy5, H_8xy5)
+			V[0xF] = V[d.x] > V[d.y];
+			V[d.x] -= V[d.y];
+			NEXT();
+
+		CASE(op8xy6, H_8xy6)
+			V[0xF] = V[d.x] & 0x1u;
+			V[d.x] >>= 1;
+			NEXT();
+
+		CASE(op8xy7, H_8xy7)
+			V[0xF] = V[d.y] > V[d.x];
+			V[d.x] = V[d.y] - V[d.x];
+			NEXT();
+
+		CASE(op8xyE, H_8xyE)
+			V[0xF] = (V[d.x] & 0x80u) >> 7u;
+			V[d.x] <<= 1;
+			NEXT();
+
+		CASE(op9xy0, H_9xy0)
+			if (V[d.x] != V[d.y]) {
+				pc += 2;
+			}
+			NEXT();
+
+		CASE(opAnnn, H_Annn)
+			index = d.nnn;
+			NEXT();
+
+		CASE(opBnnn, H_Bnnn)
+			pc = d.nnn + V[0x0];
+			NEXT();
 
-		// Free the buffer
-		delete[] buffer;
+		CASE(opCxkk, H_Cxkk)
+			V[d.x] = random.NextByte() & d.kk;
+			NEXT();
+
+		CASE(opDxyn, H_Dxyn)
+			DrawSprite(d.x, d.y, d.n);
+			NEXT();
+
+		CASE(opEx9E, H_Ex9E)
+			if (input[V[d.x] & KEY_MASK]) {
+				pc += 2;
+			}
+			NEXT();
+
+		CASE(opExA1, H_ExA1)
+			if (!input[V[d.x] & KEY_MASK]) {
+				pc += 2;
+			}
+			NEXT();
+
+		CASE(opFx07, H_Fx07)
+			V[d.x] = delay;
+			NEXT();
+
+		CASE(opFx0A, H_Fx0A)
+			if (!WaitKey(d.x)) {
+				pc -= 2;
+			}
+			NEXT();
+
+		CASE(opFx15, H_Fx15)
+			delay = V[d.x];
+			NEXT();
+
+		CASE(opFx18, H_Fx18)
+			sound = V[d.x];
+			NEXT();
+
+		CASE(opFx1E, H_Fx1E)
+			index += V[d.x];
+			NEXT();
+
+		CASE(opFx29, H_Fx29)
+			index = FONTSET_START + (5 * V[d.x]);
+			NEXT();
+
+		CASE(opFx33, H_Fx33)
+		{
+			uint8_t value = V[d.x];
+			mem[(index + 2) & MEMORY_MASK] = value % 10;
+			mem[(index + 1) & MEMORY_MASK] = (value / 10) % 10;
+			mem[index & MEMORY_MASK] = value / 100;
+			Invalidate(index, 3);
+		}
+			NEXT();
+
+		CASE(opFx55, H_Fx55)
+			for (unsigned int i = 0; i <= d.x; i++) {
+				mem[(index + i) & MEMORY_MASK] = V[i];
+			}
+			Invalidate(index, d.x + 1);
+			NEXT();
+
+		CASE(opFx65, H_Fx65)
+			for (unsigned int i = 0; i <= d.x; i++) {
+				V[i] = mem[(index + i) & MEMORY_MASK];
+			}
+			NEXT();
+
+#ifndef CHIP8_COMPUTED_GOTO
+		default:
+			NEXT();
+#endif
+	}
+
+#ifdef CHIP8_COMPUTED_GOTO
+done:
+#else
+	next:
+		if (--cycles == 0) {
+			break;
+		}
+	}
+#endif
+
+	counter = pc;
+
+#undef FETCH
+#undef CASE
+#undef DISPATCH
+#undef REDISPATCH
+#undef NEXT
+}
+
+
+//Runs translated blocks, each stopping wherever the budget runs out. From an address the JIT does not
+//translate (or not yet), the switch core runs on until it reaches one it does.
+void Chip8::RunJit(uint64_t cycles)
+{
+	static ::Jit::Helpers const helpers{
+		[](Chip8& machine, unsigned int x, unsigned int y, unsigned int rows) { machine.DrawSprite(x, y, rows); },
+		[](Chip8& machine) { machine.ClearDisplay(); },
+		[](Chip8& machine, unsigned int address, unsigned int length) { return machine.Invalidate(address, length); },
+	};
+
+	while (cycles > 0) {
+		::Jit::Block const* block = nullptr;
+		if (counter + 1u < MEMORY_SIZE) {
+			block = jit.Lookup(counter, memory, helpers);
+		}
+
+		if (block == nullptr) {
+			cycles = RunSwitch<true>(cycles);
+			continue;
+		}
+
+		::Jit::Exit exit = jit.Run(*block, static_cast<Chip8State*>(this), cycles, this);
+		counter = exit.counter;
+		cycles = exit.cycles;
+	}
+}
+
+//A translated block is stale while its bytes differ from the ROM, so a rewind that restores
+//them brings the translation back.
+void Chip8::InvalidateAot(uint16_t address, unsigned int length)
+{
+	//Most stores go to data, only search the blocks if one of the bytes was translated
+	unsigned int last = address + length;
+	bool code = false;
+	for (unsigned int i = address; i < last; i++) {
+		code |= aotCode[i] != 0;
+	}
+	if (!code) {
+		return;
+	}
+
+	for (size_t i = 0; i < aot->blockCount; i++) {
+		AotBlock const& block = aot->blocks[i];
+		if (block.address < last && address < block.address + block.bytes) {
+			aotStale[block.address] = std::memcmp(&memory[block.address], &aot->image[block.address - START_ADDRESS], block.bytes) != 0;
+		}
+	}
+}
+
+//Translated code runs until it reaches an address it has nothing (current) for, then the switch
+//core runs that one opcode and hands back.
+void Chip8::RunAot(uint64_t cycles)
+{
+	if (aot == nullptr) {
+		RunSwitch(cycles);
+		return;
+	}
+
+	AotContext context{ registers, memory, &index, stack, &sPtr, &faults, &delay, &sound, input, aotStale.data(), this,
+		[](Chip8& machine, uint8_t Vx, uint8_t Vy, uint8_t n) { machine.DrawSprite(Vx, Vy, n); },
+		[](Chip8& machine) { machine.ClearDisplay(); },
+		[](Chip8& machine) { return machine.random.NextByte(); },
+		[](Chip8& machine, uint8_t Vx) { return machine.WaitKey(Vx); },
+		[](Chip8& machine, uint16_t address, unsigned int length) { machine.Invalidate(address, length); },
+	};
+
+	while (cycles > 0) {
+		counter = aot->run(context, counter, cycles);
+		if (cycles > 0) {
+			RunSwitch(1);
+			cycles--;
+		}
+	}
+}
+
+#ifdef CHIP8_PROFILE
+//One opcode at a time, so each one can be attributed to its address and handler.
+void Chip8::RunProfiled(uint64_t cycles)
+{
+	static_assert(H_COUNT == PROFILE_HANDLERS, "Profiler handler names are out of step with Chip8::Handler");
+
+	for (uint64_t i = 0; i < cycles; i++) {
+		uint16_t address = counter & (MEMORY_SIZE - 1);
+		Handler handler = Decode(address).handler;
+		RunSwitch(1);
+		profiler->Record(address, handler, handler == H_Fx0A && counter == address);
+	}
+}
+#endif
+
+//Memory-mapped, so the file is never copied into a temporary buffer first.
+RomError Chip8::LoadROM(char const* filename)
+{
+	RomFile rom;
+	RomError error = rom.Open(filename);
+	if (error == RomError::None) {
+		LoadROM(rom.Data(), rom.Size());
 	}
+	return error;
+}
+
+//Loads a ROM that is already in memory, e.g. one image shared by many machines in a batch.
+bool Chip8::LoadROM(uint8_t const* data, size_t size)
+{
+	if (size > MEMORY_SIZE - START_ADDRESS) {
+		return false;
+	}
+
+	// Load the ROM contents into the Chip8's memory, starting at 0x200
+	std::memcpy(&memory[START_ADDRESS], data, size);
+
+	// Anything decoded or translated before belongs to the previous program
+	ClearDecoded();
+	jit.Clear();
+	aot = FindAotProgram(data, size);
+	aotStale.assign(aot != nullptr ? MEMORY_SIZE : 0, 0);
+	aotCode.assign(aot != nullptr ? MEMORY_SIZE : 0, 0);
+	for (size_t i = 0; aot != nullptr && i < aot->blockCount; i++) {
+		AotBlock const& block = aot->blocks[i];
+		std::memset(&aotCode[block.address], 1, block.bytes);
+	}
+	return true;
 }
 
 //Instruction implementation
 void Chip8::OP_00E0()	//CLS; clear display
 {
+	ClearDisplay();
+}
+
+void Chip8::ClearDisplay()
+{
+	if (displayGeneration == clearedGeneration) {	//nothing drawn since the last clear (0000 is a CLS too,
+		return;										//so zeroed memory runs straight into this)
+	}
+
+	uint32_t cleared = 0;
+	for (unsigned int y = 0; y < VIDEO_HEIGHT; y++) {
+		if (display[y] != 0) {		//only rows that had something on them change
+			cleared |= 1u << y;
+		}
+	}
+	dirtyRows |= cleared;
+	displayGeneration += (cleared != 0);
+	clearedGeneration = displayGeneration;
+
 	std::memset(display, 0, sizeof(display));
 }
 
+template <bool Hardened>
 void Chip8::OP_00EE()	//RET; return subroutine;	counter to address at top of stack, stack pointer - 1
 {
-	--sPtr;
-	counter = stack[sPtr];
+	counter = Pop<Hardened>();
 }
 
 void Chip8::OP_1nnn()	//JP; set program counter to address nnn
@@ -166,11 +1200,11 @@ void Chip8::OP_1nnn()	//JP; set program counter to address nnn
 	counter = address;						//The & bitwise operator is like && but for smaller data.		101101100
 }											//																000100100
 
-void Chip8::OP_2nnn()	//CALL;	subroutine at nnn;	Increment stack pointer, current counter on top of stack, then set to nnn.
+template <bool Hardened>
+void Chip8::OP_2nnn()	//CALL;	subroutine at nnn;	Current counter on top of stack, increment stack pointer, then set to nnn.
 {												//0x0FFFu	 F represents the digits we want to grab.
 	uint16_t address = opcode & 0x0FFFu;		//When we use CALL, we want to increment the stack such that PC doesn't return to CALL.
-	++sPtr;										
-	stack[sPtr] = counter;						//So we increment to the next instruction so that PC doesn't return to CALL.
+	Push<Hardened>(counter);					//Push first, then move the pointer up, so 00EE's Pop() lands back on this slot.
 	counter = address;
 }
 
@@ -199,7 +1233,7 @@ void Chip8::OP_5xy0()	//SE Vx, Vy; If registers Vx == Vy, skip next instruction.
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;	//Grab Vx and Vy, shift both to rightmost.
 	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
-	if (registers[Vx] -= registers[Vy]) {
+	if (registers[Vx] == registers[Vy]) {
 		counter += 2;
 	}
 }
@@ -214,7 +1248,7 @@ void Chip8::OP_6xkk()	//LD Vx, byte;	Put value kk into register Vx.
 
 void Chip8::OP_7xkk()	//ADD Vx, byte; Add value kk to value at register Vx, store at register Vx.
 {
-	uint8_t Vx = (opcode && 0x0F00u) >> 8u;
+	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t byte = opcode & 0x00FFu;
 
 	registers[Vx] += byte;
@@ -339,40 +1373,69 @@ void Chip8::OP_Cxkk()	//RND Vx, byte; set value of register Vx to random byte AN
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t kk = (opcode & 0x00FFu);
 
-	registers[Vx] = randByte(randNumGen) & kk;
+	registers[Vx] = random.NextByte() & kk;
 }
 
 //Read n-byte starting at memory location I, displayed as sprites at coordinate (Vx, Vy)
 //Sprites are XOR'd onto the screen (in case there are other sprites present).
 //If any sprites are deleted as a result of XOR, VF = 1, otherwise 0;
 //Any sprites on the edges should wrap around.
+template <bool Hardened>
 void Chip8::OP_Dxyn()	//DRW Vx, Vy, nibble;
 {						
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 	uint8_t nBytes = opcode & 0x000Fu;
 
-	uint8_t posX = registers[Vx] & VIDEO_WIDTH;	//video and screen will be visited again when we do graphics.
-	uint8_t posY = registers[Vy] & VIDEO_HEIGHT;
+	DrawSprite<Hardened>(Vx, Vy, nBytes);
+}
+
+//Sprites are 8 pixels wide, so a sprite row is its byte shifted into the top of a 64-bit row and
+//rotated right to posX. The rotation is what wraps pixels past the right edge back to the left.
+//Collision and XOR are then one AND and one XOR per row instead of a loop over every pixel.
+template <bool Hardened>
+void Chip8::DrawSprite(uint8_t Vx, uint8_t Vy, uint8_t nBytes)
+{
+	unsigned int posX = registers[Vx] % VIDEO_WIDTH;	//starting position wraps as well
+	unsigned int posY = registers[Vy] % VIDEO_HEIGHT;
+	uint64_t collision = 0;
+	bool changed = false;
 
 	for (unsigned int row = 0; row < nBytes; row++) {
-		uint8_t spriteByte = memory[index + row];
+		uint64_t spriteRow = (uint64_t)memory[Wrap<Hardened>(index + row, MEMORY_MASK)] << (VIDEO_WIDTH - 8u);
+		spriteRow = (spriteRow >> posX) | (spriteRow << ((VIDEO_WIDTH - posX) % VIDEO_WIDTH));
 
-		for (unsigned int col = 0; col < 8; col++) {	//8 bit int = 8 columns.
-			//0x8u is the leftmost digit = 1. Rightshift by col to set each column to '1' (on).
-			uint8_t spritePixel = spriteByte & (0x8u >> col);
-			uint32_t* screenPixel = &display[(posY + row) * VIDEO_WIDTH + (posX + col)];
+		unsigned int y = (posY + row) % VIDEO_HEIGHT;
+		collision |= display[y] & spriteRow;	//any pixel already on is about to be erased
+		display[y] ^= spriteRow;
 
-			if (spritePixel) {	//if the sprite pixel is on, check for collision
-				// Screen pixel also on - collision
-				if (*screenPixel == 0xFFFFFFFF)
-				{
-					registers[0xF] = 1;
-				}
+		if (spriteRow != 0) {					//an empty sprite row leaves the screen row as it was
+			dirtyRows |= 1u << y;
+			changed = true;
+		}
+	}
 
-				// Effectively XOR with the sprite pixel
-				*screenPixel ^= 0xFFFFFFFF;
-			}
+	registers[0xF] = (collision != 0);
+	displayGeneration += changed;
+}
+
+//The packed display only becomes 32-bit pixels here, when a front-end wants to show it.
+//Rows not set in `rows` are left untouched in `pixels`.
+void Chip8::RenderDisplay(uint32_t* pixels, uint32_t rows) const
+{
+	RenderDisplay(display, pixels, rows);
+}
+
+void Chip8::RenderDisplay(uint64_t const* display, uint32_t* pixels, uint32_t rows)
+{
+	for (unsigned int y = 0; y < VIDEO_HEIGHT; y++) {
+		if (!(rows & (1u << y))) {
+			continue;
+		}
+
+		uint64_t row = display[y];
+		for (unsigned int x = 0; x < VIDEO_WIDTH; x++) {
+			pixels[y * VIDEO_WIDTH + x] = ((row >> (VIDEO_WIDTH - 1u - x)) & 1u) ? 0xFFFFFFFF : 0;
 		}
 	}
 }
@@ -384,7 +1447,7 @@ void Chip8::OP_Ex9E()	//SKP Vx; Skip next instruction if key pressed = value at
 {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 	uint8_t key = registers[Vx];
-	if (input[key]) {
+	if (input[key & KEY_MASK]) {
 		counter += 2;
 	}
 }
@@ -393,7 +1456,7 @@ void Chip8::OP_ExA1()	//SKNP Vx; Ex9E, but NOT pressed.
 {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 	uint8_t key = registers[Vx];
-	if (!input[key]) {
+	if (!input[key & KEY_MASK]) {
 		counter += 2;
 	}
 }
@@ -408,6 +1471,13 @@ void Chip8::OP_Fx0A()	//LD Vx, K; Store the next pressed key value K in Vx.
 {											//Stops all execution until pressed. We 'wait' by decrementing counter by 2 if nothing pressed.
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;	//This is basically skipping but in reverse, always coming back to the same instruction.
 
+	if (!WaitKey(Vx)) {
+		counter -= 2;
+	}
+}
+
+bool Chip8::WaitKey(uint8_t Vx)	//Stores the first pressed key in Vx, false if nothing is pressed yet.
+{
 	bool inputCheck = false;
 	for (int i = 0; !inputCheck & (i < 16); i++) {
 		if (input[i]) {
@@ -415,9 +1485,7 @@ void Chip8::OP_Fx0A()	//LD Vx, K; Store the next pressed key value K in Vx.
 			inputCheck = true;
 		}
 	}
-	if (!inputCheck) {
-		counter -= 2;
-	}
+	return inputCheck;
 }
 
 void Chip8::OP_Fx15()	//LD DT, Vx; Set DT (delay timer) to Vx.
@@ -445,39 +1513,45 @@ void Chip8::OP_Fx29()	//LD F, Vx; Value of I set to hex sprite corresponding to
 	index = FONTSET_START + (5 * value); //FONTSET_START = 0x50, (5 * value) gets us the start of each char.
 }
 
+template <bool Hardened>
 void Chip8::OP_Fx33()	//LD B, Vx; Decimal Value of Vx. Hundreds in I, Tens in I + 1, Ones in I + 2.
 {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 	uint8_t value = registers[Vx];
 
 	for (int i = 0; i < 3; i++) {
-		memory[index + (2 - i)] = value % 10;
+		memory[Wrap<Hardened>(index + (2 - i), MEMORY_MASK)] = value % 10;
 		value /= 10;
 	}
+	Invalidate(index, 3);
 }
 
+template <bool Hardened>
 void Chip8::OP_Fx55()	//LD[I], Vx; Store registers V0 to Vx, starting at I.
 {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 
 	for (int i = 0; i <= Vx; i++) {
-		memory[index + i] = registers[i];
+		memory[Wrap<Hardened>(index + i, MEMORY_MASK)] = registers[i];
 	}
+	Invalidate(index, Vx + 1);
 }
 
+template <bool Hardened>
 void Chip8::OP_Fx65()	//LD Vx, [I]; Fx55, but read from I, store into registers V0 to Vx.
 {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 
 	for (int i = 0; i <= Vx; i++) {
-		registers[i] = memory[index + i];
+		registers[i] = memory[Wrap<Hardened>(index + i, MEMORY_MASK)];
 	}
 }
 
 //The below functions are used to parse through the sub-tables for the correct opcode.
+template <bool Hardened>
 void Chip8::Table0()
 {
-	((*this).*(table0[opcode & 0x000Fu]))();
+	((*this).*(table0<Hardened>[opcode & 0x000Fu]))();
 }
 
 void Chip8::Table8()
@@ -490,7 +1564,8 @@ void Chip8::TableE()
 	((*this).*(tableE[opcode & 0x000Fu]))();
 }
 
+template <bool Hardened>
 void Chip8::TableF()
 {
-	((*this).*(tableF[opcode & 0x00FFu]))();
+	((*this).*(tableF<Hardened>[opcode & 0x00FFu]))();
 }
\ No newline at end of file
@@ -3,8 +3,16 @@
 #ifndef CHIP_8_H
 #define CHIP_8_H
 
+#include "Aot.h"
+#include "Jit.h"
+#include "Random.h"
+#include "RomFile.h"
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <random>
+#include <initializer_list>
+#include <type_traits>
+#include <vector>
 
 const unsigned int KEY_COUNT = 16;
 const unsigned int VIDEO_WIDTH = 64;
@@ -12,30 +20,240 @@ const unsigned int VIDEO_HEIGHT = 32;
 const unsigned int REGISTER_COUNT = 16;
 const unsigned int MEMORY_SIZE = 4096;
 const unsigned int STACK_SIZE = 16;
+const unsigned int START_ADDRESS = 0x200;	//0x000 to 0x1FF is reserved, instructions start at 0x200
+const unsigned int FONTSET_START = 0x050;	//0x050-0x0A0
+const unsigned int FONTSET_SIZE = 80; //(16 * 10 (A) - 16 * 5 = 80)
+const uint32_t ALL_ROWS = 0xFFFFFFFFu;	//dirty row mask with every one of the 32 rows set
 
+//Every guest address, stack slot and key number is wrapped with these, in every core,
+//so no ROM can reach outside the machine's arrays. An AND costs nothing a bounds check would.
+//Chip8::RunUnchecked() is the one exception, kept to measure that claim.
+const unsigned int MEMORY_MASK = MEMORY_SIZE - 1;	//12-bit address space
+const unsigned int STACK_MASK = STACK_SIZE - 1;		//sPtr counts on, the slot it uses wraps at 16
+const unsigned int KEY_MASK = KEY_COUNT - 1;
 
-class Chip8
+extern uint8_t const fontset[FONTSET_SIZE];	//built-in 0-F characters, at FONTSET_START in every new machine
+
+//Interpreter core used when none is picked at runtime. CMake sets this from CHIP8_CORE.
+#ifndef CHIP8_DEFAULT_CORE
+#define CHIP8_DEFAULT_CORE Core::Switch
+#endif
+
+struct Snapshot;
+class Profiler;
+
+//Everything one machine is, as plain data. Chip8::Reset copies all of it from the pristine machine in
+//one go, so state added here is reset without Reset having to list it. Chip8 keeps only the core
+//choice and the caches (decoded, jit, aot) outside it.
+struct Chip8State
+{
+	uint8_t input[KEY_COUNT]{};			//16 inputs, all representing a hex value.
+	uint64_t display[VIDEO_HEIGHT]{};	//64 x 32 pixel display, one bit per pixel. Each row is a uint64, leftmost pixel in the top bit.
+	uint8_t registers[REGISTER_COUNT]{};		//16 registers, each can hold 8 bits.
+	uint8_t memory[MEMORY_SIZE];				//4096 bytes of memory, 8 bits in a byte. The constructor copies in initialMemory.
+	uint16_t index{};							//register that stores memory addresses. 16 bits.
+	uint16_t counter{ START_ADDRESS };			//register that holds the next instruction to execute in a program.
+	uint16_t stack[STACK_SIZE]{};				//stack holds 16 program counters.
+	uint8_t sPtr{};								//pointer for stack management.
+	uint8_t faults{};							//Fault bits, see Chip8::TakeFaults()
+	uint8_t delay{};							//Timer that decrements when > 0, at 60hz (TickTimers).
+	uint8_t sound{};							//Similar to delay, but for sounds
+	uint16_t opcode{};							//CPU instruction. uint16 is used because instructions can be specified to be hex.
+	uint32_t dirtyRows{ ALL_ROWS };				//everything is dirty until the first frame is shown
+	uint32_t displayGeneration{};
+	uint32_t clearedGeneration{};				//displayGeneration right after the last 00E0, the display is blank while they match
+	Random random;								//Cxkk bytes, seeded from the clock unless Seed() is called
+};
+
+static_assert(std::is_trivially_copyable_v<Chip8State>, "Chip8State must stay plain data, Chip8::Reset copies it in one go");
+
+class Chip8 : private Chip8State
 {
 	public:
+		//Every core runs the same instructions with the same results, they only differ in how opcodes are dispatched.
+		enum class Core
+		{
+			Table,		//member function pointer tables below, two indirect calls per opcode.
+			Switch,		//one switch (computed goto on GCC/Clang) with the decoded fields kept in locals.
+			Cached,		//Switch, but each address is decoded once into the decoded[] cache.
+			Jit,		//basic blocks translated to x86-64 (see Jit.h), interpreter for everything else.
+			Aot,		//the ROM translated ahead of time by chip8_aot (see Aot.h), else like Switch.
+		};
+
+		//Loops that cannot change anything but the program counter until a timer tick or a key change.
+		enum class Idle
+		{
+			None,
+			KeyWait,	//Fx0A with no key down
+			KeyPoll,	//Ex9E/ExA1 jumping back to itself until the key changes
+			TimerPoll,	//Fx07, 3xkk/4xkk on the same register, 1nnn back to the Fx07
+			Halt,		//1nnn to itself
+		};
+
+		//Guest errors the masks above turned into defined behaviour, see TakeFaults().
+		enum Fault : uint8_t
+		{
+			FAULT_STACK_OVERFLOW = 1u << 0,		//2nnn with all 16 slots in use, overwrites the oldest
+			FAULT_STACK_UNDERFLOW = 1u << 1,	//00EE with nothing on the stack (or less, after an earlier underflow)
+		};
+
 		Chip8();
-		void LoadROM(char const* filename);
+		RomError LoadROM(char const* filename);
+		bool LoadROM(uint8_t const* data, size_t size);	//false (nothing loaded) if it does not fit above START_ADDRESS
+		void Seed(uint32_t seed);	//replaces the clock seed, so Cxkk gives the same bytes on every run.
 		void Cycle();	//Used to parse through ROM instructions.
+		void Run(uint64_t cycles);	//Same as calling Cycle() `cycles` times, but stays inside the core's loop.
+		void TickTimers();			//60hz delay/sound timer decrement, driven by the Scheduler rather than per instruction.
+		bool SoundOn() const { return sound > 0; }	//the beeper sounds while the sound timer runs
+
+		//Core::Table with the memory and stack masks and the fault bits compiled out, for chip8_bench to
+		//compare against. Only for ROMs known to stay in bounds: anything else reads and writes outside
+		//the machine. Key numbers are still masked, the low nibble is what Ex9E/ExA1 test.
+		void RunUnchecked(uint64_t cycles);
+
+		//Accounts for up to `cycles` instructions of an idle loop without executing them, leaving the machine
+		//exactly as running them would. Returns how many it consumed (possibly a couple run normally to reach
+		//the top of the loop), 0 if the machine is not idle. Run() the rest.
+		uint64_t SkipIdle(uint64_t cycles);
+		Idle IdleState() const;
+		bool WaitingForInput() const;	//idle with both timers at 0: only a key change can wake it (or nothing, for Halt)
+
+		void SetCore(Core newCore) { core = newCore; }
+		Core GetCore() const { return core; }
+		static bool CoreFromName(char const* name, Core& found);	//"table", "switch", "cached", "jit" or "aot"
+
+#ifdef CHIP8_PROFILE
+		void SetProfiler(Profiler* attached) { profiler = attached; }	//null detaches, see Profiler.h
+#endif
+
+		bool SameState(Chip8 const& other) const;	//true if both machines would behave identically from here on.
+		void Reset(Chip8 const& pristine);			//becomes a copy of `pristine`, as operator= would, with one bulk copy (see Chip8Pool.h)
+
+		//Whole-machine snapshots (see Snapshot.h). Cheap enough to take every frame.
+		void SaveState(Snapshot& snapshot) const;
+		bool LoadState(Snapshot const& snapshot);		//false (machine untouched) if the snapshot is from another version
+		bool SaveState(char const* filename) const;
+		bool LoadState(char const* filename);
+
+		//Read-only view of the machine, for reporting results.
+		uint8_t Register(unsigned int i) const { return registers[i]; }
+		uint16_t ProgramCounter() const { return counter; }
+		uint16_t Index() const { return index; }
+		uint64_t DisplayHash() const;
 
 		//These variables are public so for main and SDL2 access
-		uint8_t input[KEY_COUNT]{};			//16 inputs, all representing a hex value.
-		uint32_t display[VIDEO_HEIGHT * VIDEO_WIDTH]{};	//62 x 32 pixel display, uint32 is used for SDL later on.
+		using Chip8State::input;
+		using Chip8State::display;
+
+		void RenderDisplay(uint32_t* pixels, uint32_t rows = ALL_ROWS) const;	//Expands display into VIDEO_WIDTH * VIDEO_HEIGHT RGBA pixels for SDL.
+		static void RenderDisplay(uint64_t const* display, uint32_t* pixels, uint32_t rows = ALL_ROWS);	//Same, from a copy of a display.
+
+		//Draw (Dxyn) and clear (00E0) record which rows they changed, so front-ends can skip unchanged frames.
+		uint32_t DisplayGeneration() const { return displayGeneration; }	//bumped every time a pixel changes
+		uint32_t TakeDirtyRows();	//bit y set if row y changed since the last call, then resets.
+
+		uint8_t TakeFaults();		//Fault bits raised since the last call, then resets.
 
 	private:
+		//Hardened is false only for RunUnchecked(). Every other caller uses the masked core.
+		template <bool Hardened = true>
+		void RunTable(uint64_t cycles);
+		template <bool ToTranslated = false>
+		uint64_t RunSwitch(uint64_t cycles);
+		void RunCached(uint64_t cycles);
+		void RunJit(uint64_t cycles);
+		void RunAot(uint64_t cycles);
+#ifdef CHIP8_PROFILE
+		void RunProfiled(uint64_t cycles);
+#endif
+
+		//Pre-decoded instruction cache used by Core::Cached.
+		//Every handler is resolved down to the final opcode, so no sub-table lookup is left at runtime.
+		enum Handler : uint8_t
+		{
+			H_DECODE,	//entry not decoded yet (or invalidated by a write)
+			H_NULL, H_00E0, H_00EE, H_1nnn, H_2nnn, H_3xkk, H_4xkk, H_5xy0, H_6xkk, H_7xkk,
+			H_8xy0, H_8xy1, H_8xy2, H_8xy3, H_8xy4, H_8xy5, H_8xy6, H_8xy7, H_8xyE,
+			H_9xy0, H_Annn, H_Bnnn, H_Cxkk, H_Dxyn, H_Ex9E, H_ExA1,
+			H_Fx07, H_Fx0A, H_Fx15, H_Fx18, H_Fx1E, H_Fx29, H_Fx33, H_Fx55, H_Fx65,
+			H_COUNT
+		};
+
+		struct Decoded		//one entry per address, even or odd, since jumps can land on either.
+		{
+			Handler handler;
+			uint8_t x;
+			uint8_t y;
+			uint8_t n;
+			uint8_t kk;
+			uint16_t nnn;
+		};
+
+		struct IdleLoop
+		{
+			Idle kind;
+			uint16_t head;			//address of the loop's first instruction
+			unsigned int length;	//instructions per iteration
+		};
+
+		IdleLoop FindIdleLoop() const;
+		uint16_t OpcodeAt(uint16_t address) const;
+
+		Decoded Decode(uint16_t address) const;
+		void ClearDecoded();
+		bool Invalidate(uint16_t address, unsigned int length);	//call after writing guest memory
+		bool Translated(uint16_t pc) { return pc + 1u < MEMORY_SIZE && jit.Ready(pc); }	//the Jit has a block at pc, or wants one now
+		void InvalidateAot(uint16_t address, unsigned int length);
+
+		//`value & mask`, or `value` untouched in the unchecked table core.
+		template <bool Hardened>
+		static unsigned int Wrap(unsigned int value, unsigned int mask) { return Hardened ? value & mask : value; }
+
+		//CALL/RET stack. Recording a fault is an OR of a flag, never a branch.
+		//sPtr is read as a signed depth: a RET on an empty stack leaves it negative, and the CALLs
+		//that bring it back up are not overflows.
+		template <bool Hardened = true>
+		void Push(uint16_t address)
+		{
+			if (Hardened) {
+				faults |= ((int8_t)sPtr >= (int)STACK_SIZE) * FAULT_STACK_OVERFLOW;
+			}
+			stack[Wrap<Hardened>(sPtr, STACK_MASK)] = address;
+			++sPtr;
+		}
+
+		template <bool Hardened = true>
+		uint16_t Pop()
+		{
+			if (Hardened) {
+				faults |= ((int8_t)sPtr <= 0) * FAULT_STACK_UNDERFLOW;
+			}
+			--sPtr;
+			return stack[Wrap<Hardened>(sPtr, STACK_MASK)];
+		}
+
+		//Instruction bodies that are too large to repeat in every core.
+		template <bool Hardened = true>
+		void DrawSprite(uint8_t Vx, uint8_t Vy, uint8_t nBytes);
+		void ClearDisplay();
+		bool WaitKey(uint8_t Vx);
+
+		//Handlers that address memory or the stack take Hardened, and so do the
+		//sub-tables that lead to them. The rest are shared by both table cores.
+		template <bool Hardened>
 		void Table0();	//Used to parse through sub-tables in the function pointer.
 		void Table8();
 		void TableE();
+		template <bool Hardened>
 		void TableF();
 
 		//Chip8 Instructions
 		void OP_NULL();
 		void OP_00E0();
+		template <bool Hardened>
 		void OP_00EE();
 		void OP_1nnn();
+		template <bool Hardened>
 		void OP_2nnn();
 		void OP_3xkk();
 		void OP_4xkk();
@@ -55,6 +273,7 @@ class Chip8
 		void OP_Annn();
 		void OP_Bnnn();
 		void OP_Cxkk();
+		template <bool Hardened>
 		void OP_Dxyn();
 		void OP_Ex9E();
 		void OP_ExA1();
@@ -64,8 +283,11 @@ class Chip8
 		void OP_Fx18();
 		void OP_Fx1E();
 		void OP_Fx29();
+		template <bool Hardened>
 		void OP_Fx33();
+		template <bool Hardened>
 		void OP_Fx55();
+		template <bool Hardened>
 		void OP_Fx65();
 
 		//Function Pointer Table
@@ -76,26 +298,35 @@ class Chip8
 		//							3. $00E + Unique (2)	4. First digit repeats, unique last 2 digits (11)
 
 		//Any invalid opcodes will default to OP_NULL
-		//Declare typedef tables below, then store each function pointer above in constructor
+		//The tables are built at compile time (see Chip8.cpp) and shared by every instance.
 		typedef void (Chip8::*Chip8Instruction) ();
-		Chip8Instruction table[0xF + 1]{ &Chip8::OP_NULL };		//master table, first digit of instructions [$0, $F]
-		Chip8Instruction table0[0xE + 1]{ &Chip8::OP_NULL };	//To accomodate the groupings, sub tables are created.
-		Chip8Instruction table8[0xE + 1]{ &Chip8::OP_NULL };	//Sizes here are based on other digits.
-		Chip8Instruction tableE[0xE + 1]{ &Chip8::OP_NULL };
-		Chip8Instruction tableF[0x65 + 1]{ &Chip8::OP_NULL };
-
-		uint8_t registers[REGISTER_COUNT]{};		//16 registers, each can hold 8 bits.
-		uint8_t memory[MEMORY_SIZE]{};				//4096 bytes of memory, 8 bits in a byte.
-		uint16_t index{};							//register that stores memory addresses. 16 bits.
-		uint16_t counter{};							//register that holds the next instruction to execute in a program.
-		uint16_t stack[STACK_SIZE]{};				//stack holds 16 program counters.
-		uint8_t sPtr{};								//pointer for stack management.
-		uint8_t delay{};							//Timer that decrements when > 0. Default 60hz.
-		uint8_t sound{};							//Similar to delay, but for sounds
-		uint16_t opcode{};							//CPU instruction. uint16 is used because instructions can be specified to be hex.
-
-		std::default_random_engine randNumGen;				//random generator
-		std::uniform_int_distribution<unsigned int> randByte;	//random number storage
+		struct TableEntry
+		{
+			unsigned int digits;
+			Chip8Instruction instruction;
+		};
+		template <size_t N>
+		static constexpr std::array<Chip8Instruction, N> MakeTable(std::initializer_list<TableEntry> entries);
+
+		template <bool Hardened>
+		static std::array<Chip8Instruction, 0xF + 1> const table;		//master table, first digit of instructions [$0, $F]
+		template <bool Hardened>
+		static std::array<Chip8Instruction, 0xF + 1> const table0;		//To accomodate the groupings, sub tables are created.
+		static std::array<Chip8Instruction, 0xF + 1> const table8;		//Sized for every value of the digits that index them,
+		static std::array<Chip8Instruction, 0xF + 1> const tableE;		//so any opcode, valid or not, lands on an entry.
+		template <bool Hardened>
+		static std::array<Chip8Instruction, 0xFF + 1> const tableF;
+
+		Core core{ CHIP8_DEFAULT_CORE };
+		std::vector<Decoded> decoded;				//MEMORY_SIZE entries, only allocated once Core::Cached runs.
+		std::vector<uint16_t> decodedUsed;			//addresses decoded since the last ClearDecoded(), up to MEMORY_SIZE of them
+		::Jit jit;									//translation cache for Core::Jit, empty until it runs.
+		AotProgram const* aot{};					//translated code for the loaded ROM, if this build has any
+		std::vector<uint8_t> aotStale;				//MEMORY_SIZE entries once aot is set, see AotContext::stale
+		std::vector<uint8_t> aotCode;				//MEMORY_SIZE entries once aot is set, nonzero where a block translated the byte
+#ifdef CHIP8_PROFILE
+		Profiler* profiler{};
+#endif
 };
 
 
@@ -0,0 +1,29 @@
+#include "Chip8Pool.h"
+#include <utility>
+
+Chip8Pool::Chip8Pool(size_t reserve)
+{
+	free.reserve(reserve);
+	for (size_t i = 0; i < reserve; i++) {
+		free.emplace_back(new Chip8(pristine));
+	}
+}
+
+std::unique_ptr<Chip8> Chip8Pool::Acquire()
+{
+	if (free.empty()) {
+		return std::unique_ptr<Chip8>(new Chip8(pristine));
+	}
+	std::unique_ptr<Chip8> machine = std::move(free.back());
+	free.pop_back();
+	return machine;
+}
+
+void Chip8Pool::Release(std::unique_ptr<Chip8> machine)
+{
+	if (!machine) {
+		return;
+	}
+	machine->Reset(pristine);
+	free.push_back(std::move(machine));
+}
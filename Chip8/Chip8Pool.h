@@ -0,0 +1,33 @@
+//Recycled Chip8 machines, for workloads that run many short sessions (batch jobs, fuzzing).
+//Every machine handed out is in the state of one pristine machine built when the pool was made.
+//Release() resets a machine from it with Chip8::Reset: one copy of its Chip8State, and the
+//decode cache's storage and the Jit's code buffer are kept. A new machine would read the clock and allocate.
+//
+//A pool is not thread-safe, give each thread its own.
+
+#ifndef CHIP_8_POOL_H
+#define CHIP_8_POOL_H
+
+#include "Chip8.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class Chip8Pool
+{
+	public:
+		explicit Chip8Pool(size_t reserve = 0);		//machines to build up front
+
+		//A machine in the pristine state, built only if none are free. Machines share the pristine's
+		//clock seed, so call Seed() where runs must differ.
+		std::unique_ptr<Chip8> Acquire();
+		void Release(std::unique_ptr<Chip8> machine);	//resets it and keeps it for the next Acquire()
+
+		size_t Free() const { return free.size(); }
+
+	private:
+		Chip8 const pristine;
+		std::vector<std::unique_ptr<Chip8>> free;
+};
+
+#endif
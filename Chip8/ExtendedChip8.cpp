@@ -0,0 +1,521 @@
+#include "ExtendedChip8.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+uint8_t bigFontset[BIG_FONTSET_SIZE]{
+	0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, //0
+	0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, //1
+	0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, //2
+	0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, //3
+	0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, //4
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, //5
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, //6
+	0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, //7
+	0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, //8
+	0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, //9
+	0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, //A
+	0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, //B
+	0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, //C
+	0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, //D
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, //E
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0, //F
+};
+
+template <typename Quirks>
+ExtendedChip8<Quirks>::ExtendedChip8()
+{
+	counter = START_ADDRESS;
+	random.Seed((uint32_t)std::chrono::system_clock::now().time_since_epoch().count());
+
+	std::memcpy(&memory[FONTSET_START], fontset, FONTSET_SIZE);
+	std::memcpy(&memory[BIG_FONTSET_START], bigFontset, BIG_FONTSET_SIZE);
+}
+
+template <typename Quirks>
+RomError ExtendedChip8<Quirks>::LoadROM(char const* filename)
+{
+	RomFile rom;
+	RomError error = rom.Open(filename, Quirks::MEMORY - START_ADDRESS);
+	if (error == RomError::None) {
+		LoadROM(rom.Data(), rom.Size());
+	}
+	return error;
+}
+
+template <typename Quirks>
+bool ExtendedChip8<Quirks>::LoadROM(uint8_t const* data, size_t size)
+{
+	if (size > Quirks::MEMORY - START_ADDRESS) {
+		return false;
+	}
+	std::memcpy(&memory[START_ADDRESS], data, size);
+	return true;
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::Seed(uint32_t seed)
+{
+	random.Seed(seed);
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::TickTimers()
+{
+	if (delay > 0) {
+		--delay;
+	}
+	if (sound > 0) {
+		--sound;
+	}
+}
+
+template <typename Quirks>
+uint32_t ExtendedChip8<Quirks>::TakeDirtyRows()
+{
+	uint32_t rows = changed ? ALL_ROWS : 0;
+	changed = false;
+	return rows;
+}
+
+template <typename Quirks>
+uint8_t ExtendedChip8<Quirks>::TakeFaults()
+{
+	uint8_t raised = faults;
+	faults = 0;
+	return raised;
+}
+
+//FNV-1a over every plane, like Chip8::DisplayHash.
+template <typename Quirks>
+uint64_t ExtendedChip8<Quirks>::DisplayHash() const
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (auto const& plane : display) {
+		for (auto const& row : plane) {
+			for (uint64_t word : row) {
+				for (unsigned int i = 0; i < sizeof(word); i++) {
+					hash ^= (word >> (i * 8u)) & 0xFFu;
+					hash *= 0x100000001B3ull;
+				}
+			}
+		}
+	}
+	return hash;
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::RenderDisplay(uint64_t const (*planes)[HIRES_HEIGHT][HIRES_WORDS], uint32_t* pixels)
+{
+	static const uint32_t palette[4] = { 0x00000000u, 0xFFFFFFFFu, 0xFFAAAAAAu, 0xFF555555u };
+
+	for (unsigned int y = 0; y < HIRES_HEIGHT; y++) {
+		for (unsigned int x = 0; x < HIRES_WIDTH; x++) {
+			unsigned int shift = 63u - (x % 64u);
+			unsigned int color = 0;
+			for (unsigned int plane = 0; plane < PLANES; plane++) {
+				color |= (unsigned int)((planes[plane][y][x / 64u] >> shift) & 1u) << plane;
+			}
+			pixels[y * HIRES_WIDTH + x] = palette[color];
+		}
+	}
+}
+
+template <typename Quirks>
+uint16_t ExtendedChip8<Quirks>::Fetch(uint32_t address) const
+{
+	return (uint16_t)((memory[address & ADDRESS_MASK] << 8u) | memory[(address + 1u) & ADDRESS_MASK]);
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::Skip()
+{
+	if constexpr (Quirks::XO_OPCODES) {
+		if (Fetch(counter) == 0xF000u) {
+			counter += 2;
+		}
+	}
+	counter += 2;
+}
+
+//sPtr is a signed depth, as in Chip8::Push/Pop.
+template <typename Quirks>
+void ExtendedChip8<Quirks>::Push(uint16_t address)
+{
+	faults |= ((int8_t)sPtr >= (int)STACK_SIZE) * Chip8::FAULT_STACK_OVERFLOW;
+	stack[sPtr & STACK_MASK] = address;
+	++sPtr;
+}
+
+template <typename Quirks>
+uint16_t ExtendedChip8<Quirks>::Pop()
+{
+	faults |= ((int8_t)sPtr <= 0) * Chip8::FAULT_STACK_UNDERFLOW;
+	--sPtr;
+	return stack[sPtr & STACK_MASK];
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::Clear()
+{
+	for (unsigned int plane = 0; plane < PLANES; plane++) {
+		if (planeMask & (1u << plane)) {
+			std::memset(display[plane], 0, sizeof(display[plane]));
+		}
+	}
+	changed = true;
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::ScrollDown(unsigned int pixels)
+{
+	pixels = std::min(pixels, HIRES_HEIGHT);
+	for (unsigned int plane = 0; plane < PLANES; plane++) {
+		if (planeMask & (1u << plane)) {
+			std::memmove(display[plane][pixels], display[plane][0], (HIRES_HEIGHT - pixels) * sizeof(display[plane][0]));
+			std::memset(display[plane][0], 0, pixels * sizeof(display[plane][0]));
+		}
+	}
+	changed = true;
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::ScrollUp(unsigned int pixels)
+{
+	pixels = std::min(pixels, HIRES_HEIGHT);
+	for (unsigned int plane = 0; plane < PLANES; plane++) {
+		if (planeMask & (1u << plane)) {
+			std::memmove(display[plane][0], display[plane][pixels], (HIRES_HEIGHT - pixels) * sizeof(display[plane][0]));
+			std::memset(display[plane][HIRES_HEIGHT - pixels], 0, pixels * sizeof(display[plane][0]));
+		}
+	}
+	changed = true;
+}
+
+//A 128 pixel row is two words, so a horizontal scroll is a funnel shift across the pair.
+//Callers only scroll by 4 or 8, always less than a word.
+template <typename Quirks>
+void ExtendedChip8<Quirks>::ScrollRight(unsigned int pixels)
+{
+	for (unsigned int plane = 0; plane < PLANES; plane++) {
+		if (planeMask & (1u << plane)) {
+			for (uint64_t* row : display[plane]) {
+				row[1] = (row[1] >> pixels) | (row[0] << (64u - pixels));
+				row[0] >>= pixels;
+			}
+		}
+	}
+	changed = true;
+}
+
+template <typename Quirks>
+void ExtendedChip8<Quirks>::ScrollLeft(unsigned int pixels)
+{
+	for (unsigned int plane = 0; plane < PLANES; plane++) {
+		if (planeMask & (1u << plane)) {
+			for (uint64_t* row : display[plane]) {
+				row[0] = (row[0] << pixels) | (row[1] >> (64u - pixels));
+				row[1] <<= pixels;
+			}
+		}
+	}
+	changed = true;
+}
+
+//Every lores pixel becomes two framebuffer pixels.
+static uint32_t DoubleBits(uint32_t bits, unsigned int count)
+{
+	uint32_t doubled = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		doubled |= ((bits >> i) & 1u) * (3u << (2u * i));
+	}
+	return doubled;
+}
+
+//Like Chip8::DrawSprite, each sprite row is placed with word shifts and XORed in one go: it
+//lands in at most two words of the 128 pixel row, and what passes the right edge either wraps
+//into the first word or, with CLIP_SPRITES, is dropped. Dxy0 draws 16x16. With two planes
+//selected (XO-CHIP) the first plane's sprite data is followed by the second's.
+template <typename Quirks>
+void ExtendedChip8<Quirks>::Draw(uint8_t x, uint8_t y, uint8_t rows)
+{
+	unsigned int scale = hires ? 1u : 2u;
+	unsigned int width = HIRES_WIDTH / scale;
+	unsigned int height = HIRES_HEIGHT / scale;
+	unsigned int posX = registers[x] % width;
+	unsigned int posY = registers[y] % height;
+	unsigned int bytesPerRow = 1;
+	if (rows == 0) {
+		rows = 16;
+		bytesPerRow = 2;
+	}
+
+	unsigned int column = posX * scale;
+	unsigned int word = column / 64u;
+	unsigned int offset = column % 64u;
+	uint32_t address = index;
+	bool collision = false;
+
+	for (unsigned int plane = 0; plane < PLANES; plane++) {
+		if (!(planeMask & (1u << plane))) {
+			continue;
+		}
+
+		for (unsigned int row = 0; row < rows; row++, address += bytesPerRow) {
+			unsigned int line = posY + row;
+			if (line >= height) {
+				if constexpr (Quirks::CLIP_SPRITES) {
+					continue;
+				}
+				line %= height;
+			}
+
+			uint32_t bits = memory[address & ADDRESS_MASK];
+			if (bytesPerRow == 2) {
+				bits = (bits << 8u) | memory[(address + 1u) & ADDRESS_MASK];
+			}
+			unsigned int count = bytesPerRow * 8u;
+			if (scale == 2) {
+				bits = DoubleBits(bits, count);
+				count *= 2;
+			}
+
+			uint64_t pattern = (uint64_t)bits << (64u - count);
+			uint64_t words[HIRES_WORDS]{};
+			words[word] = pattern >> offset;
+			if (offset != 0) {
+				uint64_t spill = pattern << (64u - offset);
+				if (word + 1 < HIRES_WORDS) {
+					words[word + 1] = spill;
+				} else if (!Quirks::CLIP_SPRITES) {
+					words[0] = spill;
+				}
+			}
+
+			for (unsigned int copy = 0; copy < scale; copy++) {
+				uint64_t* target = display[plane][line * scale + copy];
+				for (unsigned int i = 0; i < HIRES_WORDS; i++) {
+					collision |= (target[i] & words[i]) != 0;
+					target[i] ^= words[i];
+				}
+			}
+		}
+	}
+
+	registers[0xF] = collision ? 1 : 0;
+	changed = true;
+}
+
+//One switch per instruction with the fields decoded into locals, like Chip8's Switch core. Every
+//quirk is a compile-time constant, so each variant compiles to only its own behaviour.
+template <typename Quirks>
+void ExtendedChip8<Quirks>::Run(uint64_t cycles)
+{
+	uint8_t* V = registers;
+
+	for (uint64_t i = 0; i < cycles && !halted; i++) {
+		uint16_t op = Fetch(counter);
+		counter += 2;
+		waitingForKey = false;
+
+		uint8_t x = (op >> 8u) & 0xFu;
+		uint8_t y = (op >> 4u) & 0xFu;
+		uint8_t n = op & 0xFu;
+		uint8_t kk = op & 0xFFu;
+		uint16_t nnn = op & 0x0FFFu;
+		unsigned int scale = hires ? 1u : 2u;	//scroll distances are in pixels of the current mode
+
+		switch (op >> 12u)
+		{
+			case 0x0:
+				if (op == 0x00E0) {
+					Clear();
+				} else if (op == 0x00EE) {
+					counter = Pop();
+				} else if ((op & 0xFFF0u) == 0x00C0) {
+					ScrollDown(n * scale);
+				} else if (Quirks::XO_OPCODES && (op & 0xFFF0u) == 0x00D0) {
+					ScrollUp(n * scale);
+				} else if (op == 0x00FB) {
+					ScrollRight(4 * scale);
+				} else if (op == 0x00FC) {
+					ScrollLeft(4 * scale);
+				} else if (op == 0x00FD) {
+					halted = true;
+				} else if (op == 0x00FE || op == 0x00FF) {
+					hires = (op == 0x00FF);
+					uint8_t selected = planeMask;
+					planeMask = (1u << PLANES) - 1u;	//a mode change clears every plane
+					Clear();
+					planeMask = selected;
+				}
+				break;		//0nnn (machine code) is ignored
+			case 0x1:
+				counter = nnn;
+				break;
+			case 0x2:
+				Push(counter);
+				counter = nnn;
+				break;
+			case 0x3:
+				if (V[x] == kk) {
+					Skip();
+				}
+				break;
+			case 0x4:
+				if (V[x] != kk) {
+					Skip();
+				}
+				break;
+			case 0x5:
+				if (n == 0) {
+					if (V[x] == V[y]) {
+						Skip();
+					}
+				} else if (Quirks::XO_OPCODES && (n == 2 || n == 3)) {
+					//Save/load vx - vy, in either direction, I unchanged
+					int step = (x <= y) ? 1 : -1;
+					for (int r = x, i = 0; ; r += step, i++) {
+						if (n == 2) {
+							memory[(index + i) & ADDRESS_MASK] = V[r];
+						} else {
+							V[r] = memory[(index + i) & ADDRESS_MASK];
+						}
+						if (r == y) {
+							break;
+						}
+					}
+				}
+				break;
+			case 0x6:
+				V[x] = kk;
+				break;
+			case 0x7:
+				V[x] += kk;
+				break;
+			case 0x8:
+			{
+				//Results first, VF last, so VF as the target ends up holding the flag
+				uint8_t source = Quirks::SHIFT_USES_VY ? V[y] : V[x];
+				uint8_t flag;
+				switch (n)
+				{
+					case 0x0: V[x] = V[y]; break;
+					case 0x1: V[x] |= V[y]; break;
+					case 0x2: V[x] &= V[y]; break;
+					case 0x3: V[x] ^= V[y]; break;
+					case 0x4: flag = (V[x] + V[y]) > 0xFF; V[x] += V[y]; V[0xF] = flag; break;
+					case 0x5: flag = V[x] >= V[y]; V[x] -= V[y]; V[0xF] = flag; break;
+					case 0x6: flag = source & 1u; V[x] = source >> 1u; V[0xF] = flag; break;
+					case 0x7: flag = V[y] >= V[x]; V[x] = V[y] - V[x]; V[0xF] = flag; break;
+					case 0xE: flag = source >> 7u; V[x] = (uint8_t)(source << 1u); V[0xF] = flag; break;
+				}
+			} break;
+			case 0x9:
+				if (V[x] != V[y]) {
+					Skip();
+				}
+				break;
+			case 0xA:
+				index = nnn;
+				break;
+			case 0xB:
+				counter = nnn + (Quirks::JUMP_USES_VX ? V[x] : V[0]);
+				break;
+			case 0xC:
+				V[x] = random.NextByte() & kk;
+				break;
+			case 0xD:
+				Draw(x, y, n);
+				break;
+			case 0xE:
+				if (kk == 0x9E && input[V[x] & 0xFu]) {
+					Skip();
+				} else if (kk == 0xA1 && !input[V[x] & 0xFu]) {
+					Skip();
+				}
+				break;
+			case 0xF:
+				if (Quirks::XO_OPCODES && op == 0xF000) {
+					index = Fetch(counter);		//I = next word, the only 4 byte instruction
+					counter += 2;
+					break;
+				}
+				if (Quirks::XO_OPCODES && kk == 0x01) {
+					planeMask = x & ((1u << PLANES) - 1u);
+					break;
+				}
+				if (Quirks::XO_OPCODES && op == 0xF002) {
+					for (unsigned int b = 0; b < sizeof(audioPattern); b++) {
+						audioPattern[b] = memory[(index + b) & ADDRESS_MASK];
+					}
+					break;
+				}
+
+				switch (kk)
+				{
+					case 0x07: V[x] = delay; break;
+					case 0x0A:
+					{
+						//First key down, like Chip8::WaitKey. Nothing down: run this again.
+						bool found = false;
+						for (uint8_t key = 0; key < KEY_COUNT && !found; key++) {
+							if (input[key]) {
+								V[x] = key;
+								found = true;
+							}
+						}
+						if (!found) {
+							counter -= 2;
+							waitingForKey = true;
+						}
+					} break;
+					case 0x15: delay = V[x]; break;
+					case 0x18: sound = V[x]; break;
+					case 0x1E: index += V[x]; break;
+					case 0x29: index = FONTSET_START + 5u * (V[x] & 0xFu); break;
+					case 0x30: index = BIG_FONTSET_START + 10u * (V[x] & 0xFu); break;
+					case 0x33:
+						memory[index & ADDRESS_MASK] = V[x] / 100u;
+						memory[(index + 1u) & ADDRESS_MASK] = (V[x] / 10u) % 10u;
+						memory[(index + 2u) & ADDRESS_MASK] = V[x] % 10u;
+						break;
+					case 0x3A:
+						if (Quirks::XO_OPCODES) {
+							pitch = V[x];
+						}
+						break;
+					case 0x55:
+						for (unsigned int r = 0; r <= x; r++) {
+							memory[(index + r) & ADDRESS_MASK] = V[r];
+						}
+						if (Quirks::LOAD_STORE_ADVANCES_I) {
+							index += x + 1u;
+						}
+						break;
+					case 0x65:
+						for (unsigned int r = 0; r <= x; r++) {
+							V[r] = memory[(index + r) & ADDRESS_MASK];
+						}
+						if (Quirks::LOAD_STORE_ADVANCES_I) {
+							index += x + 1u;
+						}
+						break;
+					case 0x75:
+						for (unsigned int r = 0; r <= x && r < Quirks::FLAGS; r++) {
+							flags[r] = V[r];
+						}
+						break;
+					case 0x85:
+						for (unsigned int r = 0; r <= x && r < Quirks::FLAGS; r++) {
+							V[r] = flags[r];
+						}
+						break;
+				}
+				break;
+		}
+	}
+}
+
+template class ExtendedChip8<SuperChipQuirks>;
+template class ExtendedChip8<XoChipQuirks>;
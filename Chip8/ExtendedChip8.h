@@ -0,0 +1,123 @@
+//SUPER-CHIP and XO-CHIP. One interpreter template, specialized at compile time by a quirks struct,
+//so each variant's shift/load-store/jump/clipping behaviour and memory size are constants the
+//compiler folds away. The classic Chip8 class is untouched and pays nothing for any of this.
+//
+//The framebuffer is always 128x64, two uint64 words per row (leftmost pixel in the top bit of the
+//first word), one such buffer per bitplane. Lores mode (64x32) draws every pixel as a 2x2 block,
+//so scrolling and presenting never need to know the mode. Scrolls are whole-word shifts.
+
+#ifndef CHIP_8_EXTENDED_H
+#define CHIP_8_EXTENDED_H
+
+#include "Chip8.h"
+#include "Random.h"
+#include "RomFile.h"
+#include <cstddef>
+#include <cstdint>
+
+const unsigned int HIRES_WIDTH = 128;
+const unsigned int HIRES_HEIGHT = 64;
+const unsigned int HIRES_WORDS = HIRES_WIDTH / 64;		//uint64 words per framebuffer row
+const unsigned int BIG_FONTSET_START = FONTSET_START + FONTSET_SIZE;
+const unsigned int BIG_FONTSET_SIZE = 160;				//16 digits of 8x10
+
+extern uint8_t bigFontset[BIG_FONTSET_SIZE];			//Fx30 characters, copied to BIG_FONTSET_START
+
+//SUPER-CHIP 1.1 as most of its ROMs expect it.
+struct SuperChipQuirks
+{
+	static constexpr unsigned int MEMORY = 0x1000;
+	static constexpr unsigned int PLANES = 1;
+	static constexpr unsigned int FLAGS = 8;				//Fx75/Fx85 user flags
+	static constexpr bool SHIFT_USES_VY = false;			//8xy6/8xyE shift Vx in place
+	static constexpr bool LOAD_STORE_ADVANCES_I = false;	//Fx55/Fx65 leave I alone
+	static constexpr bool JUMP_USES_VX = true;				//Bxnn jumps to xnn + Vx
+	static constexpr bool CLIP_SPRITES = true;				//sprites stop at the edges instead of wrapping
+	static constexpr bool XO_OPCODES = false;
+};
+
+//XO-CHIP as Octo defines it: 64 KB, two bitplanes, the original COSMAC shift/load-store rules.
+struct XoChipQuirks
+{
+	static constexpr unsigned int MEMORY = 0x10000;
+	static constexpr unsigned int PLANES = 2;
+	static constexpr unsigned int FLAGS = 16;
+	static constexpr bool SHIFT_USES_VY = true;
+	static constexpr bool LOAD_STORE_ADVANCES_I = true;
+	static constexpr bool JUMP_USES_VX = false;
+	static constexpr bool CLIP_SPRITES = false;
+	static constexpr bool XO_OPCODES = true;				//5xy2/5xy3, F000 nnnn, Fn01, F002, Fx3A, 00Dn
+};
+
+template <typename Quirks>
+class ExtendedChip8
+{
+	public:
+		static const unsigned int PLANES = Quirks::PLANES;
+
+		ExtendedChip8();
+		RomError LoadROM(char const* filename);
+		bool LoadROM(uint8_t const* data, size_t size);		//false (nothing loaded) if it does not fit above START_ADDRESS
+		void Seed(uint32_t seed);
+		void Run(uint64_t cycles);
+		void TickTimers();
+		bool SoundOn() const { return sound > 0; }
+
+		//What the Scheduler and front-ends ask of every machine. No idle loop detection here yet.
+		uint64_t SkipIdle(uint64_t) { return 0; }
+		bool WaitingForInput() const { return halted || (waitingForKey && delay == 0 && sound == 0); }
+		bool Halted() const { return halted; }			//00FD
+
+		bool Hires() const { return hires; }
+		uint8_t Register(unsigned int i) const { return registers[i]; }
+		uint16_t ProgramCounter() const { return counter; }
+		uint16_t Index() const { return index; }
+		uint64_t DisplayHash() const;
+		uint32_t TakeDirtyRows();	//ALL_ROWS if anything was drawn, cleared or scrolled since the last call, else 0
+		uint8_t TakeFaults();		//Chip8::Fault bits raised since the last call, then resets.
+
+		//Every plane's bits pick a colour: 0 off, 1 and 2 the single planes, 3 both.
+		//Writes HIRES_WIDTH * HIRES_HEIGHT RGBA pixels.
+		static void RenderDisplay(uint64_t const (*planes)[HIRES_HEIGHT][HIRES_WORDS], uint32_t* pixels);
+
+		uint8_t input[KEY_COUNT]{};
+		uint64_t display[PLANES][HIRES_HEIGHT][HIRES_WORDS]{};
+
+	private:
+		static const uint32_t ADDRESS_MASK = Quirks::MEMORY - 1u;
+
+		uint16_t Fetch(uint32_t address) const;
+		void Skip();		//over one instruction, which for XO-CHIP may be the 4 byte F000 nnnn
+		void Draw(uint8_t x, uint8_t y, uint8_t rows);
+		void Clear();
+		void Push(uint16_t address);	//like Chip8's, the stack slot wraps and a fault bit is ORed in
+		uint16_t Pop();
+		void ScrollDown(unsigned int pixels);		//framebuffer pixels, callers scale lores amounts
+		void ScrollUp(unsigned int pixels);
+		void ScrollRight(unsigned int pixels);
+		void ScrollLeft(unsigned int pixels);
+
+		uint8_t registers[REGISTER_COUNT]{};
+		uint8_t memory[Quirks::MEMORY]{};
+		uint8_t flags[Quirks::FLAGS]{};				//Fx75/Fx85, kept across ROM loads like the HP48's RPL registers
+		uint8_t audioPattern[16]{};					//F002, stored but the beeper only plays a square wave
+		uint16_t index{};
+		uint16_t counter{};
+		uint16_t stack[STACK_SIZE]{};
+		uint8_t sPtr{};
+		uint8_t faults{};
+		uint8_t delay{};
+		uint8_t sound{};
+		uint8_t pitch{ 64 };						//Fx3A, stored only
+		uint8_t planeMask{ 1 };						//Fn01, which planes draw/clear/scroll touch
+		bool hires{};
+		bool halted{};
+		bool waitingForKey{};
+		bool changed{ true };
+		Random random;
+};
+
+typedef ExtendedChip8<SuperChipQuirks> SuperChip8;
+typedef ExtendedChip8<XoChipQuirks> XoChip8;
+
+#endif
@@ -0,0 +1,166 @@
+//Fuzz target. Each input is [core][keys low][keys high][ROM...]: the ROM runs for FUZZ_CYCLES
+//instructions on the core picked by the first byte, with the timers ticking and the keys held,
+//and must end in the same state, with the same faults, as on the switch core. The switch core
+//is the reference here only because it is the fastest; Validate.cpp checks it against the table core.
+//
+//Nothing is constructed per input. Both machines are Reset() from one pristine machine made
+//at startup, which is a bulk copy of the arrays and leaves the Jit's code buffer mapped.
+//
+//Built with Clang this is a libFuzzer binary (CHIP8_LIBFUZZER). Elsewhere a small driver below runs
+//the files it is given, or random inputs, under the same sanitizers.
+
+#include "Chip8.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+const uint64_t FUZZ_CYCLES = 256;		//short random programs soon run off into zeroed memory anyway
+const unsigned int FUZZ_TICK = 32;		//instructions between timer ticks, so Fx07 loops end
+const size_t FUZZ_HEADER = 3;
+
+//No Core::Aot: it only runs ROMs translated at build time, so on fuzz inputs it is the switch core.
+Chip8::Core const fuzzCores[] = { Chip8::Core::Table, Chip8::Core::Cached, Chip8::Core::Jit };
+
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size)
+{
+	static Chip8 const pristine = [] {
+		Chip8 machine;
+		machine.Seed(1);
+		return machine;
+	}();
+	static Chip8 reference;
+	static Chip8 machine;
+
+	if (size < FUZZ_HEADER || size - FUZZ_HEADER > MEMORY_SIZE - START_ADDRESS) {
+		return -1;		//not added to the corpus
+	}
+
+	reference.Reset(pristine);
+	reference.SetCore(Chip8::Core::Switch);
+	reference.LoadROM(data + FUZZ_HEADER, size - FUZZ_HEADER);
+	machine.Reset(pristine);
+	machine.SetCore(fuzzCores[data[0] % (sizeof(fuzzCores) / sizeof(fuzzCores[0]))]);
+	machine.LoadROM(data + FUZZ_HEADER, size - FUZZ_HEADER);
+
+	unsigned int keys = data[1] | (data[2] << 8u);
+	for (unsigned int key = 0; key < KEY_COUNT; key++) {
+		reference.input[key] = (keys >> key) & 1u;
+		machine.input[key] = (keys >> key) & 1u;
+	}
+
+	for (uint64_t executed = 0; executed < FUZZ_CYCLES; executed += FUZZ_TICK) {
+		reference.Run(FUZZ_TICK);
+		reference.TickTimers();
+		machine.Run(FUZZ_TICK);
+		machine.TickTimers();
+	}
+
+	if (!machine.SameState(reference) || machine.TakeFaults() != reference.TakeFaults()) {
+		std::abort();
+	}
+	return 0;
+}
+
+#ifndef CHIP8_LIBFUZZER
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+const uint64_t DEFAULT_FUZZ_RUNS = 100000;
+char const* const FUZZ_CRASH_FILE = "fuzz-crash.bin";
+
+static std::vector<uint8_t> current;	//the input being run, saved if it brings the process down
+
+//Only reached on abort or a crash, so a plain stdio write is good enough. Sanitizers need
+//ASAN_OPTIONS=abort_on_error=1 / UBSAN_OPTIONS=abort_on_error=1 to come through here.
+static void SaveCrash(int signal)
+{
+	if (std::FILE* file = std::fopen(FUZZ_CRASH_FILE, "wb")) {
+		std::fwrite(current.data(), 1, current.size(), file);
+		std::fclose(file);
+		std::fprintf(stderr, "input saved to %s\n", FUZZ_CRASH_FILE);
+	}
+	std::signal(signal, SIG_DFL);
+	std::raise(signal);
+}
+
+//Random inputs are mostly short opcode streams, with some plain data mixed in.
+//Filled in place, four bytes per draw: at a few microseconds per input, generating it is a real part of the cost.
+static void RandomInput(std::mt19937& rng, std::vector<uint8_t>& input)
+{
+	input.resize(FUZZ_HEADER + 2 * (1 + rng() % 64));
+	for (size_t i = 0; i < input.size(); i += 4) {
+		uint32_t bytes = rng();
+		for (size_t b = i; b < i + 4 && b < input.size(); b++) {
+			input[b] = bytes & 0xFFu;
+			bytes >>= 8u;
+		}
+	}
+	//Keep most jumps, calls and I inside the program, where the interesting code is
+	for (size_t i = FUZZ_HEADER; i + 1 < input.size(); i += 2) {
+		uint16_t op = (input[i] << 8u) | input[i + 1];
+		if (op >> 12u == 0x1 || op >> 12u == 0x2 || op >> 12u == 0xA || op >> 12u == 0xB) {
+			uint32_t draw = rng();
+			if (draw & 1u) {
+				uint16_t target = START_ADDRESS + (draw >> 1u) % (input.size() - FUZZ_HEADER);
+				input[i] = (input[i] & 0xF0u) | (target >> 8u);
+				input[i + 1] = target & 0xFFu;
+			}
+		}
+	}
+}
+
+//ARG consists of:
+//	Input files to run once each, or
+//	-n <count> random inputs (default DEFAULT_FUZZ_RUNS) and an optional --seed <n>
+int main(int argc, char** argv)
+{
+	std::vector<std::string> files;
+	uint64_t runs = DEFAULT_FUZZ_RUNS;
+	uint32_t seed = 1;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-n" || arg == "--seed") {
+			if (i + 1 >= argc) {		//not a file called "-n"
+				std::cerr << "Usage: " << argv[0] << " [input files...] | [-n <count>] [--seed <n>]\n";
+				return 1;
+			}
+			if (arg == "-n") {
+				runs = std::stoull(argv[++i]);
+			} else {
+				seed = std::stoul(argv[++i]);
+			}
+		} else {
+			files.push_back(arg);
+		}
+	}
+
+	if (!files.empty()) {
+		for (std::string const& name : files) {
+			std::ifstream file(name, std::ios::binary);
+			std::vector<uint8_t> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			LLVMFuzzerTestOneInput(input.data(), input.size());
+			std::cout << "ok   " << name << "\n";
+		}
+		return 0;
+	}
+
+	std::signal(SIGABRT, SaveCrash);
+	std::signal(SIGSEGV, SaveCrash);
+	std::mt19937 rng(seed);
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < runs; i++) {
+		RandomInput(rng, current);
+		LLVMFuzzerTestOneInput(current.data(), current.size());
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << runs << " inputs in " << seconds << " s, " << (seconds > 0 ? runs / seconds : 0) << " exec/s\n";
+	return 0;
+}
+#endif
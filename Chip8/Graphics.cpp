@@ -1,8 +1,10 @@
 #include "Graphics.h"
+#include "Renderer.h"
 #include <SDL.h>
 
 //Initialize our SDL instances (window, renderer, texture)
 Graphics::Graphics(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight)
+	: textureWidth(textureWidth), textureHeight(textureHeight)
 {
 	SDL_Init(SDL_INIT_VIDEO);	//This function must ALWAYS be called to use SDL.
 								//Parameters are subsystems like video, audio, etc.
@@ -17,6 +19,18 @@ Graphics::Graphics(char const* title, int windowWidth, int windowHeight, int tex
 
 }
 
+//The texture is exactly window sized and in the window's native format, so presenting is a plain copy
+//and never depends on a GPU being there.
+Graphics::Graphics(char const* title, Renderer& software)
+	: textureWidth(software.Width()), textureHeight(software.Height()), software(&software)
+{
+	SDL_Init(SDL_INIT_VIDEO);
+
+	window = SDL_CreateWindow(title, 200, 200, textureWidth, textureHeight, SDL_WINDOW_SHOWN);
+	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, textureWidth, textureHeight);
+}
+
 Graphics::~Graphics() //Destroy all the SDL elements then exit.
 {
 	SDL_DestroyWindow(window);
@@ -33,6 +47,80 @@ void Graphics::Update(void const* buffer, int pitch)
 	SDL_RenderPresent(renderer);							//make new texture visible
 }
 
+//First and last set bit of a non-zero row mask.
+static void RowSpan(uint32_t rows, int& first, int& last)
+{
+	first = 0;
+	while (!(rows & (1u << first))) {
+		first++;
+	}
+	last = 31;
+	while (!(rows & (1u << last))) {
+		last--;
+	}
+}
+
+//Most frames draw nothing, so a clean frame costs no upload and no present at all.
+//Otherwise only the band of rows between the first and last dirty row is uploaded.
+void Graphics::Update(void const* buffer, int pitch, uint32_t dirtyRows)
+{
+	if (dirtyRows == 0) {
+		return;
+	}
+
+	int first, last;
+	RowSpan(dirtyRows, first, last);
+	if (last >= textureHeight) {
+		last = textureHeight - 1;
+	}
+
+	SDL_Rect rows{ 0, first, textureWidth, last - first + 1 };
+	SDL_UpdateTexture(texture, &rows, static_cast<uint8_t const*>(buffer) + first * pitch, pitch);
+	SDL_RenderClear(renderer);
+	SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+	SDL_RenderPresent(renderer);
+}
+
+
+//Only the band of rows that changed is locked and redrawn. Locked memory is write-only,
+//so the renderer redraws every pixel in the band.
+void Graphics::Present(uint64_t const* display, uint32_t dirtyRows)
+{
+	uint32_t rows = software->Advance(display, dirtyRows);
+	if (rows == 0) {
+		return;
+	}
+
+	int first, last;
+	RowSpan(rows, first, last);
+	int scale = textureHeight / VIDEO_HEIGHT;
+	SDL_Rect band{ 0, first * scale, textureWidth, (last - first + 1) * scale };
+
+	void* pixels;
+	int pitch;
+	if (SDL_LockTexture(texture, &band, &pixels, &pitch) != 0) {
+		return;
+	}
+	software->Render(display, first, last, pixels, pitch);
+	SDL_UnlockTexture(texture);
+
+	SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+	SDL_RenderPresent(renderer);
+}
+
+//Leaves the event queued, ProcessInput() picks it up.
+void Graphics::WaitForEvent(int timeoutMs)
+{
+	SDL_WaitEventTimeout(nullptr, timeoutMs);
+}
+
+//SDL_PushEvent is the one call SDL allows from any thread. ProcessInput() ignores the event.
+void Graphics::Wake()
+{
+	SDL_Event event{};
+	event.type = SDL_USEREVENT;
+	SDL_PushEvent(&event);
+}
 
 //	Original Keypad Input
 //	+ - + - + - + - +
@@ -148,6 +236,18 @@ bool Graphics::ProcessInput(uint8_t* keys)
 					{
 						keys[0xF] = 1;
 					} break;
+
+					case SDLK_BACKSPACE:	//held to rewind, see Rewind.h
+					{
+						rewindHeld = true;
+					} break;
+
+					case SDLK_TAB:			//toggles fast-forward
+					{
+						if (!event.key.repeat) {
+							turboOn = !turboOn;
+						}
+					} break;
 				}
 			} break;
 
@@ -234,6 +334,11 @@ bool Graphics::ProcessInput(uint8_t* keys)
 					{
 						keys[0xF] = 0;
 					} break;
+
+					case SDLK_BACKSPACE:
+					{
+						rewindHeld = false;
+					} break;
 				}
 			} break;
 		} //end of switch case
@@ -3,6 +3,7 @@
 
 #include <cstdint>
 
+class Renderer;
 class SDL_Window;		//Window for our emulator		
 class SDL_Renderer;		//GPU can now be used to render 
 class SDL_Texture;		//Can now map sprites onto the screen
@@ -10,12 +11,25 @@ class SDL_Texture;		//Can now map sprites onto the screen
 class Graphics {
 	public:
 		Graphics(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight);
+		Graphics(char const* title, Renderer& software);	//CPU scaling (Renderer.h), SDL's software renderer only copies
 		~Graphics();
 		void Update(void const* buffer, int pitch);
+		void Update(void const* buffer, int pitch, uint32_t dirtyRows);	//uploads only rows set in dirtyRows, nothing if 0
+		void Present(uint64_t const* display, uint32_t dirtyRows);		//software renderer: draws into the locked texture
 		bool ProcessInput(uint8_t* keys);
+		void WaitForEvent(int timeoutMs);		//blocks until any event (key, window, quit, Wake) or the timeout
+		static void Wake();						//any thread: ends a WaitForEvent(), e.g. because a frame is ready
+		bool RewindHeld() const { return rewindHeld; }	//Backspace, checked once per frame
+		bool TurboOn() const { return turboOn; }		//Tab toggles it
+		void SetTurbo(bool on) { turboOn = on; }
 
 	private:
 		SDL_Window* window{};
 		SDL_Renderer* renderer{};
 		SDL_Texture* texture{};
+		int textureWidth{};
+		int textureHeight{};
+		Renderer* software{};	//null: texture is 64x32 and the GPU scales it
+		bool rewindHeld{};
+		bool turboOn{};
 };
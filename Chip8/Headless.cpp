@@ -0,0 +1,321 @@
+//Headless runner. Same Chip8 core as Main.cpp, but no Graphics/SDL at all.
+//Used to run ROMs on machines without a display and to time the interpreter on its own.
+
+#include "Audio.h"
+#include "Capture.h"
+#include "Chip8.h"
+#include "ExtendedChip8.h"
+#include "InputLog.h"
+#include "Profiler.h"
+#include "RomLibrary.h"
+#include "Scheduler.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+const uint64_t DEFAULT_INSTRUCTIONS = 10000000;
+
+static void Usage(char const* name)
+{
+	std::cerr << "Usage: " << name << " <ROM> [options]\n"
+		<< "  -i <count>     execute <count> instructions (default " << DEFAULT_INSTRUCTIONS << ")\n"
+		<< "  -f <count>     execute <count> 60hz frames (instructions plus a timer tick) instead\n"
+		<< "  --ipf <count>  instructions per frame (default " << DEFAULT_INSTRUCTIONS_PER_FRAME << ")\n"
+		<< "  --core <name>  interpreter core: table, switch, cached, jit, aot (default is the build's CHIP8_CORE)\n"
+		<< "  --variant <name>     chip8, schip or xochip (default: detected from the ROM)\n"
+		<< "  --seed <n>     RNG seed (default: clock)\n"
+		<< "  --replay <log> replay a recorded input log; seed, frame size and length come from the log\n"
+		<< "  --load-state <file>  continue from a save state instead of reset\n"
+		<< "  --save-state <file>  write a save state once the run is over\n"
+		<< "  --capture <file>     record the frames of a -f or --replay run as .gif, .png (one per frame) or .y4m\n"
+		<< "  --capture-scale <n>  pixels per Chip8 pixel in the capture (default 4)\n"
+		<< "  --audio <file>       write the beeper of a -f or --replay run as a .wav, or \"null\" to only synthesize it\n"
+		<< "  --no-idle-skip       execute idle loops (key waits, timer polls) instead of skipping them\n"
+		<< "  --profile <prefix>   write <prefix>.json, <prefix>.csv and <prefix>.ppm (builds with CHIP8_PROFILE only)\n"
+		<< "  --core, --load-state, --save-state, --capture and --profile need a chip8 ROM\n";
+	std::exit(EXIT_FAILURE);
+}
+
+struct Options
+{
+	char const* romName{};
+	uint64_t instructions{ DEFAULT_INSTRUCTIONS };
+	uint64_t frames{};
+	unsigned int perFrame{ DEFAULT_INSTRUCTIONS_PER_FRAME };
+	bool seeded{};
+	uint32_t seed{};
+	char const* loadState{};
+	char const* replay{};
+	char const* saveState{};
+	char const* profileName{};
+	char const* captureName{};
+	unsigned int captureScale{ 4 };
+	char const* audioName{};
+	bool idleSkip{ true };
+	RomProfile profile{};
+};
+
+//Everything but the classic-only options works the same for every machine.
+template <typename Machine>
+static int Run(Machine& chip8, Options options)
+{
+	constexpr bool classic = std::is_same<Machine, Chip8>::value;
+	char const* romName = options.romName;
+	uint64_t instructions = options.instructions;
+	uint64_t frames = options.frames;
+	unsigned int perFrame = options.perFrame;
+	char const* replay = options.replay;
+	char const* captureName = options.captureName;
+	char const* audioName = options.audioName;
+	char const* profileName = options.profileName;
+
+	if (options.seeded) {
+		chip8.Seed(options.seed);
+	}
+	RomError error = chip8.LoadROM(romName);
+	if (error != RomError::None) {
+		std::cerr << "Could not load " << romName << ": " << RomErrorText(error) << "\n";
+		return EXIT_FAILURE;
+	}
+	if constexpr (classic) {
+		if (options.loadState && !chip8.LoadState(options.loadState)) {
+			std::cerr << "Could not load save state " << options.loadState << "\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	InputLog log;
+	if (replay) {
+		if (!log.Load(replay)) {
+			std::cerr << "Could not read input log " << replay << "\n";
+			return EXIT_FAILURE;
+		}
+		if (log.romHash != InputLog::HashRom(romName)) {
+			std::cerr << "Warning: " << replay << " was recorded on a different ROM\n";
+		}
+		chip8.Seed(log.seed);
+		perFrame = log.instructionsPerFrame;
+		frames = log.frames;
+	}
+	Scheduler scheduler(perFrame);
+	scheduler.SetIdleSkip(options.idleSkip);
+
+	Capture capture;
+	if (captureName) {
+		Capture::Format format;
+		if (!replay && frames == 0) {
+			std::cerr << "--capture needs -f or --replay, -i runs have no frames\n";
+			return EXIT_FAILURE;
+		}
+		if (!Capture::FormatFromName(captureName, format) || !capture.Open(captureName, format, options.captureScale, true)) {
+			std::cerr << "Could not open capture " << captureName << "\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	NullAudio noAudio;
+	WavAudio wav;
+	bool toWav = audioName && std::strcmp(audioName, "null") != 0;
+	if (audioName && !replay && frames == 0) {
+		std::cerr << "--audio needs -f or --replay, -i runs have no frames\n";
+		return EXIT_FAILURE;
+	}
+	if (toWav && !wav.Open(audioName)) {
+		std::cerr << "Could not open audio " << audioName << "\n";
+		return EXIT_FAILURE;
+	}
+	Beeper beeper(toWav ? (AudioSink&)wav : noAudio);
+	uint64_t beepFrames = 0;
+
+	Profiler profiler;
+	if (profileName) {
+#ifdef CHIP8_PROFILE
+		if constexpr (classic) {
+			chip8.SetProfiler(&profiler);
+		}
+#else
+		std::cerr << "--profile needs a build with CHIP8_PROFILE\n";
+		return EXIT_FAILURE;
+#endif
+	}
+
+	//Frames run back to back here, WaitForNextFrame() is only for real-time front-ends
+	auto start = std::chrono::steady_clock::now();
+	if (replay) {
+		for (uint64_t i = 0; i < frames; i++) {
+			log.Replay(i, chip8.input);
+			bool beeped = scheduler.RunFrame(chip8);
+			if constexpr (classic) {
+				capture.Submit(chip8.display);
+			}
+			if (audioName) {
+				beeper.Frame(beeped);
+				beepFrames += beeped;
+			}
+		}
+		instructions = frames * perFrame;
+	} else if (frames > 0) {
+		for (uint64_t i = 0; i < frames; i++) {
+			bool beeped = scheduler.RunFrame(chip8);
+			if constexpr (classic) {
+				capture.Submit(chip8.display);
+			}
+			if (audioName) {
+				beeper.Frame(beeped);
+				beepFrames += beeped;
+			}
+		}
+		instructions = frames * perFrame;
+	} else {
+		chip8.Run(instructions);
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	double seconds = std::chrono::duration<double>(end - start).count();
+	std::cout << romName << "\n"
+		<< "  variant:        " << RomProfileName(options.profile) << "\n"
+		<< "  instructions:   " << instructions << "\n"
+		<< "  seconds:        " << seconds << "\n"
+		<< "  instructions/s: " << (seconds > 0 ? instructions / seconds : 0) << "\n"
+		<< "  ns/instruction: " << (instructions > 0 ? seconds * 1e9 / instructions : 0) << "\n";
+
+	//Final state, for comparing a replay between builds
+	std::cout << std::hex << "  final state:    pc 0x" << chip8.ProgramCounter() << ", I 0x" << chip8.Index()
+		<< ", display " << chip8.DisplayHash() << std::dec << "\n";
+
+	if (captureName) {
+		if (!capture.Close()) {
+			std::cerr << "Could not write capture " << captureName << "\n";
+			return EXIT_FAILURE;
+		}
+		std::cout << "  captured:       " << capture.Frames() << " frames, " << capture.Duplicates() << " repeats folded, "
+			<< capture.Dropped() << " dropped\n";
+	}
+
+	if (audioName) {
+		if (toWav && !wav.Close()) {
+			std::cerr << "Could not write audio " << audioName << "\n";
+			return EXIT_FAILURE;
+		}
+		std::cout << "  audio:          " << beepFrames << " of " << frames << " frames beeping\n";
+	}
+
+	if (profileName) {
+		std::string prefix = profileName;
+		if (!profiler.WriteJson((prefix + ".json").c_str()) || !profiler.WriteCsv((prefix + ".csv").c_str())
+			|| !profiler.WriteHeatmap((prefix + ".ppm").c_str())) {
+			std::cerr << "Could not write profile " << prefix << ".*\n";
+			return EXIT_FAILURE;
+		}
+		std::cout << "  key waits:      " << profiler.keyWaitCycles << " of " << profiler.instructions << " instructions\n";
+	}
+
+	if constexpr (classic) {
+		if (options.saveState && !chip8.SaveState(options.saveState)) {
+			std::cerr << "Could not write save state " << options.saveState << "\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	return 0;
+}
+
+//ARG consists of:
+//	ROM file to load
+//	Optional instruction count (-i) or frame count (-f)
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		Usage(argv[0]);
+	}
+
+	Options options;
+	options.romName = argv[1];
+	char const* variant = nullptr;
+	char const* coreName = nullptr;
+
+	for (int i = 2; i < argc; i++) {
+		if (std::strcmp(argv[i], "--no-idle-skip") == 0) {
+			options.idleSkip = false;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			Usage(argv[0]);
+		}
+
+		if (std::strcmp(argv[i], "-i") == 0) {
+			options.instructions = std::stoull(argv[++i]);
+		} else if (std::strcmp(argv[i], "-f") == 0) {
+			options.frames = std::stoull(argv[++i]);
+		} else if (std::strcmp(argv[i], "--ipf") == 0) {
+			options.perFrame = std::stoul(argv[++i]);
+		} else if (std::strcmp(argv[i], "--core") == 0) {
+			coreName = argv[++i];
+		} else if (std::strcmp(argv[i], "--variant") == 0) {
+			variant = argv[++i];
+		} else if (std::strcmp(argv[i], "--seed") == 0) {
+			options.seed = std::stoul(argv[++i]);
+			options.seeded = true;
+		} else if (std::strcmp(argv[i], "--replay") == 0) {
+			options.replay = argv[++i];
+		} else if (std::strcmp(argv[i], "--load-state") == 0) {
+			options.loadState = argv[++i];
+		} else if (std::strcmp(argv[i], "--save-state") == 0) {
+			options.saveState = argv[++i];
+		} else if (std::strcmp(argv[i], "--profile") == 0) {
+			options.profileName = argv[++i];
+		} else if (std::strcmp(argv[i], "--capture") == 0) {
+			options.captureName = argv[++i];
+		} else if (std::strcmp(argv[i], "--capture-scale") == 0) {
+			options.captureScale = std::stoul(argv[++i]);
+		} else if (std::strcmp(argv[i], "--audio") == 0) {
+			options.audioName = argv[++i];
+		} else {
+			Usage(argv[0]);
+		}
+	}
+
+	//The machine is picked from the ROM's opcodes unless --variant says otherwise
+	RomProfile& profile = options.profile;
+	if (variant) {
+		if (!RomProfileFromName(variant, profile)) {
+			Usage(argv[0]);
+		}
+	} else {
+		RomFile rom;
+		RomError error = rom.Open(options.romName, MAX_XO_ROM_SIZE);
+		if (error != RomError::None) {
+			std::cerr << "Could not load " << options.romName << ": " << RomErrorText(error) << "\n";
+			return EXIT_FAILURE;
+		}
+		profile = DetectProfile(rom.Data(), rom.Size());
+	}
+
+	if (profile == RomProfile::Chip8) {
+		Chip8 chip8;
+		Chip8::Core core;
+		if (coreName) {
+			if (!Chip8::CoreFromName(coreName, core)) {
+				Usage(argv[0]);
+			}
+			chip8.SetCore(core);
+		}
+		return Run(chip8, options);
+	}
+
+	if (coreName || options.loadState || options.saveState || options.captureName || options.profileName) {
+		std::cerr << options.romName << " is a " << RomProfileName(profile) << " ROM, which has no cores, states, capture or profiler yet\n";
+		return EXIT_FAILURE;
+	}
+	if (profile == RomProfile::SuperChip) {
+		std::unique_ptr<SuperChip8> machine = std::make_unique<SuperChip8>();
+		return Run(*machine, options);
+	}
+	std::unique_ptr<XoChip8> machine = std::make_unique<XoChip8>();	//64 KB of memory, too big for the stack
+	return Run(*machine, options);
+}
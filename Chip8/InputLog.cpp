@@ -0,0 +1,122 @@
+#include "InputLog.h"
+#include "RomFile.h"
+#include "RomLibrary.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+void InputLog::Record(uint64_t frame, uint8_t const* keys)
+{
+	for (unsigned int key = 0; key < KEY_COUNT; key++) {
+		uint8_t pressed = (keys[key] != 0);
+		if (pressed != recorded[key]) {
+			events.push_back(InputEvent{ frame, (uint8_t)key, pressed });
+			recorded[key] = pressed;
+		}
+	}
+	frames = frame + 1;
+}
+
+void InputLog::Truncate(uint64_t frame)
+{
+	auto kept = std::lower_bound(events.begin(), events.end(), frame,
+		[](InputEvent const& event, uint64_t value) { return event.frame < value; });
+	events.erase(kept, events.end());
+
+	std::memset(recorded, 0, sizeof(recorded));
+	for (InputEvent const& event : events) {
+		recorded[event.key] = event.pressed;
+	}
+	frames = frame;
+}
+
+void InputLog::Replay(uint64_t frame, uint8_t* keys)
+{
+	if (frame < replayed) {		//went backwards, start over
+		cursor = 0;
+		std::memset(keys, 0, KEY_COUNT);
+	}
+
+	for (; cursor < events.size() && events[cursor].frame <= frame; cursor++) {
+		keys[events[cursor].key] = events[cursor].pressed;
+	}
+	replayed = frame;
+}
+
+bool InputLog::Save(char const* filename) const
+{
+	InputLogHeader header{ INPUT_LOG_MAGIC, INPUT_LOG_VERSION, seed, instructionsPerFrame,
+		romHash, frames, (uint32_t)events.size(), 0 };
+
+	std::vector<uint8_t> bytes;
+	uint64_t previous = 0;
+	for (InputEvent const& event : events) {
+		uint64_t delta = event.frame - previous;	//LEB128, 7 bits at a time
+		do {
+			uint8_t low = delta & 0x7Fu;
+			delta >>= 7u;
+			bytes.push_back(low | (delta != 0 ? 0x80u : 0u));
+		} while (delta != 0);
+
+		bytes.push_back((uint8_t)(event.key | (event.pressed << 4u)));
+		previous = event.frame;
+	}
+
+	std::ofstream file(filename, std::ios::binary);
+	file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	file.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+	return file.good();
+}
+
+bool InputLog::Load(char const* filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	InputLogHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+		|| header.magic != INPUT_LOG_MAGIC || header.version != INPUT_LOG_VERSION) {
+		return false;
+	}
+
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	InputScript loaded;
+	size_t i = 0;
+	uint64_t frame = 0;
+	for (uint32_t n = 0; n < header.eventCount; n++) {
+		uint64_t delta = 0;
+		unsigned int shift = 0;
+		do {
+			if (i >= bytes.size() || shift > 63) {
+				return false;
+			}
+			delta |= (uint64_t)(bytes[i] & 0x7Fu) << shift;
+			shift += 7;
+		} while (bytes[i++] & 0x80u);
+
+		if (i >= bytes.size()) {
+			return false;
+		}
+		frame += delta;
+		loaded.push_back(InputEvent{ frame, (uint8_t)(bytes[i] & 0xFu), (uint8_t)((bytes[i] >> 4u) & 1u) });
+		i++;
+	}
+
+	seed = header.seed;
+	instructionsPerFrame = header.instructionsPerFrame;
+	romHash = header.romHash;
+	frames = header.frames;
+	events = std::move(loaded);
+	Truncate(frames);		//rebuilds the recording state, so a loaded log can be extended
+	cursor = 0;
+	replayed = 0;
+	return true;
+}
+
+uint64_t InputLog::HashRom(char const* filename)
+{
+	RomFile rom;
+	if (rom.Open(filename, MAX_XO_ROM_SIZE) != RomError::None) {
+		return 0;
+	}
+	return Xxh64(rom.Data(), rom.Size());
+}
@@ -0,0 +1,69 @@
+//Deterministic sessions. A Chip8 run is fully decided by the ROM, the RNG seed, the instructions
+//per frame and the keys at the start of each frame, so that is all an input log stores.
+//A live session records one, and chip8_headless --replay plays it back at full speed,
+//which turns a bug report into a regression run.
+//
+//File: InputLogHeader, then one record per key change: varint frame delta, then key | pressed << 4.
+
+#ifndef CHIP_8_INPUT_LOG_H
+#define CHIP_8_INPUT_LOG_H
+
+#include "Chip8.h"
+#include "Scheduler.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct InputEvent
+{
+	uint64_t frame;		//applied before this frame runs
+	uint8_t key;		//0x0 - 0xF
+	uint8_t pressed;
+};
+
+typedef std::vector<InputEvent> InputScript;
+
+const uint32_t INPUT_LOG_MAGIC = 0x4C493843;	//"C8IL"
+const uint32_t INPUT_LOG_VERSION = 2;	//2: romHash is Xxh64, was FNV-1a
+
+struct InputLogHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t seed;
+	uint32_t instructionsPerFrame;
+	uint64_t romHash;		//InputLog::HashRom of the ROM it was recorded on
+	uint64_t frames;
+	uint32_t eventCount;
+	uint32_t reserved;
+};
+
+class InputLog
+{
+	public:
+		uint32_t seed{};
+		uint32_t instructionsPerFrame{ DEFAULT_INSTRUCTIONS_PER_FRAME };
+		uint64_t romHash{};
+		uint64_t frames{};		//length of the session
+		InputScript events;		//sorted by frame
+
+		//Recording. Call once per frame, before it runs, with the keys it will see.
+		void Record(uint64_t frame, uint8_t const* keys);
+		void Truncate(uint64_t frame);	//forget `frame` and everything after it, e.g. after a rewind
+
+		//Playback. Sets `keys` to what they were at the start of `frame`. Cheapest when called for
+		//frames 0, 1, 2... in order, but any frame works.
+		void Replay(uint64_t frame, uint8_t* keys);
+
+		bool Save(char const* filename) const;
+		bool Load(char const* filename);	//false if missing, truncated or another version
+
+		static uint64_t HashRom(char const* filename);	//Xxh64 of the ROM, as RomLibrary indexes it. 0 if it cannot be loaded
+
+	private:
+		uint8_t recorded[KEY_COUNT]{};	//keys as of the last Record()
+		size_t cursor{};				//next event Replay() applies
+		uint64_t replayed{};			//frame the cursor belongs to
+};
+
+#endif
@@ -0,0 +1,655 @@
+#include "Jit.h"
+#include "Chip8.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+
+#ifdef CHIP8_JIT_AVAILABLE
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+const size_t CODE_SIZE = 1 << 20;			//1 MB of generated code before the cache is flushed
+const size_t MAX_BLOCK_CODE = 8192;			//room left in the buffer before a block is translated
+const size_t MAX_INSTRUCTION_CODE = 512;	//worst case for one instruction (Fx55/Fx65 with x = F), with its budget check
+const unsigned int MAX_BLOCK_LENGTH = 64;	//instructions, keeps the search in Invalidate() short
+const size_t EXIT_OFFSET = 32;				//the buffer starts with the enter and exit stubs every block shares,
+const size_t HEADER_SIZE = 64;				//blocks follow them
+
+Jit::Jit(Jit const&)
+{}
+
+Jit& Jit::operator=(Jit const& other)
+{
+	if (this != &other) {
+		Clear();
+	}
+	return *this;
+}
+
+Jit::~Jit()
+{
+#ifdef CHIP8_JIT_AVAILABLE
+	if (code != nullptr) {
+		munmap(code, CODE_SIZE);
+		munmap(writable, CODE_SIZE);
+	}
+#endif
+}
+
+//The table stays allocated, so reloading a program (a fuzzer does it for every input) costs
+//only as much as the previous program used of it. The code buffer is not rewound: writing over
+//code that ran moments ago makes the CPU flush its pipeline, fresh lines do not.
+void Jit::Clear()
+{
+	for (uint16_t address : used) {
+		Entry& entry = entries[address];
+		if (entry.bytes != 0) {		//most were only ever interpreted
+			std::memset(&covered[address], 0, std::min<size_t>(entry.bytes, MEMORY_SIZE - address));
+			targets[address] = code + EXIT_OFFSET;
+		}
+		entry.state = EMPTY;
+		entry.bytes = 0;
+		entry.heat = 0;
+	}
+	used.clear();
+}
+
+//A write to `address` changes the opcodes starting there and one byte before it.
+//Every block covering one of those bytes is dropped for good and left to the interpreter.
+bool Jit::Invalidate(uint16_t address, unsigned int length)
+{
+	if (entries.empty()) {
+		return false;
+	}
+
+	unsigned int lastByte = address + length;	//one past the last byte written
+	bool translated = false;
+	for (unsigned int i = address; i < lastByte && i < MEMORY_SIZE; i++) {
+		translated |= covered[i] != 0;
+	}
+	if (!translated) {
+		return false;
+	}
+
+	bool dropped = false;
+	unsigned int first = (address > MAX_BLOCK_LENGTH * 2) ? address - MAX_BLOCK_LENGTH * 2 : 0;
+	for (unsigned int start = first; start < lastByte && start < MEMORY_SIZE; start++) {
+		Entry& entry = entries[start];
+		if (entry.state == COMPILED && start + entry.bytes > address) {
+			entry.state = INTERPRET;
+			targets[start] = code + EXIT_OFFSET;
+			dropped = true;
+		}
+	}
+	return dropped;
+}
+
+Jit::Block const* Jit::Lookup(uint16_t address, uint8_t const* memory, Helpers const& helpers)
+{
+#ifdef CHIP8_JIT_AVAILABLE
+	if (entries.empty()) {
+		entries.assign(MEMORY_SIZE, Entry{ { nullptr }, 0, EMPTY, 0 });
+		covered.assign(MEMORY_SIZE, 0);
+	}
+
+	Entry& entry = entries[address];
+	if (entry.state == EMPTY && Heat(entry, address)) {
+		entry.state = Compile(address, memory, helpers, entry) ? COMPILED : INTERPRET;
+	}
+
+	return (entry.state == COMPILED) ? &entry.block : nullptr;
+#else
+	(void)address;
+	(void)memory;
+	(void)helpers;
+	return nullptr;
+#endif
+}
+
+#ifdef CHIP8_JIT_AVAILABLE
+
+static_assert(std::is_standard_layout_v<Chip8State>, "the Jit addresses Chip8State fields by offsetof");
+
+//Where generated code finds each part of the machine, relative to rbx.
+const uint32_t INPUT = offsetof(Chip8State, input);
+const uint32_t REGISTERS = offsetof(Chip8State, registers);
+const uint32_t MEMORY = offsetof(Chip8State, memory);
+const uint32_t INDEX = offsetof(Chip8State, index);
+const uint32_t STACK = offsetof(Chip8State, stack);
+const uint32_t STACK_POINTER = offsetof(Chip8State, sPtr);
+const uint32_t FAULTS = offsetof(Chip8State, faults);
+const uint32_t DELAY = offsetof(Chip8State, delay);
+const uint32_t SOUND = offsetof(Chip8State, sound);
+const uint32_t RANDOM = offsetof(Chip8State, random) + offsetof(Random, state);
+const uint32_t DISPLAY_GENERATION = offsetof(Chip8State, displayGeneration);
+const uint32_t CLEARED_GENERATION = offsetof(Chip8State, clearedGeneration);
+
+//x86 register numbers, for ModRM fields
+const uint8_t AL = 0, CL = 1, DL = 2, BL = 3, AH = 4, ESI = 6;
+const uint8_t RAX = 0, RSI = 6;
+
+//Tiny x86-64 encoder, only what the translations below need.
+//In a block: rbx = the Chip8State, rbp = the Chip8 (for helper calls), r12 = budget left,
+//r13 = Jit::targets. All four are callee-saved, so helper calls keep them. rax, rcx, rdx and rsi are scratch.
+struct Emitter
+{
+	uint8_t* out;
+	intptr_t delta;		//where `out` will run from, minus `out`, for relative jumps
+
+	void Byte(uint8_t value) { *out++ = value; }
+	void Bytes(std::initializer_list<uint8_t> values) { for (uint8_t v : values) Byte(v); }
+	void Word(uint16_t value) { Byte(value & 0xFFu); Byte(value >> 8u); }
+	void Dword(uint32_t value) { Word(value & 0xFFFFu); Word(value >> 16u); }
+	void Qword(uint64_t value) { Dword(value & 0xFFFFFFFFu); Dword(value >> 32u); }
+
+	//`opcode` with a [rbx + disp32] operand, `reg` in the ModRM reg field
+	void State(std::initializer_list<uint8_t> opcode, uint8_t reg, uint32_t disp)
+	{
+		Bytes(opcode);
+		Byte(0x83 | (reg << 3u));							//mod 10, rm = rbx
+		Dword(disp);
+	}
+
+	//`opcode` with a [rbx + index * 2^scale + disp32] operand
+	void StateIndexed(std::initializer_list<uint8_t> opcode, uint8_t reg, uint8_t index, uint8_t scale, uint32_t disp)
+	{
+		Bytes(opcode);
+		Byte(0x84 | (reg << 3u));							//mod 10, rm = SIB
+		Byte((scale << 6u) | (index << 3u) | BL);			//base = rbx
+		Dword(disp);
+	}
+
+	void LoadAl(unsigned int reg) { State({ 0x8A }, AL, REGISTERS + reg); }		//mov al, V[reg]
+	void StoreAl(unsigned int reg) { State({ 0x88 }, AL, REGISTERS + reg); }	//mov V[reg], al
+	void LoadIndex(uint8_t reg) { State({ 0x0F, 0xB7 }, reg, INDEX); }			//movzx reg, word [index]
+
+	void Jump(std::initializer_list<uint8_t> opcode, uint8_t const* target)		//rel32 jump or jcc
+	{
+		Bytes(opcode);
+		Dword((uint32_t)(target - (out + delta + 4)));
+	}
+
+	//Counts the instruction just emitted. Leaves with eax = next if that was the last of the budget.
+	void Count(uint32_t next, uint8_t const* exit)
+	{
+		Byte(0xB8); Dword(next);							//mov eax, next
+		Bytes({ 0x49, 0xFF, 0xCC });						//dec r12
+		Jump({ 0x0F, 0x84 }, exit);							//jz exit
+	}
+
+	//Counts a terminator, which has put the new program counter in eax, and goes on to it.
+	void Leave(uint8_t const* exit)
+	{
+		Bytes({ 0x49, 0xFF, 0xCC });						//dec r12
+		Jump({ 0x0F, 0x84 }, exit);							//jz exit
+		Dispatch(exit);
+	}
+
+	//Jumps straight to the block for the program counter in eax, or to the exit if there is none.
+	//Going back to Chip8::RunJit after every jump cost more than most of the blocks it ran.
+	void Dispatch(uint8_t const* exit)
+	{
+		Byte(0x3D); Dword(MEMORY_MASK);						//cmp eax, MEMORY_MASK (0xFFF is never a block)
+		Jump({ 0x0F, 0x83 }, exit);							//jae exit
+		Bytes({ 0x41, 0xFF, 0x64, 0xC5, 0x00 });			//jmp [r13 + rax * 8]
+	}
+
+	//eax = condition ? skip : next, using the flags already set.
+	void Skip(uint8_t cmovcc, uint32_t next)
+	{
+		Byte(0xB8); Dword(next);							//mov eax, next
+		Byte(0xB9); Dword(next + 2);						//mov ecx, next + 2
+		Bytes({ 0x0F, cmovcc, 0xC1 });						//cmovcc eax, ecx
+	}
+
+	//helper(machine, esi, edx, ecx), the arguments already loaded
+	template <typename Function>
+	void Call(Function function)
+	{
+		Bytes({ 0x48, 0x89, 0xEF });						//mov rdi, rbp
+		Bytes({ 0x48, 0xB8 });								//mov rax, function
+		Qword(reinterpret_cast<uint64_t>(function));
+		Bytes({ 0xFF, 0xD0 });								//call rax
+	}
+
+	//guest memory[(I + offset) & MEMORY_MASK], I already in edx. Leaves the address in esi.
+	void GuestAddress(uint8_t offset)
+	{
+		Bytes({ 0x8D, 0x72, offset });						//lea esi, [rdx + offset]
+		Bytes({ 0x81, 0xE6 }); Dword(MEMORY_MASK);			//and esi, MEMORY_MASK
+	}
+
+	void Epilogue()
+	{
+		Bytes({ 0x4C, 0x89, 0xE2 });						//mov rdx, r12
+		Bytes({ 0x48, 0x83, 0xC4, 0x08 });					//add rsp, 8
+		Bytes({ 0x41, 0x5D });								//pop r13
+		Bytes({ 0x41, 0x5C });								//pop r12
+		Byte(0x5D);											//pop rbp
+		Byte(0x5B);											//pop rbx
+		Byte(0xC3);											//ret
+	}
+
+	void Prologue()
+	{
+		Byte(0x53);											//push rbx
+		Byte(0x55);											//push rbp
+		Bytes({ 0x41, 0x54 });								//push r12
+		Bytes({ 0x41, 0x55 });								//push r13
+		Bytes({ 0x48, 0x83, 0xEC, 0x08 });					//sub rsp, 8 (16-byte aligned again for helper calls)
+		Bytes({ 0x48, 0x89, 0xFB });						//mov rbx, rdi
+		Bytes({ 0x49, 0x89, 0xF4 });						//mov r12, rsi
+		Bytes({ 0x48, 0x89, 0xD5 });						//mov rbp, rdx
+		Bytes({ 0x4D, 0x89, 0xC5 });						//mov r13, r8
+	}
+};
+
+const uint8_t CMOVE = 0x44;
+const uint8_t CMOVNE = 0x45;
+
+//No page is ever writable and executable at once (W^X). The buffer is one memfd mapped twice,
+//read-write where blocks are emitted and read-execute where they run, so compiling a block
+//costs no system call (flipping page protections cost two per block).
+bool Jit::Map()
+{
+	int fd = memfd_create("chip8-jit", MFD_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+
+	void* rw = MAP_FAILED;
+	void* rx = MAP_FAILED;
+	if (ftruncate(fd, CODE_SIZE) == 0) {
+		rw = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		rx = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+	}
+	close(fd);		//the mappings keep the memory alive
+
+	if (rw == MAP_FAILED || rx == MAP_FAILED) {
+		if (rw != MAP_FAILED) {
+			munmap(rw, CODE_SIZE);
+		}
+		if (rx != MAP_FAILED) {
+			munmap(rx, CODE_SIZE);
+		}
+		return false;
+	}
+
+	writable = static_cast<uint8_t*>(rw);
+	code = static_cast<uint8_t*>(rx);
+
+	Emitter emit{ writable, 0 };
+	emit.Prologue();
+	emit.Bytes({ 0xFF, 0xE1 });		//jmp rcx, the instruction to start at
+	emit.out = writable + EXIT_OFFSET;
+	emit.Epilogue();
+	enter = reinterpret_cast<Enter>(code);
+	codeUsed = HEADER_SIZE;
+	targets.assign(MEMORY_SIZE, code + EXIT_OFFSET);
+	return true;
+}
+
+//Every instruction of a block is an entry point as well, so a block the budget stopped half-way
+//is resumed where it stopped rather than translated again from there.
+bool Jit::Compile(uint16_t address, uint8_t const* memory, Helpers const& helpers, Entry& entry)
+{
+	if (code == nullptr && !Map()) {
+		return false;
+	}
+
+	if (codeUsed + MAX_BLOCK_CODE > CODE_SIZE) {	//out of space, start over
+		for (size_t i = 0; i < entries.size(); i++) {
+			if (entries[i].state == COMPILED) {
+				entries[i].state = EMPTY;
+			}
+		}
+		targets.assign(MEMORY_SIZE, code + EXIT_OFFSET);
+		codeUsed = HEADER_SIZE;
+	}
+
+	uint8_t scratch[MAX_BLOCK_CODE];
+	uint16_t starts[MAX_BLOCK_LENGTH];
+	uint8_t const* at = code + codeUsed;
+	size_t size = Translate(address, memory, helpers, scratch, at, starts, entry);
+	if (size == 0) {
+		return false;		//first opcode not translated
+	}
+	std::memcpy(writable + codeUsed, scratch, size);	//one copy, rather than writing next to code that just ran byte by byte
+
+	entry.block.code = at;
+	targets[address] = at;
+	for (unsigned int i = 1; i < entry.bytes / 2u; i++) {
+		Entry& inner = entries[address + 2 * i];
+		if (inner.state == EMPTY) {
+			inner.block.code = at + starts[i];
+			inner.bytes = entry.bytes - 2 * i;
+			inner.state = COMPILED;
+			targets[address + 2 * i] = inner.block.code;
+			used.push_back(address + 2 * i);
+		}
+	}
+	std::memset(&covered[address], 1, entry.bytes);
+	codeUsed += size;
+	return true;
+}
+
+//Emits the block at `address` into `out`, to be run from `at`, returning its size in bytes (0 if the
+//first opcode is not translated). Fills in `entry.bytes` and the code offset of every instruction in `starts`.
+size_t Jit::Translate(uint16_t address, uint8_t const* memory, Helpers const& helpers, uint8_t* out, uint8_t const* at,
+	uint16_t* starts, Entry& entry)
+{
+	uint8_t* start = out;
+	Emitter emit{ start, at - start };
+	uint8_t const* exit = code + EXIT_OFFSET;
+
+	unsigned int pc = address;
+	unsigned int length = 0;
+	bool terminated = false;
+
+	while (!terminated && length < MAX_BLOCK_LENGTH && pc + 1 < MEMORY_SIZE
+		&& (size_t)(emit.out - start) + MAX_INSTRUCTION_CODE <= MAX_BLOCK_CODE) {
+		unsigned int op = (memory[pc] << 8u) | memory[pc + 1];
+		uint8_t x = (op >> 8u) & 0xFu;
+		uint8_t y = (op >> 4u) & 0xFu;
+		uint8_t kk = op & 0xFFu;
+		uint16_t nnn = op & 0xFFFu;
+		unsigned int next = pc + 2;
+		bool translated = true;
+		bool wrote = false;		//stored to guest memory, ecx = whether that changed translated code
+		starts[length] = emit.out - start;
+
+		switch (op >> 12u)
+		{
+			case 0x0:
+			{
+				if ((op & 0xFu) == 0xEu) {				//00EE RET
+					emit.State({ 0x80 }, 7, STACK_POINTER); emit.Byte(0x00);	//cmp byte [sPtr], 0
+					emit.Bytes({ 0x0F, 0x9E, 0xC1 });	//setle cl (signed depth, see Chip8::Pop)
+					emit.Bytes({ 0xD0, 0xE1 });			//shl cl, 1 (FAULT_STACK_UNDERFLOW)
+					emit.State({ 0x08 }, CL, FAULTS);	//or [faults], cl
+					emit.State({ 0xFE }, 1, STACK_POINTER);			//dec byte [sPtr]
+					emit.State({ 0x0F, 0xB6 }, AL, STACK_POINTER);	//movzx eax, byte [sPtr]
+					emit.Bytes({ 0x83, 0xE0, STACK_MASK });			//and eax, STACK_MASK
+					emit.StateIndexed({ 0x0F, 0xB7 }, AL, RAX, 1, STACK);	//movzx eax, word [stack + rax * 2]
+					terminated = true;
+				} else if ((op & 0xFu) == 0x0u) {		//00E0 CLS, the call skipped on a blank display like ClearDisplay does
+					emit.State({ 0x8B }, AL, DISPLAY_GENERATION);		//mov eax, [displayGeneration]
+					emit.State({ 0x3B }, AL, CLEARED_GENERATION);		//cmp eax, [clearedGeneration]
+					uint8_t* skip = emit.out;
+					emit.Bytes({ 0x74, 0x00 });			//je over the call
+					emit.Call(helpers.clear);
+					skip[1] = (uint8_t)(emit.out - (skip + 2));
+				}										//anything else is OP_NULL
+			} break;
+
+			case 0x1:									//JP nnn
+			{
+				emit.Byte(0xB8); emit.Dword(nnn);		//mov eax, nnn
+				terminated = true;
+			} break;
+
+			case 0x2:									//CALL nnn
+			{
+				emit.State({ 0x0F, 0xB6 }, AL, STACK_POINTER);	//movzx eax, byte [sPtr]
+				emit.Bytes({ 0x3C, STACK_SIZE });		//cmp al, STACK_SIZE
+				emit.Bytes({ 0x0F, 0x9D, 0xC1 });		//setge cl (FAULT_STACK_OVERFLOW, signed depth)
+				emit.State({ 0x08 }, CL, FAULTS);		//or [faults], cl
+				emit.Bytes({ 0x83, 0xE0, STACK_MASK });	//and eax, STACK_MASK
+				emit.StateIndexed({ 0x66, 0xC7 }, 0, RAX, 1, STACK);	//mov word [stack + rax * 2], next
+				emit.Word(next);
+				emit.State({ 0xFE }, 0, STACK_POINTER);	//inc byte [sPtr]
+				emit.Byte(0xB8); emit.Dword(nnn);		//mov eax, nnn
+				terminated = true;
+			} break;
+
+			case 0x3:									//SE Vx, byte
+			case 0x4:									//SNE Vx, byte
+			{
+				emit.State({ 0x80 }, 7, REGISTERS + x); emit.Byte(kk);	//cmp byte V[x], kk
+				emit.Skip((op >> 12u) == 0x3 ? CMOVE : CMOVNE, next);
+				terminated = true;
+			} break;
+
+			case 0x5:									//SE Vx, Vy
+			case 0x9:									//SNE Vx, Vy
+			{
+				emit.LoadAl(x);
+				emit.State({ 0x3A }, AL, REGISTERS + y);	//cmp al, V[y]
+				emit.Skip((op >> 12u) == 0x5 ? CMOVE : CMOVNE, next);
+				terminated = true;
+			} break;
+
+			case 0x6:									//LD Vx, byte
+			{
+				emit.State({ 0xC6 }, 0, REGISTERS + x); emit.Byte(kk);	//mov byte V[x], kk
+			} break;
+
+			case 0x7:									//ADD Vx, byte
+			{
+				emit.State({ 0x80 }, 0, REGISTERS + x); emit.Byte(kk);	//add byte V[x], kk
+			} break;
+
+			case 0x8:
+			{
+				switch (op & 0xFu)
+				{
+					case 0x0:							//LD Vx, Vy
+					{
+						emit.LoadAl(y);
+						emit.StoreAl(x);
+					} break;
+					case 0x1:							//OR Vx, Vy
+					{
+						emit.LoadAl(y);
+						emit.State({ 0x08 }, AL, REGISTERS + x);	//or V[x], al
+					} break;
+					case 0x2:							//AND Vx, Vy
+					{
+						emit.LoadAl(y);
+						emit.State({ 0x20 }, AL, REGISTERS + x);	//and V[x], al
+					} break;
+					case 0x3:							//XOR Vx, Vy
+					{
+						emit.LoadAl(y);
+						emit.State({ 0x30 }, AL, REGISTERS + x);	//xor V[x], al
+					} break;
+					case 0x4:							//ADD Vx, Vy; VF = carry, then Vx = sum
+					{
+						emit.LoadAl(x);
+						emit.State({ 0x02 }, AL, REGISTERS + y);	//add al, V[y]
+						emit.Bytes({ 0x0F, 0x92, 0xC1 });			//setc cl
+						emit.State({ 0x88 }, CL, REGISTERS + 0xF);	//mov VF, cl
+						emit.StoreAl(x);
+					} break;
+					case 0x5:							//SUB Vx, Vy; VF = Vx > Vy, then Vx -= Vy
+					case 0x7:							//SUBN Vx, Vy; VF = Vy > Vx, then Vx = Vy - Vx
+					{
+						uint8_t a = ((op & 0xFu) == 0x5) ? x : y;
+						uint8_t b = ((op & 0xFu) == 0x5) ? y : x;
+						emit.LoadAl(a);
+						emit.State({ 0x3A }, AL, REGISTERS + b);	//cmp al, V[b]
+						emit.Bytes({ 0x0F, 0x97, 0xC1 });			//seta cl
+						emit.State({ 0x88 }, CL, REGISTERS + 0xF);	//mov VF, cl
+						emit.LoadAl(a);					//reload, VF may be one of the operands
+						emit.State({ 0x2A }, AL, REGISTERS + b);	//sub al, V[b]
+						emit.StoreAl(x);
+					} break;
+					case 0x6:							//SHR Vx; VF = Vx & 1, then Vx >>= 1
+					{
+						emit.LoadAl(x);
+						emit.Bytes({ 0x24, 0x01 });		//and al, 1
+						emit.StoreAl(0xF);
+						emit.State({ 0xD0 }, 5, REGISTERS + x);	//shr byte V[x], 1
+					} break;
+					case 0xE:							//SHL Vx; VF = Vx >> 7, then Vx <<= 1
+					{
+						emit.LoadAl(x);
+						emit.Bytes({ 0xC0, 0xE8, 0x07 });	//shr al, 7
+						emit.StoreAl(0xF);
+						emit.State({ 0xD0 }, 4, REGISTERS + x);	//shl byte V[x], 1
+					} break;
+				}										//anything else is OP_NULL
+			} break;
+
+			case 0xA:									//LD I, nnn
+			{
+				emit.State({ 0x66, 0xC7 }, 0, INDEX);	//mov word [index], nnn
+				emit.Word(nnn);
+			} break;
+
+			case 0xB:									//JP V0, nnn
+			{
+				emit.State({ 0x0F, 0xB6 }, AL, REGISTERS);	//movzx eax, V0
+				emit.Byte(0x05);						//add eax, nnn
+				emit.Dword(nnn);
+				terminated = true;
+			} break;
+
+			case 0xC:									//RND Vx, byte; Random::NextByte inline
+			{
+				emit.State({ 0x8B }, AL, RANDOM);		//mov eax, [random]
+				emit.Bytes({ 0x89, 0xC1, 0xC1, 0xE1, 0x0D, 0x31, 0xC8 });	//ecx = eax << 13; eax ^= ecx
+				emit.Bytes({ 0x89, 0xC1, 0xC1, 0xE9, 0x11, 0x31, 0xC8 });	//ecx = eax >> 17; eax ^= ecx
+				emit.Bytes({ 0x89, 0xC1, 0xC1, 0xE1, 0x05, 0x31, 0xC8 });	//ecx = eax << 5; eax ^= ecx
+				emit.State({ 0x89 }, AL, RANDOM);		//mov [random], eax
+				emit.Bytes({ 0xC1, 0xE8, 0x18 });		//shr eax, 24
+				emit.Bytes({ 0x24, kk });				//and al, kk
+				emit.StoreAl(x);
+			} break;
+
+			case 0xD:									//DRW Vx, Vy, nibble
+			{
+				emit.Byte(0xBE); emit.Dword(x);			//mov esi, x
+				emit.Byte(0xBA); emit.Dword(y);			//mov edx, y
+				emit.Byte(0xB9); emit.Dword(op & 0xFu);	//mov ecx, n
+				emit.Call(helpers.draw);
+			} break;
+
+			case 0xE:
+			{
+				if ((op & 0xFu) == 0xEu || (op & 0xFu) == 0x1u) {	//Ex9E SKP Vx / ExA1 SKNP Vx
+					emit.State({ 0x0F, 0xB6 }, AL, REGISTERS + x);	//movzx eax, V[x]
+					emit.Bytes({ 0x83, 0xE0, KEY_MASK });			//and eax, KEY_MASK
+					emit.StateIndexed({ 0x80 }, 7, RAX, 0, INPUT);	//cmp byte [input + rax], 0
+					emit.Byte(0x00);
+					emit.Skip((op & 0xFu) == 0xEu ? CMOVNE : CMOVE, next);
+					terminated = true;
+				}										//anything else is OP_NULL
+			} break;
+
+			case 0xF:
+			{
+				switch (kk)
+				{
+					case 0x07:							//LD Vx, DT
+					{
+						emit.State({ 0x8A }, AL, DELAY);
+						emit.StoreAl(x);
+					} break;
+					case 0x15:							//LD DT, Vx
+					case 0x18:							//LD ST, Vx
+					{
+						emit.LoadAl(x);
+						emit.State({ 0x88 }, AL, kk == 0x15 ? DELAY : SOUND);
+					} break;
+					case 0x1E:							//ADD I, Vx
+					{
+						emit.State({ 0x0F, 0xB6 }, AL, REGISTERS + x);	//movzx eax, V[x]
+						emit.State({ 0x66, 0x01 }, AL, INDEX);			//add [index], ax
+					} break;
+					case 0x29:							//LD F, Vx
+					{
+						emit.State({ 0x0F, 0xB6 }, AL, REGISTERS + x);	//movzx eax, V[x]
+						emit.Bytes({ 0x8D, 0x44, 0x80, (uint8_t)FONTSET_START });	//lea eax, [rax + rax * 4 + FONTSET_START]
+						emit.State({ 0x66, 0x89 }, AL, INDEX);			//mov [index], ax
+					} break;
+					case 0x33:							//LD B, Vx
+					{
+						emit.State({ 0x0F, 0xB6 }, AL, REGISTERS + x);	//movzx eax, V[x]
+						emit.Bytes({ 0xB1, 0x0A });		//mov cl, 10
+						emit.Bytes({ 0xF6, 0xF1 });		//div cl: al = value / 10, ah = ones
+						emit.LoadIndex(DL);
+						emit.GuestAddress(2);
+						emit.StateIndexed({ 0x88 }, AH, RSI, 0, MEMORY);	//mov [memory + rsi], ah
+						emit.Bytes({ 0x0F, 0xB6, 0xC0 });	//movzx eax, al
+						emit.Bytes({ 0xF6, 0xF1 });		//div cl: al = hundreds, ah = tens
+						emit.GuestAddress(1);
+						emit.StateIndexed({ 0x88 }, AH, RSI, 0, MEMORY);
+						emit.GuestAddress(0);
+						emit.StateIndexed({ 0x88 }, AL, RSI, 0, MEMORY);
+						emit.LoadIndex(ESI);
+						emit.Byte(0xBA); emit.Dword(3);	//mov edx, 3
+						emit.Call(helpers.written);
+						wrote = true;
+					} break;
+					case 0x55:							//LD [I], Vx
+					{
+						emit.LoadIndex(DL);
+						for (uint8_t i = 0; i <= x; i++) {
+							emit.GuestAddress(i);
+							emit.LoadAl(i);
+							emit.StateIndexed({ 0x88 }, AL, RSI, 0, MEMORY);	//mov [memory + rsi], al
+						}
+						emit.LoadIndex(ESI);
+						emit.Byte(0xBA); emit.Dword(x + 1u);	//mov edx, x + 1
+						emit.Call(helpers.written);
+						wrote = true;
+					} break;
+					case 0x65:							//LD Vx, [I]
+					{
+						emit.LoadIndex(DL);
+						for (uint8_t i = 0; i <= x; i++) {
+							emit.GuestAddress(i);
+							emit.StateIndexed({ 0x8A }, AL, RSI, 0, MEMORY);	//mov al, [memory + rsi]
+							emit.StoreAl(i);
+						}
+					} break;
+					case 0x0A:
+					{
+						translated = false;				//the key wait stays interpreted
+					} break;
+				}										//anything else is OP_NULL
+			} break;
+		}
+
+		if (!translated) {
+			break;
+		}
+
+		length++;
+		pc = next;
+		if (terminated) {
+			emit.Leave(exit);
+		} else if (wrote) {
+			emit.Bytes({ 0x89, 0xC1 });					//mov ecx, eax (the helper's answer)
+			emit.Count(next, exit);
+			emit.Bytes({ 0x84, 0xC9 });					//test cl, cl
+			emit.Jump({ 0x0F, 0x85 }, exit);			//jnz exit: this or another block may be stale now
+		} else {
+			emit.Count(next, exit);
+		}
+	}
+
+	if (length == 0) {
+		return 0;
+	}
+
+	if (!terminated) {							//fell off the end of the block, eax = pc already
+		emit.Dispatch(exit);
+	}
+
+	entry.bytes = pc - address;
+	return emit.out - start;
+}
+
+#else
+
+bool Jit::Compile(uint16_t, uint8_t const*, Helpers const&, Entry&)
+{
+	return false;
+}
+
+#endif
@@ -0,0 +1,127 @@
+//Basic-block translation cache for Chip8::Core::Jit.
+//Straight-line runs of CHIP-8 code are translated to x86-64 and cached per entry address.
+//A block ends at the first jump/skip (1nnn, 2nnn, 00EE, 3xkk..9xy0, Bnnn, Ex9E/ExA1), which it
+//executes itself before jumping on to the next block if there is one, or right before Fx0A, the only
+//opcode it leaves to the interpreter. Dxyn and 00E0
+//call back into the machine, everything else (timers, memory, RNG) is inline.
+//A block counts down the instruction budget it is given and stops wherever that runs out. Each of
+//its instructions is an entry point too, so the next run picks it up right there.
+
+#ifndef CHIP_8_JIT_H
+#define CHIP_8_JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Only System V x86-64 Linux and BSD (memfd_create, FreeBSD 13 on) are supported, everywhere else Lookup() always returns
+//nullptr and Core::Jit behaves like the interpreter. macOS is left out: its hardened runtime
+//wants MAP_JIT and pthread_jit_write_protect_np, which this does not use.
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(__APPLE__) && !defined(CHIP8_NO_JIT)
+#define CHIP8_JIT_AVAILABLE
+#endif
+
+//Times an address is reached before a block is translated from it. Code that runs once (most of a
+//fuzz input, a ROM's setup) is cheaper to interpret than to translate and then run cold.
+const uint8_t JIT_HOT_VISITS = 2;
+
+struct Chip8State;
+class Chip8;
+
+class Jit
+{
+	public:
+		struct Exit			//returned in rax:rdx
+		{
+			uint64_t counter;	//where the machine continues
+			uint64_t cycles;	//budget left over
+		};
+
+		//The stub every block is entered through, with a budget of at least 1. Every field of the state
+		//is addressed directly, the machine is only passed on to the helpers.
+		typedef Exit (*Enter) (Chip8State* state, uint64_t cycles, Chip8* machine, void const* code, void const* const* targets);
+
+		//What generated code calls for the opcodes it does not do inline.
+		struct Helpers
+		{
+			void (*draw)(Chip8& machine, unsigned int x, unsigned int y, unsigned int rows);	//Dxyn
+			void (*clear)(Chip8& machine);														//00E0
+			bool (*written)(Chip8& machine, unsigned int address, unsigned int length);		//after Fx33/Fx55, true if translated code changed
+		};
+
+		struct Block
+		{
+			void const* code;	//the instruction to start at, possibly in the middle of a translated run
+		};
+
+		Jit() = default;
+		Jit(Jit const&);				//copies start with an empty cache, code is never shared.
+		Jit& operator=(Jit const&);
+		~Jit();
+
+		//Compiled block starting at `address`, translating it once the address is hot.
+		//nullptr means the caller must interpret the instruction at `address`.
+		Block const* Lookup(uint16_t address, uint8_t const* memory, Helpers const& helpers);
+
+		//Counts a visit by the interpreter, true if it should hand over to Lookup at `address`:
+		//a block starts there, or the address just became hot.
+		bool Ready(uint16_t address)
+		{
+			if (entries.empty()) {
+				return false;
+			}
+			Entry& entry = entries[address];
+			return entry.state == COMPILED || (entry.state == EMPTY && Heat(entry, address));
+		}
+
+		Exit Run(Block const& block, Chip8State* state, uint64_t cycles, Chip8* machine) const
+		{
+			return enter(state, cycles, machine, block.code, targets.data());
+		}
+
+		bool Invalidate(uint16_t address, unsigned int length);	//guest memory was written, true if a block was dropped
+		void Clear();											//new program loaded
+
+	private:
+		enum State : uint8_t
+		{
+			EMPTY,			//never looked up
+			COMPILED,		//block.code is valid
+			INTERPRET,		//first opcode is not translated, or the block was self-modified
+		};
+
+		struct Entry
+		{
+			Block block;
+			uint16_t bytes;	//guest bytes covered, used to find blocks hit by a write.
+			State state;
+			uint8_t heat;	//visits while EMPTY, up to JIT_HOT_VISITS
+		};
+
+		bool Heat(Entry& entry, uint16_t address)
+		{
+			if (entry.heat == 0) {
+				used.push_back(address);	//so Clear() cools it down again
+			}
+			if (entry.heat < JIT_HOT_VISITS) {
+				entry.heat++;
+			}
+			return entry.heat >= JIT_HOT_VISITS;
+		}
+
+		bool Map();
+		bool Compile(uint16_t address, uint8_t const* memory, Helpers const& helpers, Entry& entry);
+		size_t Translate(uint16_t address, uint8_t const* memory, Helpers const& helpers, uint8_t* out, uint8_t const* at,
+			uint16_t* starts, Entry& entry);
+
+		std::vector<Entry> entries;		//one per guest address, allocated on first Lookup.
+		std::vector<uint8_t> covered;	//per guest byte, nonzero once a block translated it. Lets writes to data skip the search.
+		std::vector<uint16_t> used;		//addresses reached since the last Clear(), the only entries it resets.
+		std::vector<void const*> targets;	//per guest address, where a block goes next: the code of a compiled entry, else the exit
+		uint8_t* code{};				//executable view of the buffer
+		uint8_t* writable{};			//the same memory, mapped again for writing
+		Enter enter{};					//at the start of code
+		size_t codeUsed{};
+};
+
+#endif
@@ -1,47 +1,382 @@
+#include "Audio.h"
+#include "Capture.h"
 #include "Chip8.h"
+#include "ExtendedChip8.h"
 #include "Graphics.h"
-#include <iostream>
+#include "InputLog.h"
+#include "Renderer.h"
+#include "Rewind.h"
+#include "RomLibrary.h"
+#include "Scheduler.h"
+#include "SdlAudio.h"
+#include "TripleBuffer.h"
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+const int IDLE_WAIT_MS = 1000;		//longest a blocked idle wait lasts before checking again
+const int FADE_WAIT_MS = 16;		//while phosphor fades, frames are presented even if none arrive
+
+//What the emulation thread publishes: a finished display, the classic one or the SUPER-CHIP/XO-CHIP planes.
+struct Frame
+{
+	uint64_t display[VIDEO_HEIGHT];
+	uint64_t planes[XoChip8::PLANES][HIRES_HEIGHT][HIRES_WORDS];
+};
+
+//Keys cross threads as one atomic word, bit n for key n, so the machine never sees half an update.
+static uint16_t KeyMask(uint8_t const* keys)
+{
+	uint16_t mask = 0;
+	for (unsigned int i = 0; i < KEY_COUNT; i++) {
+		mask |= (uint16_t)((keys[i] ? 1u : 0u) << i);
+	}
+	return mask;
+}
 
-//main calls Cycle() until exit.
+static void UnpackKeys(uint16_t mask, uint8_t* keys)
+{
+	for (unsigned int i = 0; i < KEY_COUNT; i++) {
+		keys[i] = (mask >> i) & 1u;
+	}
+}
+
+static void Usage(char const* name)
+{
+	std::cerr << "Usage: " << name << " <Scale> <InstructionsPerFrame> <ROM> [--seed n] [--record log | --replay log]"
+		<< " [--turbo] [--turbo-skip n] [--software nearest|scanline|phosphor]"
+		<< " [--capture file] [--mute] [--variant chip8|schip|xochip]\n";
+	std::exit(EXIT_FAILURE);
+}
+
+//main runs the emulator one 60hz frame at a time until exit, on a thread of its own; the main thread
+//handles SDL events and presents the frames it publishes.
 //ARG consists of:
-//	Video Scale (Chip8 is only 64x32)
-//	Delay/Refresh rate value for timers
+//	Video Scale (Chip8 is only 64x32, SUPER-CHIP and XO-CHIP hires get half a window pixel per pixel)
+//	Instructions per frame (CPU speed, 10 = 600 instructions per second)
 //	ROM file to load
+//	Optional --seed <n>, --record <log>, --replay <log> (see InputLog.h)
+//	Optional --turbo (start fast-forwarding, Tab toggles it) and --turbo-skip <n> (show every nth frame)
+//	Optional --software <nearest|scanline|phosphor>: scale on the CPU (Renderer.h) instead of the GPU
+//	Optional --capture <file.gif|.png|.y4m>: record every guest frame (see Capture.h)
+//	Optional --mute: no sound device, the beeper plays into nothing (see Audio.h)
+//	Optional --variant <chip8|schip|xochip>: machine to emulate, detected from the ROM by default (see ExtendedChip8.h)
 int main(int argc, char** argv)		
 {
-	if (argc != 4) {
-		std::cerr << "Usage: " << argv[0] << " <Scale> <Delay> <ROM>\n";
-		std::exit(EXIT_FAILURE);
+	if (argc < 4) {
+		Usage(argv[0]);
 	}
 
 	int videoScale = std::stoi(argv[1]);
-	int refreshCycle = std::stoi(argv[2]);
+	int perFrame = std::stoi(argv[2]);
 	char const* romName = argv[3];
-	
-	//Texture size should correspond to original video size
-	Graphics graphics("Chip-8 Emulator", VIDEO_WIDTH * videoScale, VIDEO_HEIGHT * videoScale, VIDEO_WIDTH, VIDEO_HEIGHT);
+
+	//Every session is deterministic: the seed is always explicit, so a recording can reproduce it.
+	uint32_t seed = (uint32_t)std::chrono::system_clock::now().time_since_epoch().count();
+	char const* recordName = nullptr;
+	char const* replayName = nullptr;
+	bool turbo = false;
+	unsigned int turboSkip = 0;
+	bool software = false;
+	char const* captureName = nullptr;
+	bool mute = false;
+	char const* variantName = nullptr;
+	Renderer::Filter filter = Renderer::Filter::Nearest;
+	for (int i = 4; i < argc; i++) {
+		bool hasValue = (i + 1 < argc);
+
+		if (std::strcmp(argv[i], "--turbo") == 0) {
+			turbo = true;
+		} else if (std::strcmp(argv[i], "--mute") == 0) {
+			mute = true;
+		} else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) {
+			seed = std::stoul(argv[++i]);
+		} else if (std::strcmp(argv[i], "--record") == 0 && hasValue) {
+			recordName = argv[++i];
+		} else if (std::strcmp(argv[i], "--replay") == 0 && hasValue) {
+			replayName = argv[++i];
+		} else if (std::strcmp(argv[i], "--turbo-skip") == 0 && hasValue) {
+			turboSkip = std::stoul(argv[++i]);
+		} else if (std::strcmp(argv[i], "--capture") == 0 && hasValue) {
+			captureName = argv[++i];
+		} else if (std::strcmp(argv[i], "--variant") == 0 && hasValue) {
+			variantName = argv[++i];
+		} else if (std::strcmp(argv[i], "--software") == 0 && hasValue) {
+			software = true;
+			if (!Renderer::FilterFromName(argv[++i], filter)) {
+				std::cerr << "Unknown filter " << argv[i] << "\n";
+				std::exit(EXIT_FAILURE);
+			}
+		} else {
+			std::cerr << "Unknown argument " << argv[i] << "\n";	//a typo, or an option missing its value
+			Usage(argv[0]);
+		}
+	}
+
+	InputLog log;
+	if (replayName) {
+		if (!log.Load(replayName)) {
+			std::cerr << "Could not read input log " << replayName << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+		seed = log.seed;
+		perFrame = log.instructionsPerFrame;
+	}
+	log.seed = seed;
+	log.instructionsPerFrame = perFrame;
+	log.romHash = InputLog::HashRom(romName);
+
+	//The machine is picked from the ROM's opcodes unless --variant says otherwise
+	RomProfile profile = RomProfile::Chip8;
+	if (variantName && !RomProfileFromName(variantName, profile)) {
+		std::cerr << "Unknown variant " << variantName << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+	if (!variantName) {
+		RomFile rom;
+		RomError error = rom.Open(romName, MAX_XO_ROM_SIZE);
+		if (error != RomError::None) {
+			std::cerr << "Could not load " << romName << ": " << RomErrorText(error) << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+		profile = DetectProfile(rom.Data(), rom.Size());
+	}
+	bool extended = (profile != RomProfile::Chip8);
+	if (extended && (software || captureName)) {
+		std::cerr << "--software and --capture need a chip8 ROM, " << romName << " is " << RomProfileName(profile) << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
 	Chip8 chip8;
-	chip8.LoadROM(romName);
+	std::unique_ptr<SuperChip8> superChip;
+	std::unique_ptr<XoChip8> xoChip;		//64 KB of memory, too big for the stack
+	auto load = [&](auto& machine) {
+		machine.Seed(seed);
+		return machine.LoadROM(romName);
+	};
+	RomError error;
+	if (profile == RomProfile::SuperChip) {
+		superChip = std::make_unique<SuperChip8>();
+		error = load(*superChip);
+	} else if (profile == RomProfile::XoChip) {
+		xoChip = std::make_unique<XoChip8>();
+		error = load(*xoChip);
+	} else {
+		error = load(chip8);
+	}
+	if (error != RomError::None) {
+		std::cerr << "Could not load " << romName << ": " << RomErrorText(error) << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	//Frames are dropped rather than slowing the session down if the encoder cannot keep up
+	Capture capture;
+	Capture::Format captureFormat;
+	if (captureName && (!Capture::FormatFromName(captureName, captureFormat) || !capture.Open(captureName, captureFormat))) {
+		std::cerr << "Could not open capture " << captureName << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	//Texture size should correspond to original video size, unless the CPU does the scaling
+	Renderer renderer(videoScale, filter);
+	std::unique_ptr<Graphics> graphics = software
+		? std::make_unique<Graphics>("Chip-8 Emulator", renderer)
+		: std::make_unique<Graphics>("Chip-8 Emulator", VIDEO_WIDTH * videoScale, VIDEO_HEIGHT * videoScale,
+			extended ? HIRES_WIDTH : VIDEO_WIDTH, extended ? HIRES_HEIGHT : VIDEO_HEIGHT);
+	Scheduler scheduler(perFrame);
+	Rewind rewind;
+
+	//Without a usable device the beeper still runs, into nothing, and the scheduler keeps its own clock.
+	//Declared after graphics so the device closes before SDL_Quit.
+	SdlAudio deviceAudio;
+	NullAudio noAudio;
+	bool sound = !mute && deviceAudio.Open();
+	if (!mute && !sound) {
+		std::cerr << "No audio device, running silent\n";
+	}
+	AudioSink& audio = sound ? (AudioSink&)deviceAudio : noAudio;
+	Beeper beeper(audio, sound ? deviceAudio.SampleRate() : DEFAULT_SAMPLE_RATE);
+
+	//Shared between the two threads. Everything else below belongs to exactly one of them.
+	TripleBuffer<Frame> frames;
+	std::atomic<uint16_t> keys{};			//KeyMask of what the player holds
+	std::atomic<bool> quit{};
+	std::atomic<bool> rewindHeld{};
+	std::atomic<bool> turboOn{ turbo };
+	std::mutex idleLock;
+	std::condition_variable idleWake;		//the emulation thread blocks on this while the ROM waits for a key
+
+	//Emulation thread: owns the machine, the scheduler, rewind, recording, capture and the beeper. It
+	//runs on the 60hz (or audio) clock and never waits for presentation, it only publishes frames.
+	//Written once for every machine; rewind and capture only exist for the classic one.
+	auto emulate = [&](auto& chip8) {
+		constexpr bool classic = std::is_same<std::decay_t<decltype(chip8)>, Chip8>::value;
+		uint64_t frame = 0;
+		uint16_t seenKeys = 0;				//what the machine was last given
+
+		//One frame of guest time, with everything that has to happen per guest frame.
+		auto runFrame = [&]() {
+			if (replayName) {
+				log.Replay(frame, chip8.input);
+			} else {
+				seenKeys = keys.load(std::memory_order_relaxed);
+				UnpackKeys(seenKeys, chip8.input);
+			}
+			if (recordName) {
+				log.Record(frame, chip8.input);
+			}
+
+			bool beeped = scheduler.RunFrame(chip8);
+			if (!scheduler.Turbo()) {
+				beeper.Frame(beeped);	//fast-forward is silent rather than a flood of samples
+			}
+			if constexpr (classic) {
+				rewind.Record(chip8);
+				capture.Submit(chip8.display);
+			}
+			frame++;
+		};
+
+		while (!quit.load()) {
+			if (turboOn.load() != scheduler.Turbo()) {
+				scheduler.SetTurbo(turboOn.load(), turboSkip);
+			}
 
-	int pitch = sizeof(chip8.display[0]) * VIDEO_WIDTH;			//getting video pitch for SDL texture function
-	auto previousCycleTime = std::chrono::high_resolution_clock::now();		//Used for delay timer
-	bool quit = false;
+			if (rewindHeld.load()) {
+				//Step back one frame per frame shown. The recording forgets the undone frames.
+				//Other machines keep no history, holding rewind only pauses them.
+				if constexpr (classic) {
+					if (rewind.StepBack(chip8)) {
+						frame--;
+						if (recordName) {
+							log.Truncate(frame);
+						}
+					}
+				}
+			} else if (scheduler.Turbo()) {
+				//Uncapped: guest frames back to back until the scheduler says to show one.
+				//Timers tick per guest frame, so the ROM sees ordinary time, just faster.
+				do {
+					runFrame();
+				} while (!scheduler.PresentDue());
+			} else {
+				runFrame();
+			}
 
-	while (!quit) {
-		quit = graphics.ProcessInput(chip8.input);
+			//A frame where nothing was drawn is not published, and wakes nobody.
+			if (chip8.TakeDirtyRows() != 0) {
+				if constexpr (classic) {
+					std::memcpy(frames.Back().display, chip8.display, sizeof(chip8.display));
+				} else {
+					std::memcpy(frames.Back().planes, chip8.display, sizeof(chip8.display));
+				}
+				frames.Publish();
+				Graphics::Wake();
+			}
 
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		//determine delay timer with current time minus last time Cycle() was called
-		float dt = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - previousCycleTime).count();
+			//A ROM waiting on a key with its timers stopped cannot change until one is pressed: sleep
+			//until the main thread reports a key change. Skipped frames are never counted, so
+			//recordings and replays still line up.
+			if (!replayName && !rewindHeld.load() && chip8.WaitingForInput()) {
+				std::unique_lock<std::mutex> hold(idleLock);
+				idleWake.wait_for(hold, std::chrono::milliseconds(IDLE_WAIT_MS), [&]() {
+					return quit.load() || rewindHeld.load() || keys.load() != seenKeys;
+				});
+				scheduler.Resync();
+			}
 
-		if (dt > refreshCycle) {
-			previousCycleTime = currentTime;
-			chip8.Cycle();
-			graphics.Update(chip8.display, pitch);
+			//Pace by the sound card: it drains the ring at its own clock, and the frame period bends
+			//(by at most 0.5%) to keep the ring near its target, so audio never runs dry or piles up.
+			scheduler.SetRateAdjust(beeper.RateAdjust());
+			scheduler.WaitForNextFrame();
 		}
+	};
+	std::thread emulation([&]() {
+		if (superChip) {
+			emulate(*superChip);
+		} else if (xoChip) {
+			emulate(*xoChip);
+		} else {
+			emulate(chip8);
+		}
+	});
+
+	//Main thread: SDL events and presentation only, so a slow present (vsync, compositor) can delay
+	//what is shown but never the guest's timing. It sleeps in SDL until an event or a new frame.
+	uint32_t pixels[VIDEO_WIDTH * VIDEO_HEIGHT]{};					//display expanded to RGBA for SDL
+	int pitch = sizeof(pixels[0]) * VIDEO_WIDTH;					//getting video pitch for SDL texture function
+	uint8_t liveKeys[KEY_COUNT]{};
+	uint64_t shown[VIDEO_HEIGHT]{};									//display as last presented
+	std::vector<uint32_t> hiresPixels(extended ? HIRES_WIDTH * HIRES_HEIGHT : 0);
+	uint32_t forceRows = ALL_ROWS;									//the window starts out undrawn
+	graphics->SetTurbo(turbo);
+
+	//Anything that can end the emulation thread's idle wait is stored before the lock is taken,
+	//so the wake-up cannot slip in between its check and its wait.
+	auto wakeEmulation = [&]() {
+		{ std::lock_guard<std::mutex> hold(idleLock); }
+		idleWake.notify_one();
+	};
+
+	while (!quit.load()) {
+		graphics->WaitForEvent(renderer.Fading() ? FADE_WAIT_MS : IDLE_WAIT_MS);
+		bool closing = graphics->ProcessInput(liveKeys);
+		uint16_t held = KeyMask(liveKeys);
+		if (closing || held != keys.load() || graphics->RewindHeld() != rewindHeld.load()) {
+			keys.store(held);
+			rewindHeld.store(graphics->RewindHeld());
+			quit.store(closing);
+			wakeEmulation();
+		}
+		turboOn.store(graphics->TurboOn());
+
+		//Frames skipped while presenting are simply never seen, so the rows to draw come from
+		//comparing with what is on screen rather than from the machine's dirty rows.
+		bool fresh = frames.Update();
+		if (!fresh && !renderer.Fading()) {
+			continue;
+		}
+		if (extended) {
+			//The planes carry no dirty rows, every new frame is a whole 128x64 upload
+			XoChip8::RenderDisplay(frames.Front().planes, hiresPixels.data());
+			graphics->Update(hiresPixels.data(), HIRES_WIDTH * sizeof(uint32_t));
+			continue;
+		}
+		uint64_t const* display = frames.Front().display;
+		uint32_t dirtyRows = forceRows;
+		for (unsigned int y = 0; y < VIDEO_HEIGHT; y++) {
+			if (display[y] != shown[y]) {
+				dirtyRows |= 1u << y;
+			}
+		}
+		std::memcpy(shown, display, sizeof(shown));
+		forceRows = 0;
+
+		if (software) {
+			graphics->Present(display, dirtyRows);
+		} else {
+			Chip8::RenderDisplay(display, pixels, dirtyRows);
+			graphics->Update(pixels, pitch, dirtyRows);
+		}
+	}
+	emulation.join();
+
+	if (recordName && !log.Save(recordName)) {
+		std::cerr << "Could not write input log " << recordName << "\n";
+	}
+	if (captureName && !capture.Close()) {
+		std::cerr << "Could not write capture " << captureName << "\n";
+	} else if (captureName && capture.Dropped() > 0) {
+		std::cerr << "Capture dropped " << capture.Dropped() << " frames\n";
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
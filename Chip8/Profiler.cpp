@@ -0,0 +1,106 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+//Same order as Chip8::Handler.
+static char const* const handlerNames[PROFILE_HANDLERS] = {
+	"DECODE", "OP_NULL", "OP_00E0", "OP_00EE", "OP_1nnn", "OP_2nnn", "OP_3xkk", "OP_4xkk", "OP_5xy0", "OP_6xkk", "OP_7xkk",
+	"OP_8xy0", "OP_8xy1", "OP_8xy2", "OP_8xy3", "OP_8xy4", "OP_8xy5", "OP_8xy6", "OP_8xy7", "OP_8xyE",
+	"OP_9xy0", "OP_Annn", "OP_Bnnn", "OP_Cxkk", "OP_Dxyn", "OP_Ex9E", "OP_ExA1",
+	"OP_Fx07", "OP_Fx0A", "OP_Fx15", "OP_Fx18", "OP_Fx1E", "OP_Fx29", "OP_Fx33", "OP_Fx55", "OP_Fx65"
+};
+
+const unsigned int HEATMAP_COLUMNS = 64;	//64 x 64 = MEMORY_SIZE
+const unsigned int HEATMAP_CELL = 8;
+
+void Profiler::Clear()
+{
+	instructions = 0;
+	keyWaitCycles = 0;
+	std::memset(handlerCounts, 0, sizeof(handlerCounts));
+	std::memset(addressHits, 0, sizeof(addressHits));
+}
+
+char const* Profiler::HandlerName(unsigned int handler)
+{
+	return handler < PROFILE_HANDLERS ? handlerNames[handler] : "?";
+}
+
+bool Profiler::WriteJson(char const* filename) const
+{
+	std::ofstream file(filename);
+	file << "{\n  \"instructions\": " << instructions << ",\n  \"keyWaitCycles\": " << keyWaitCycles
+		<< ",\n  \"handlers\": {";
+
+	char const* separator = "\n";
+	for (unsigned int h = 1; h < PROFILE_HANDLERS; h++) {
+		file << separator << "    \"" << handlerNames[h] << "\": " << handlerCounts[h];
+		separator = ",\n";
+	}
+
+	file << "\n  },\n  \"addresses\": {";
+	separator = "\n";
+	for (unsigned int a = 0; a < MEMORY_SIZE; a++) {
+		if (addressHits[a] != 0) {
+			file << separator << "    \"0x" << std::hex << std::uppercase << std::setw(3) << std::setfill('0') << a
+				<< std::dec << "\": " << addressHits[a];
+			separator = ",\n";
+		}
+	}
+	file << "\n  }\n}\n";
+	return file.good();
+}
+
+bool Profiler::WriteCsv(char const* filename) const
+{
+	std::ofstream file(filename);
+	file << "kind,name,count\n"
+		<< "total,instructions," << instructions << "\n"
+		<< "total,keyWaitCycles," << keyWaitCycles << "\n";
+
+	for (unsigned int h = 1; h < PROFILE_HANDLERS; h++) {
+		file << "handler," << handlerNames[h] << "," << handlerCounts[h] << "\n";
+	}
+	for (unsigned int a = 0; a < MEMORY_SIZE; a++) {
+		if (addressHits[a] != 0) {
+			file << "address,0x" << std::hex << std::uppercase << std::setw(3) << std::setfill('0') << a
+				<< std::dec << "," << addressHits[a] << "\n";
+		}
+	}
+	return file.good();
+}
+
+//Log scale, black (never run) through red and yellow to white (hottest address).
+bool Profiler::WriteHeatmap(char const* filename) const
+{
+	unsigned int const size = HEATMAP_COLUMNS * HEATMAP_CELL;
+	uint64_t hottest = *std::max_element(addressHits, addressHits + MEMORY_SIZE);
+	double scale = hottest > 0 ? 1.0 / std::log1p((double)hottest) : 0.0;
+
+	std::vector<uint8_t> pixels(size * size * 3);
+	for (unsigned int a = 0; a < MEMORY_SIZE; a++) {
+		double heat = std::log1p((double)addressHits[a]) * scale;		//0 - 1
+		uint8_t rgb[3] = {
+			(uint8_t)(255 * std::min(1.0, heat * 3.0)),
+			(uint8_t)(255 * std::min(1.0, std::max(0.0, heat * 3.0 - 1.0))),
+			(uint8_t)(255 * std::max(0.0, heat * 3.0 - 2.0)),
+		};
+
+		unsigned int left = (a % HEATMAP_COLUMNS) * HEATMAP_CELL;
+		unsigned int top = (a / HEATMAP_COLUMNS) * HEATMAP_CELL;
+		for (unsigned int y = top; y < top + HEATMAP_CELL; y++) {
+			for (unsigned int x = left; x < left + HEATMAP_CELL; x++) {
+				std::memcpy(&pixels[(y * size + x) * 3], rgb, 3);
+			}
+		}
+	}
+
+	std::ofstream file(filename, std::ios::binary);
+	file << "P6\n" << size << " " << size << "\n255\n";
+	file.write(reinterpret_cast<char const*>(pixels.data()), pixels.size());
+	return file.good();
+}
@@ -0,0 +1,42 @@
+//Execution profile of a Chip8: how often each instruction handler ran, how often each address
+//was executed, and how many instructions went to spinning in Fx0A waiting for a key.
+//
+//Only collected in builds with CHIP8_PROFILE defined (CMake option CHIP8_PROFILE). Without it
+//Chip8 has no profiler hook at all, so the cores pay nothing. With it, a machine that has a
+//profiler attached runs one instruction at a time through the switch core; all cores execute the
+//same instructions, so the counts do not depend on the core.
+
+#ifndef CHIP_8_PROFILER_H
+#define CHIP_8_PROFILER_H
+
+#include "Chip8.h"
+#include <cstdint>
+
+const unsigned int PROFILE_HANDLERS = 36;	//Chip8's decoded handler ids, H_DECODE to H_Fx65
+
+class Profiler
+{
+	public:
+		uint64_t instructions{};
+		uint64_t keyWaitCycles{};					//Fx0A executions that found no key pressed
+		uint64_t handlerCounts[PROFILE_HANDLERS]{};
+		uint64_t addressHits[MEMORY_SIZE]{};		//by the address of the opcode's first byte
+
+		void Clear();
+
+		void Record(uint16_t address, unsigned int handler, bool waitedForKey)
+		{
+			instructions++;
+			handlerCounts[handler]++;
+			addressHits[address]++;
+			keyWaitCycles += waitedForKey;
+		}
+
+		static char const* HandlerName(unsigned int handler);	//"OP_Dxyn" etc.
+
+		bool WriteJson(char const* filename) const;
+		bool WriteCsv(char const* filename) const;		//"kind,name,count" rows: summary, handler and address lines
+		bool WriteHeatmap(char const* filename) const;	//binary PPM, 64 x 64 cells of 8 x 8 pixels, one per address
+};
+
+#endif
@@ -0,0 +1,31 @@
+//Random byte source for Cxkk.
+//A single 32-bit xorshift word, so a snapshot can store it as plain data and every compiler
+//produces the same bytes for the same seed (std::default_random_engine differs between libraries).
+
+#ifndef CHIP_8_RANDOM_H
+#define CHIP_8_RANDOM_H
+
+#include <cstdint>
+
+struct Random
+{
+	uint32_t state{ 1 };	//never 0, xorshift would stay there
+
+	void Seed(uint32_t seed)
+	{
+		state = seed * 0x9E3779B9u + 0x7F4A7C15u;	//spread nearby seeds (1, 2, 3...) apart
+		if (state == 0) {
+			state = 1;
+		}
+	}
+
+	uint8_t NextByte()
+	{
+		state ^= state << 13u;
+		state ^= state >> 17u;
+		state ^= state << 5u;
+		return (uint8_t)(state >> 24u);
+	}
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "Renderer.h"
+#include <cstring>
+
+//Same arrangement as WideChip8: the AVX2 loop is compiled for that function alone and taken only
+//when the CPU has it. SSE2 is part of x86-64, so that path needs no check.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(CHIP8_NO_AVX2)
+#define CHIP8_RENDER_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#define CHIP8_RENDER_SSE2
+#endif
+#if defined(CHIP8_RENDER_AVX2) || defined(CHIP8_RENDER_SSE2)
+#include <immintrin.h>
+#endif
+
+const uint32_t DEFAULT_ON = 0xFFFFFFFFu;
+const uint32_t DEFAULT_OFF = 0xFF000000u;
+const unsigned int PHOSPHOR_DECAY = 160;	//brightness kept per frame, out of 256: gone after about 11 frames
+
+Renderer::Renderer(unsigned int scale, Filter filter)
+	: scale(scale > 0 ? scale : 1), filter(filter)
+{
+	dimRows = (filter == Filter::Scanline && this->scale > 1) ? (this->scale + 2) / 3 : 0;
+	SetColors(DEFAULT_ON, DEFAULT_OFF);
+
+#ifdef CHIP8_RENDER_AVX2
+	avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool Renderer::FilterFromName(char const* name, Filter& found)
+{
+	static struct { char const* name; Filter filter; } const names[] = {
+		{ "nearest", Filter::Nearest },
+		{ "scanline", Filter::Scanline },
+		{ "phosphor", Filter::Phosphor },
+	};
+
+	for (auto const& entry : names) {
+		if (std::strcmp(name, entry.name) == 0) {
+			found = entry.filter;
+			return true;
+		}
+	}
+	return false;
+}
+
+void Renderer::SetColors(uint32_t on, uint32_t off)
+{
+	for (unsigned int level = 0; level < 256; level++) {
+		uint32_t color = 0;
+		uint32_t dim = 0;
+		for (unsigned int shift = 0; shift < 32; shift += 8) {
+			int from = (off >> shift) & 0xFFu;
+			int to = (on >> shift) & 0xFFu;
+			uint32_t channel = (uint32_t)(from + (to - from) * (int)level / 255);
+			color |= channel << shift;
+			dim |= (shift == 24 ? channel : channel / 2) << shift;		//alpha stays
+		}
+		palette[level] = color;
+		dimPalette[level] = dim;
+	}
+}
+
+uint32_t Renderer::Advance(uint64_t const* display, uint32_t dirtyRows)
+{
+	if (filter != Filter::Phosphor) {
+		return dirtyRows;
+	}
+
+	uint32_t changed = dirtyRows | fading;
+	fading = 0;
+	for (unsigned int y = 0; y < VIDEO_HEIGHT; y++) {
+		if (!(changed & (1u << y))) {
+			continue;
+		}
+
+		uint64_t row = display[y];
+		bool stillFading = false;
+		for (unsigned int x = 0; x < VIDEO_WIDTH; x++) {
+			uint8_t& level = levels[y][x];
+			level = ((row >> (VIDEO_WIDTH - 1u - x)) & 1u) ? 255 : (uint8_t)((level * PHOSPHOR_DECAY) >> 8u);
+			stillFading |= (level != 0 && level != 255);
+		}
+		if (stillFading) {
+			fading |= 1u << y;
+		}
+	}
+	return changed;
+}
+
+#ifdef CHIP8_RENDER_AVX2
+//Each source pixel becomes `scale` copies. Stores are 8 wide; the last one of a pixel is moved back
+//to end exactly at the pixel's edge, overlapping the previous store instead of running past the row.
+__attribute__((target("avx2")))
+static void ExpandAvx2(uint32_t const* colors, uint32_t* out, unsigned int scale)
+{
+	for (unsigned int x = 0; x < VIDEO_WIDTH; x++, out += scale) {
+		__m256i color = _mm256_set1_epi32((int)colors[x]);
+		for (unsigned int i = 0; i + 8 < scale; i += 8) {
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), color);
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + scale - 8), color);
+	}
+}
+#endif
+
+#ifdef CHIP8_RENDER_SSE2
+static void ExpandSse2(uint32_t const* colors, uint32_t* out, unsigned int scale)
+{
+	for (unsigned int x = 0; x < VIDEO_WIDTH; x++, out += scale) {
+		__m128i color = _mm_set1_epi32((int)colors[x]);
+		for (unsigned int i = 0; i + 4 < scale; i += 4) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), color);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + scale - 4), color);
+	}
+}
+#endif
+
+void Renderer::ExpandRow(uint32_t const* colors, uint32_t* out) const
+{
+#ifdef CHIP8_RENDER_AVX2
+	if (avx2 && scale >= 8) {
+		ExpandAvx2(colors, out, scale);
+		return;
+	}
+#endif
+#ifdef CHIP8_RENDER_SSE2
+	if (scale >= 4) {
+		ExpandSse2(colors, out, scale);
+		return;
+	}
+#endif
+	for (unsigned int x = 0; x < VIDEO_WIDTH; x++) {
+		for (unsigned int i = 0; i < scale; i++) {
+			*out++ = colors[x];
+		}
+	}
+}
+
+//One expanded row per display row (two with scanlines), the other rows of the pixel are copies of it.
+void Renderer::Render(uint64_t const* display, unsigned int first, unsigned int last, void* target, size_t pitch) const
+{
+	size_t const rowBytes = Width() * sizeof(uint32_t);
+	uint8_t* out = static_cast<uint8_t*>(target);
+	uint32_t colors[VIDEO_WIDTH];
+
+	for (unsigned int y = first; y <= last && y < VIDEO_HEIGHT; y++) {
+		for (uint32_t const* shades : { palette, dimPalette }) {
+			unsigned int rows = (shades == palette) ? scale - dimRows : dimRows;
+			if (rows == 0) {
+				continue;
+			}
+
+			if (filter == Filter::Phosphor) {
+				for (unsigned int x = 0; x < VIDEO_WIDTH; x++) {
+					colors[x] = shades[levels[y][x]];
+				}
+			} else {
+				uint64_t row = display[y];
+				for (unsigned int x = 0; x < VIDEO_WIDTH; x++) {
+					colors[x] = shades[((row >> (VIDEO_WIDTH - 1u - x)) & 1u) * 255u];
+				}
+			}
+
+			uint8_t* firstRow = out;
+			ExpandRow(colors, reinterpret_cast<uint32_t*>(firstRow));
+			out += pitch;
+			for (unsigned int r = 1; r < rows; r++, out += pitch) {
+				std::memcpy(out, firstRow, rowBytes);
+			}
+		}
+	}
+}
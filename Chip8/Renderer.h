@@ -0,0 +1,55 @@
+//CPU-side presentation: expands the 1-bit display into a scaled 32-bit image, optionally with
+//scanlines or phosphor persistence, straight into the caller's buffer (an SDL_LockTexture
+//pointer in Graphics, a plain vector in the benchmark). Needs no GPU and no SDL.
+//
+//Pixels are 0xAARRGGBB words (SDL_PIXELFORMAT_ARGB8888).
+
+#ifndef CHIP_8_RENDERER_H
+#define CHIP_8_RENDERER_H
+
+#include "Chip8.h"
+#include <cstddef>
+#include <cstdint>
+
+class Renderer
+{
+	public:
+		enum class Filter
+		{
+			Nearest,	//plain integer scaling
+			Scanline,	//the bottom third of every pixel row at half brightness
+			Phosphor,	//pixels that turn off fade out over a few frames instead of vanishing
+		};
+
+		explicit Renderer(unsigned int scale, Filter filter = Filter::Nearest);
+
+		static bool FilterFromName(char const* name, Filter& found);	//"nearest", "scanline" or "phosphor"
+
+		void SetColors(uint32_t on, uint32_t off);
+		unsigned int Width() const { return VIDEO_WIDTH * scale; }
+		unsigned int Height() const { return VIDEO_HEIGHT * scale; }
+
+		//Once per presented frame. Takes the rows the machine changed (Chip8::TakeDirtyRows) and
+		//returns the rows that have to be drawn, which with Phosphor includes rows still fading.
+		uint32_t Advance(uint64_t const* display, uint32_t dirtyRows);
+
+		bool Fading() const { return fading != 0; }		//Phosphor: later frames still change even if the display does not
+
+		//Draws display rows first..last. `target` is where row `first` starts, `pitch` is in bytes.
+		//Every pixel of those rows is written, so locked texture memory needs no clearing.
+		void Render(uint64_t const* display, unsigned int first, unsigned int last, void* target, size_t pitch) const;
+
+	private:
+		void ExpandRow(uint32_t const* colors, uint32_t* out) const;
+
+		unsigned int scale;
+		unsigned int dimRows;					//Scanline: rows per pixel row drawn with the dim palette
+		Filter filter;
+		uint32_t palette[256]{};				//by brightness, 0 = off colour, 255 = on colour
+		uint32_t dimPalette[256]{};
+		uint8_t levels[VIDEO_HEIGHT][VIDEO_WIDTH]{};	//Phosphor: brightness left in each pixel
+		uint32_t fading{};						//Phosphor: rows with a pixel between off and on
+		bool avx2{};
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "Rewind.h"
+#include <cstring>
+
+//Delta record: runs of [uint16 unchanged bytes][uint16 changed bytes][changed bytes XOR'd],
+//until the end of the snapshot. Unchanged gaps shorter than a run header are folded into the changed bytes.
+const size_t RUN_HEADER = 4;
+const size_t SNAPSHOT_BYTES = sizeof(Snapshot);
+
+Rewind::Rewind(size_t bytes, size_t frames)
+	: buffer(bytes), entries(frames > 0 ? frames : 1),
+	  scratch(SNAPSHOT_BYTES + (SNAPSHOT_BYTES / (RUN_HEADER + 1) + 1) * RUN_HEADER)	//worst case: every run as short as possible
+{
+}
+
+void Rewind::Clear()
+{
+	first = 0;
+	count = 0;
+	writeOffset = 0;
+	used = 0;
+	hasHead = false;
+}
+
+//Number of leading bytes at `i` where a and b agree. Compares a word at a time.
+static size_t SameRun(uint8_t const* a, uint8_t const* b, size_t i, size_t end)
+{
+	size_t start = i;
+	while (i + 8 <= end) {
+		uint64_t x, y;
+		std::memcpy(&x, a + i, 8);
+		std::memcpy(&y, b + i, 8);
+		if (x != y) {
+			break;
+		}
+		i += 8;
+	}
+	while (i < end && a[i] == b[i]) {
+		i++;
+	}
+	return i - start;
+}
+
+size_t Rewind::Encode(Snapshot const& older, Snapshot const& newer)
+{
+	uint8_t const* a = reinterpret_cast<uint8_t const*>(&older);
+	uint8_t const* b = reinterpret_cast<uint8_t const*>(&newer);
+	uint8_t* out = scratch.data();
+	size_t size = 0;
+	size_t i = 0;
+
+	while (i < SNAPSHOT_BYTES) {
+		size_t same = SameRun(a, b, i, SNAPSHOT_BYTES);
+		i += same;
+		if (i == SNAPSHOT_BYTES) {
+			break;		//trailing unchanged bytes need no record
+		}
+
+		size_t start = i;
+		size_t end = i;
+		while (end < SNAPSHOT_BYTES) {
+			if (a[end] != b[end]) {
+				end++;
+				continue;
+			}
+			size_t gap = SameRun(a, b, end, SNAPSHOT_BYTES);
+			if (gap > RUN_HEADER || end + gap == SNAPSHOT_BYTES) {
+				break;
+			}
+			end += gap;
+		}
+
+		uint16_t header[2] = { (uint16_t)same, (uint16_t)(end - start) };
+		std::memcpy(out + size, header, RUN_HEADER);
+		size += RUN_HEADER;
+		for (size_t k = start; k < end; k++) {
+			out[size++] = a[k] ^ b[k];
+		}
+		i = end;
+	}
+
+	return size;
+}
+
+void Rewind::Apply(uint8_t const* delta, size_t size, Snapshot& snapshot)
+{
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(&snapshot);
+	size_t i = 0;
+
+	for (size_t read = 0; read < size;) {
+		uint16_t header[2];
+		std::memcpy(header, delta + read, RUN_HEADER);
+		read += RUN_HEADER;
+		i += header[0];
+
+		for (size_t k = 0; k < header[1]; k++) {
+			bytes[i++] ^= delta[read++];
+		}
+	}
+}
+
+void Rewind::DropOldest()
+{
+	used -= entries[first].size;
+	first = (first + 1) % entries.size();
+	count--;
+}
+
+void Rewind::Record(Chip8 const& chip8)
+{
+	chip8.SaveState(current);
+	if (!hasHead) {
+		head = current;
+		hasHead = true;
+		return;
+	}
+
+	size_t size = Encode(head, current);
+	head = current;
+	if (size > buffer.size()) {
+		Clear();		//a ring this small cannot hold even one frame
+		return;
+	}
+
+	//Records are a FIFO of bytes around the ring, so making room is just dropping the oldest.
+	while (count > 0 && (used + size > buffer.size() || count == entries.size())) {
+		DropOldest();
+	}
+
+	size_t split = buffer.size() - writeOffset;
+	if (size <= split) {
+		std::memcpy(&buffer[writeOffset], scratch.data(), size);
+	} else {
+		std::memcpy(&buffer[writeOffset], scratch.data(), split);
+		std::memcpy(&buffer[0], scratch.data() + split, size - split);
+	}
+
+	entries[(first + count) % entries.size()] = Entry{ (uint32_t)writeOffset, (uint32_t)size };
+	count++;
+	used += size;
+	writeOffset = (writeOffset + size) % buffer.size();
+}
+
+bool Rewind::StepBack(Chip8& chip8)
+{
+	if (count == 0) {
+		return false;
+	}
+
+	count--;
+	Entry const& newest = entries[(first + count) % entries.size()];
+	uint8_t const* delta = &buffer[newest.offset];
+
+	size_t split = buffer.size() - newest.offset;
+	if (newest.size > split) {		//record wraps around the end, gather it first
+		std::memcpy(scratch.data(), delta, split);
+		std::memcpy(scratch.data() + split, &buffer[0], newest.size - split);
+		delta = scratch.data();
+	}
+
+	Apply(delta, newest.size, head);
+	writeOffset = newest.offset;	//the space is free again
+	used -= newest.size;
+
+	return chip8.LoadState(head);
+}
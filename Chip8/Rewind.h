@@ -0,0 +1,55 @@
+//Rewind history for the front-end.
+//Record() is called once per frame. It stores the XOR of the new snapshot against the previous one,
+//run-length encoded, in a fixed-size ring buffer; most frames only touch a few registers and display
+//rows, so a frame usually costs tens of bytes. StepBack() XORs the newest delta back out of the
+//current snapshot, so going back one frame costs the same however long the history is.
+//When the ring is full the oldest frames are dropped.
+
+#ifndef CHIP_8_REWIND_H
+#define CHIP_8_REWIND_H
+
+#include "Snapshot.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+const size_t DEFAULT_REWIND_BYTES = 4 * 1024 * 1024;
+const size_t DEFAULT_REWIND_FRAMES = 60 * 60 * 20;	//20 minutes at 60hz, if the bytes last that long
+
+class Rewind
+{
+	public:
+		explicit Rewind(size_t bytes = DEFAULT_REWIND_BYTES, size_t frames = DEFAULT_REWIND_FRAMES);
+
+		void Record(Chip8 const& chip8);
+		bool StepBack(Chip8& chip8);	//restores the previous recorded frame, false if there is none
+		void Clear();					//call when the machine is reset or loaded from elsewhere
+
+		size_t Frames() const { return count; }		//how many frames StepBack can go
+		size_t BytesUsed() const { return used; }
+
+	private:
+		struct Entry
+		{
+			uint32_t offset;	//into buffer
+			uint32_t size;
+		};
+
+		size_t Encode(Snapshot const& older, Snapshot const& newer);	//into scratch, returns its size
+		static void Apply(uint8_t const* delta, size_t size, Snapshot& snapshot);
+		void DropOldest();
+
+		std::vector<uint8_t> buffer;	//delta records, written in order and wrapping to the start
+		std::vector<Entry> entries;		//ring of records, oldest at `first`
+		size_t first{};
+		size_t count{};
+		size_t writeOffset{};
+		size_t used{};
+
+		Snapshot head{};				//last recorded (or restored) state, what the newest delta applies to
+		Snapshot current{};
+		bool hasHead{};
+		std::vector<uint8_t> scratch;
+};
+
+#endif
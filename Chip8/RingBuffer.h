@@ -0,0 +1,68 @@
+//Single-producer, single-consumer ring buffer. Lock-free: each side only writes its own index,
+//so the emulation thread can feed an audio callback without either one ever waiting.
+
+#ifndef CHIP_8_RING_BUFFER_H
+#define CHIP_8_RING_BUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+template <typename T>
+class RingBuffer
+{
+	public:
+		explicit RingBuffer(size_t minimumCapacity)
+		{
+			size_t capacity = 1;
+			while (capacity < minimumCapacity) {
+				capacity <<= 1u;
+			}
+			buffer.resize(capacity);
+			mask = capacity - 1;
+		}
+
+		//Producer only. Returns how many items fit, the rest are not written.
+		size_t Push(T const* items, size_t count)
+		{
+			size_t writeAt = head.load(std::memory_order_relaxed);
+			size_t readAt = tail.load(std::memory_order_acquire);
+			count = std::min(count, buffer.size() - (writeAt - readAt));
+
+			for (size_t i = 0; i < count; i++) {
+				buffer[(writeAt + i) & mask] = items[i];
+			}
+			head.store(writeAt + count, std::memory_order_release);
+			return count;
+		}
+
+		//Consumer only. Returns how many items were read.
+		size_t Pop(T* items, size_t count)
+		{
+			size_t readAt = tail.load(std::memory_order_relaxed);
+			size_t writeAt = head.load(std::memory_order_acquire);
+			count = std::min(count, writeAt - readAt);
+
+			for (size_t i = 0; i < count; i++) {
+				items[i] = buffer[(readAt + i) & mask];
+			}
+			tail.store(readAt + count, std::memory_order_release);
+			return count;
+		}
+
+		size_t Size() const		//either side, exact only from the consumer's or producer's own point of view
+		{
+			return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+		}
+
+		size_t Capacity() const { return buffer.size(); }
+
+	private:
+		std::vector<T> buffer;
+		size_t mask{};
+		alignas(64) std::atomic<size_t> head{};		//next write, only the producer stores it
+		alignas(64) std::atomic<size_t> tail{};		//next read, only the consumer stores it
+};
+
+#endif
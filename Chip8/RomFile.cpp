@@ -0,0 +1,136 @@
+#include "RomFile.h"
+#include "Chip8.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(MAX_ROM_SIZE == MEMORY_SIZE - START_ADDRESS, "RomFile.h and Chip8.h disagree on the memory size");
+
+char const* RomErrorText(RomError error)
+{
+	switch (error)
+	{
+		case RomError::None: return "ok";
+		case RomError::NotFound: return "file not found or not readable";
+		case RomError::Empty: return "file is empty";
+		case RomError::TooLarge: return "file does not fit in the machine's memory above 0x200";
+		case RomError::MapFailed: return "file could not be mapped";
+	}
+	return "unknown error";
+}
+
+RomFile::~RomFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+RomError RomFile::Open(char const* filename, size_t maxSize)
+{
+	Close();
+
+	HANDLE handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return RomError::NotFound;
+	}
+	file = handle;
+
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(handle, &length)) {
+		Close();
+		return RomError::NotFound;
+	}
+	if (length.QuadPart == 0) {
+		Close();
+		return RomError::Empty;
+	}
+	if ((unsigned long long)length.QuadPart > maxSize) {
+		Close();
+		return RomError::TooLarge;
+	}
+
+	mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view) {
+		Close();
+		return RomError::MapFailed;
+	}
+
+	data = static_cast<uint8_t const*>(view);
+	size = (size_t)length.QuadPart;
+	return RomError::None;
+}
+
+void RomFile::Close()
+{
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+	if (mapping) {
+		CloseHandle(mapping);
+	}
+	if (file) {
+		CloseHandle(file);
+	}
+	data = nullptr;
+	size = 0;
+	mapping = nullptr;
+	file = nullptr;
+}
+
+#else
+
+//The descriptor is closed straight away, the mapping keeps the file contents alive on its own.
+RomError RomFile::Open(char const* filename, size_t maxSize)
+{
+	Close();
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return RomError::NotFound;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+		close(fd);
+		return RomError::NotFound;
+	}
+	if (info.st_size == 0) {
+		close(fd);
+		return RomError::Empty;
+	}
+	if ((unsigned long long)info.st_size > maxSize) {
+		close(fd);
+		return RomError::TooLarge;
+	}
+
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED) {
+		return RomError::MapFailed;
+	}
+
+	data = static_cast<uint8_t const*>(view);
+	size = (size_t)info.st_size;
+	return RomError::None;
+}
+
+void RomFile::Close()
+{
+	if (data) {
+		munmap(const_cast<uint8_t*>(data), size);
+	}
+	data = nullptr;
+	size = 0;
+}
+
+#endif
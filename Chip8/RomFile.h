@@ -0,0 +1,47 @@
+//Read-only, memory-mapped ROM file. Opening validates it (exists, not empty, fits in memory
+//above START_ADDRESS) and reports why it could not be used instead of silently loading nothing.
+
+#ifndef CHIP_8_ROM_FILE_H
+#define CHIP_8_ROM_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum class RomError
+{
+	None,
+	NotFound,		//missing or not readable
+	Empty,
+	TooLarge,		//more than the machine has above START_ADDRESS
+	MapFailed,
+};
+
+const size_t MAX_ROM_SIZE = 0x1000 - 0x200;			//MEMORY_SIZE - START_ADDRESS of the classic machine
+const size_t MAX_XO_ROM_SIZE = 0x10000 - 0x200;		//XO-CHIP's 64 KB, the largest of any variant
+
+char const* RomErrorText(RomError error);
+
+class RomFile
+{
+	public:
+		RomFile() = default;
+		RomFile(RomFile const&) = delete;
+		RomFile& operator=(RomFile const&) = delete;
+		~RomFile();
+
+		RomError Open(char const* filename, size_t maxSize = MAX_ROM_SIZE);	//closes any previous file first
+		void Close();
+
+		uint8_t const* Data() const { return data; }
+		size_t Size() const { return size; }
+
+	private:
+		uint8_t const* data{};
+		size_t size{};
+#ifdef _WIN32
+		void* file{};		//HANDLE
+		void* mapping{};	//HANDLE
+#endif
+};
+
+#endif
@@ -0,0 +1,308 @@
+#include "RomLibrary.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+char const* RomProfileName(RomProfile profile)
+{
+	switch (profile)
+	{
+		case RomProfile::Chip8: return "chip8";
+		case RomProfile::SuperChip: return "schip";
+		case RomProfile::XoChip: return "xochip";
+	}
+	return "chip8";
+}
+
+bool RomProfileFromName(char const* name, RomProfile& profile)
+{
+	for (RomProfile p : { RomProfile::Chip8, RomProfile::SuperChip, RomProfile::XoChip }) {
+		if (std::strcmp(name, RomProfileName(p)) == 0) {
+			profile = p;
+			return true;
+		}
+	}
+	return false;
+}
+
+//Looks at every aligned word, code or not, so a single match could be sprite data.
+//It takes two hits before a ROM counts as written for a later platform.
+RomProfile DetectProfile(uint8_t const* data, size_t size)
+{
+	if (size > MAX_ROM_SIZE) {
+		return RomProfile::XoChip;		//only XO-CHIP has the memory for it
+	}
+
+	unsigned int superChip = 0;
+	unsigned int xoChip = 0;
+
+	for (size_t i = 0; i + 1 < size; i += 2) {
+		uint16_t opcode = (uint16_t)((data[i] << 8u) | data[i + 1]);
+		uint16_t low = opcode & 0x00FFu;
+
+		switch (opcode >> 12u)
+		{
+			case 0x0:
+				if (opcode == 0x00FE || opcode == 0x00FF) {		//lores / hires: practically never data
+					superChip += 2;
+				} else if (opcode == 0x00FB || opcode == 0x00FC || opcode == 0x00FD || (opcode & 0xFFF0u) == 0x00C0) {
+					superChip++;
+				} else if ((opcode & 0xFFF0u) == 0x00D0) {		//scroll up
+					xoChip++;
+				}
+				break;
+			case 0x5:
+				if ((opcode & 0xFu) == 0x2 || (opcode & 0xFu) == 0x3) {	//save / load vx - vy
+					xoChip++;
+				}
+				break;
+			case 0xF:
+				if (opcode == 0xF000 || opcode == 0xF002 || low == 0x3A || (low == 0x01 && (opcode & 0x0F00u) <= 0x0300)) {
+					xoChip++;
+				} else if (low == 0x30 || low == 0x75 || low == 0x85) {
+					superChip++;
+				}
+				break;
+		}
+	}
+
+	if (xoChip >= 2) {
+		return RomProfile::XoChip;
+	}
+	return superChip >= 2 ? RomProfile::SuperChip : RomProfile::Chip8;
+}
+
+//XXH64, as specified by the reference xxHash implementation. Reads are little endian.
+const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t Rotl(uint64_t x, unsigned int r)
+{
+	return (x << r) | (x >> (64u - r));
+}
+
+static inline uint64_t Read64(uint8_t const* p)
+{
+	uint64_t value;
+	std::memcpy(&value, p, 8);
+	return value;
+}
+
+static inline uint32_t Read32(uint8_t const* p)
+{
+	uint32_t value;
+	std::memcpy(&value, p, 4);
+	return value;
+}
+
+static inline uint64_t Round(uint64_t acc, uint64_t input)
+{
+	acc += input * PRIME64_2;
+	return Rotl(acc, 31) * PRIME64_1;
+}
+
+static inline uint64_t Merge(uint64_t acc, uint64_t value)
+{
+	acc ^= Round(0, value);
+	return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t Xxh64(void const* data, size_t size, uint64_t seed)
+{
+	uint8_t const* p = static_cast<uint8_t const*>(data);
+	uint8_t const* end = p + size;
+	uint64_t hash;
+
+	if (size >= 32) {
+		uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+		uint64_t v2 = seed + PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME64_1;
+		for (; p + 32 <= end; p += 32) {
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+		}
+		hash = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+		hash = Merge(hash, v1);
+		hash = Merge(hash, v2);
+		hash = Merge(hash, v3);
+		hash = Merge(hash, v4);
+	} else {
+		hash = seed + PRIME64_5;
+	}
+	hash += size;
+
+	for (; p + 8 <= end; p += 8) {
+		hash ^= Round(0, Read64(p));
+		hash = Rotl(hash, 27) * PRIME64_1 + PRIME64_4;
+	}
+	if (p + 4 <= end) {
+		hash ^= Read32(p) * PRIME64_1;
+		hash = Rotl(hash, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		hash ^= *p * PRIME64_5;
+		hash = Rotl(hash, 11) * PRIME64_1;
+	}
+
+	hash ^= hash >> 33u;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29u;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32u;
+	return hash;
+}
+
+//Only a changed size or timestamp makes it open the file again.
+RomInfo const* RomLibrary::Add(std::string const& path, RomError& error)
+{
+	std::error_code ec;
+	uint64_t size = fs::file_size(path, ec);
+	if (ec) {
+		error = RomError::NotFound;
+		return nullptr;
+	}
+	int64_t modified = (int64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+
+	auto known = byPath.find(path);
+	if (known != byPath.end() && !ec) {
+		RomInfo const& rom = roms[known->second];
+		if (rom.size == size && rom.modified == modified) {
+			error = RomError::None;
+			return &rom;
+		}
+	}
+
+	RomFile file;
+	error = file.Open(path.c_str(), MAX_XO_ROM_SIZE);	//indexed whatever variant it needs
+	if (error != RomError::None) {
+		return nullptr;
+	}
+	filesRead++;
+
+	RomInfo info{ path, file.Size(), modified, Xxh64(file.Data(), file.Size()), DetectProfile(file.Data(), file.Size()) };
+	if (known != byPath.end()) {
+		roms[known->second] = info;
+		return &roms[known->second];
+	}
+	byPath.emplace(path, roms.size());
+	roms.push_back(info);
+	return &roms.back();
+}
+
+static bool IsRomName(fs::path const& path)
+{
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	return extension == ".ch8" || extension == ".c8" || extension == ".sc8" || extension == ".xo8";
+}
+
+size_t RomLibrary::Scan(std::string const& directory, std::vector<RomInfo>& found)
+{
+	std::vector<std::string> paths;
+	std::error_code ec;
+	for (fs::recursive_directory_iterator it(directory, fs::directory_options::skip_permission_denied, ec), end;
+		!ec && it != end; it.increment(ec)) {
+		if (it->is_regular_file(ec) && IsRomName(it->path())) {
+			paths.push_back(it->path().generic_string());
+		}
+	}
+	std::sort(paths.begin(), paths.end());		//same order on every run and platform
+
+	size_t rejected = 0;
+	for (std::string const& path : paths) {
+		RomError error;
+		RomInfo const* rom = Add(path, error);
+		if (rom) {
+			found.push_back(*rom);
+		} else {
+			rejected++;
+		}
+	}
+	return rejected;
+}
+
+bool RomLibrary::LoadIndex(char const* filename)
+{
+	std::ifstream file(filename);
+	std::string line;
+	std::string magic;
+	unsigned int version = 0;
+	if (!std::getline(file, line) || !(std::istringstream(line) >> magic >> version)
+		|| magic != "chip8-rom-index" || version != ROM_INDEX_VERSION) {
+		return false;
+	}
+
+	std::vector<RomInfo> loaded;
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		RomInfo info;
+		std::string profile;
+		if (!(fields >> std::hex >> info.hash >> std::dec >> info.size >> info.modified >> profile)
+			|| !RomProfileFromName(profile.c_str(), info.profile) || fields.get() != '\t' || !std::getline(fields, info.path)) {
+			return false;
+		}
+		loaded.push_back(info);
+	}
+
+	for (RomInfo const& info : loaded) {
+		auto known = byPath.find(info.path);
+		if (known != byPath.end()) {
+			roms[known->second] = info;
+		} else {
+			byPath.emplace(info.path, roms.size());
+			roms.push_back(info);
+		}
+	}
+	return true;
+}
+
+bool RomLibrary::SaveIndex(char const* filename) const
+{
+	std::ofstream file(filename);
+	file << "chip8-rom-index " << ROM_INDEX_VERSION << "\n";
+	for (RomInfo const& rom : roms) {
+		file << std::hex << rom.hash << std::dec << '\t' << rom.size << '\t' << rom.modified << '\t'
+			<< RomProfileName(rom.profile) << '\t' << rom.path << "\n";
+	}
+	return file.good();
+}
+
+RomInfo const* RomLibrary::Find(uint64_t hash) const
+{
+	for (RomInfo const& rom : roms) {
+		if (rom.hash == hash) {
+			return &rom;
+		}
+	}
+	return nullptr;
+}
+
+std::shared_ptr<std::vector<uint8_t> const> RomLibrary::Image(RomInfo const& rom)
+{
+	std::lock_guard<std::mutex> lock(imageLock);
+	auto cached = images.find(rom.hash);
+	if (cached != images.end()) {
+		return cached->second;
+	}
+
+	RomFile file;
+	if (file.Open(rom.path.c_str(), MAX_XO_ROM_SIZE) != RomError::None || file.Size() != rom.size
+		|| Xxh64(file.Data(), file.Size()) != rom.hash) {
+		return nullptr;
+	}
+	auto image = std::make_shared<std::vector<uint8_t> const>(file.Data(), file.Data() + file.Size());
+	images.emplace(rom.hash, image);
+	return image;
+}
@@ -0,0 +1,76 @@
+//ROM collection for batch and fleet runs. Every ROM is identified by its content hash (XXH64),
+//so copies under different names share one image, and its metadata (size, hash, detected
+//quirk profile) is kept in an on-disk index. A rescan only opens files whose size or
+//modification time changed since the index was written.
+//
+//Index file: a "chip8-rom-index <version>" line, then one ROM per line:
+//"<hash hex>\t<size>\t<mtime>\t<profile>\t<path>".
+
+#ifndef CHIP_8_ROM_LIBRARY_H
+#define CHIP_8_ROM_LIBRARY_H
+
+#include "RomFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const unsigned int ROM_INDEX_VERSION = 1;
+
+//Platform a ROM was written for, guessed from opcodes only the later platforms have.
+enum class RomProfile : uint8_t
+{
+	Chip8,
+	SuperChip,
+	XoChip,
+};
+
+char const* RomProfileName(RomProfile profile);
+RomProfile DetectProfile(uint8_t const* data, size_t size);
+bool RomProfileFromName(char const* name, RomProfile& profile);	//"chip8", "schip" or "xochip"
+
+uint64_t Xxh64(void const* data, size_t size, uint64_t seed = 0);
+
+struct RomInfo
+{
+	std::string path;
+	uint64_t size{};
+	int64_t modified{};		//filesystem timestamp, only compared for equality
+	uint64_t hash{};		//Xxh64 of the contents
+	RomProfile profile{};
+};
+
+class RomLibrary
+{
+	public:
+		//Adds one ROM (or refreshes it if its size or timestamp changed). Null with `error` set if it is unusable.
+		//The pointer stays valid until the next Add, Scan or LoadIndex.
+		RomInfo const* Add(std::string const& path, RomError& error);
+
+		//Adds every *.ch8, *.c8, *.sc8 and *.xo8 file under `directory` and appends the usable ones to
+		//`found`, sorted by path. Returns how many were skipped as unusable.
+		size_t Scan(std::string const& directory, std::vector<RomInfo>& found);
+
+		bool LoadIndex(char const* filename);	//false if missing or another version, the library is unchanged then
+		bool SaveIndex(char const* filename) const;
+
+		std::vector<RomInfo> const& Roms() const { return roms; }
+		RomInfo const* Find(uint64_t hash) const;
+		size_t FilesRead() const { return filesRead; }		//index misses: ROMs that had to be opened and hashed
+
+		//Contents of a ROM, read once and shared by every caller. Thread safe. Null if the file
+		//no longer matches its entry.
+		std::shared_ptr<std::vector<uint8_t> const> Image(RomInfo const& rom);
+
+	private:
+		std::vector<RomInfo> roms;
+		std::unordered_map<std::string, size_t> byPath;		//index into roms
+		std::unordered_map<uint64_t, std::shared_ptr<std::vector<uint8_t> const>> images;	//by hash
+		std::mutex imageLock;
+		size_t filesRead{};
+};
+
+#endif
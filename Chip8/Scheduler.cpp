@@ -0,0 +1,77 @@
+#include "Scheduler.h"
+#include "Chip8.h"
+#include "ExtendedChip8.h"
+#include <thread>
+
+const std::chrono::steady_clock::duration FRAME_PERIOD =
+	std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / FRAME_RATE));
+const int MAX_FRAMES_BEHIND = 5;	//after a stall (debugger, window drag) resync rather than run a burst
+
+Scheduler::Scheduler(unsigned int instructionsPerFrame)
+	: instructionsPerFrame(instructionsPerFrame), nextFrame(Clock::now()), period(FRAME_PERIOD)
+{}
+
+//The beeper state is read before the tick: a sound timer set to 1 during the frame still sounds for it.
+template <typename Machine>
+bool Scheduler::RunFrame(Machine& machine)
+{
+	uint64_t skipped = idleSkip ? machine.SkipIdle(instructionsPerFrame) : 0;
+	machine.Run(instructionsPerFrame - skipped);
+	bool beeped = machine.SoundOn();
+	machine.TickTimers();
+	frames++;
+	return beeped;
+}
+
+template bool Scheduler::RunFrame(Chip8&);
+template bool Scheduler::RunFrame(SuperChip8&);
+template bool Scheduler::RunFrame(XoChip8&);
+
+//Deadlines advance by exactly one period so the average rate stays at 60hz even if a single
+//sleep overshoots. If we fall far behind, the schedule restarts from now.
+void Scheduler::WaitForNextFrame()
+{
+	skipped = 0;
+	if (turbo) {
+		nextFrame = Clock::now() + FRAME_PERIOD;	//next present 1/60s after this one finished, never a burst
+		return;
+	}
+
+	nextFrame += period;
+	Clock::time_point now = Clock::now();
+	if (now > nextFrame + period * MAX_FRAMES_BEHIND) {
+		nextFrame = now;
+		return;
+	}
+
+	std::this_thread::sleep_until(nextFrame);
+}
+
+void Scheduler::SetRateAdjust(double factor)
+{
+	period = std::chrono::duration_cast<Clock::duration>(FRAME_PERIOD * factor);
+}
+
+void Scheduler::Resync()
+{
+	nextFrame = Clock::now();
+}
+
+void Scheduler::SetTurbo(bool enabled, unsigned int skip)
+{
+	if (turbo && !enabled) {
+		nextFrame = Clock::now();	//back to real time from here, not from where turbo left the schedule
+	}
+	turbo = enabled;
+	frameSkip = skip;
+}
+
+bool Scheduler::PresentDue()
+{
+	skipped++;
+	if (frameSkip > 0) {
+		return skipped >= frameSkip;
+	}
+	//A guest frame takes well under a microsecond, so the clock is only read every 64 of them.
+	return (skipped % 64) == 0 && Clock::now() >= nextFrame;
+}
@@ -0,0 +1,56 @@
+//Paces emulation in 60hz frames. Every frame runs a fixed number of instructions and ticks
+//the delay/sound timers exactly once, so guest timers run at 60hz whatever the CPU rate is.
+
+#ifndef CHIP_8_SCHEDULER_H
+#define CHIP_8_SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+
+class Chip8;
+
+const unsigned int FRAME_RATE = 60;						//timer rate, also the render rate
+const unsigned int DEFAULT_INSTRUCTIONS_PER_FRAME = 10;	//600 instructions per second
+
+class Scheduler
+{
+	public:
+		explicit Scheduler(unsigned int instructionsPerFrame = DEFAULT_INSTRUCTIONS_PER_FRAME);
+
+		//One frame of guest time: instructions, then one timer tick. True if it beeped.
+		//Machine is Chip8, SuperChip8 or XoChip8 (ExtendedChip8.h).
+		template <typename Machine>
+		bool RunFrame(Machine& machine);
+		void WaitForNextFrame();		//sleeps until the next frame is due instead of spinning.
+
+		//Turbo: guest frames run back to back, each still ticking the timers once, so the guest
+		//sees normal time passing faster. A frame is shown every `frameSkip` guest frames, or with
+		//frameSkip 0, whenever 1/60s of wall time has passed. WaitForNextFrame() no longer sleeps.
+		void SetTurbo(bool enabled, unsigned int frameSkip = 0);
+		bool Turbo() const { return turbo; }
+		bool PresentDue();				//turbo only: call after each guest frame, true when one should be shown
+
+		//Idle loops (Chip8::SkipIdle) are skipped instead of executed. On by default, results are identical.
+		void SetIdleSkip(bool enabled) { idleSkip = enabled; }
+		//Stretches (above 1) or shrinks the real-time frame period, so an audio device's clock can pace emulation.
+		void SetRateAdjust(double factor);
+
+		void Resync();					//restart the 60hz schedule from now, e.g. after blocking on input
+
+		unsigned int InstructionsPerFrame() const { return instructionsPerFrame; }
+		uint64_t Frames() const { return frames; }
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		unsigned int instructionsPerFrame;
+		uint64_t frames{};
+		Clock::time_point nextFrame;
+		Clock::duration period;
+		bool turbo{};
+		bool idleSkip{ true };
+		unsigned int frameSkip{};
+		unsigned int skipped{};		//guest frames since the last one shown
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include "SdlAudio.h"
+#include <SDL.h>
+#include <algorithm>
+#include <cstring>
+
+const size_t RING_SAMPLES = 16384;		//about 370ms at 44100hz, far more than the rate control lets build up
+const uint16_t DEVICE_SAMPLES = 512;	//SDL's own buffer, about 12ms
+
+SdlAudio::SdlAudio()
+	: ring(RING_SAMPLES)
+{}
+
+SdlAudio::~SdlAudio()
+{
+	if (device != 0) {
+		SDL_CloseAudioDevice(device);
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+	}
+}
+
+bool SdlAudio::Open(unsigned int rate, size_t level)
+{
+	if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+		return false;
+	}
+
+	SDL_AudioSpec wanted{};
+	SDL_AudioSpec obtained{};
+	wanted.freq = (int)rate;
+	wanted.format = AUDIO_S16SYS;
+	wanted.channels = 1;
+	wanted.samples = DEVICE_SAMPLES;
+	wanted.callback = Callback;
+	wanted.userdata = this;
+
+	device = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+	if (device == 0) {
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+		return false;
+	}
+	sampleRate = (unsigned int)obtained.freq;
+	startLevel = std::min(level, ring.Capacity() / 2);
+	SDL_PauseAudioDevice(device, 0);	//the callback plays silence until startLevel is reached
+	return true;
+}
+
+void SdlAudio::Write(int16_t const* samples, size_t count)
+{
+	ring.Push(samples, count);
+}
+
+//SDL's audio thread. Never blocks: a short ring is padded with silence and playback pauses until
+//the emulation thread has refilled it, so one stall is one gap rather than crackling.
+void SdlAudio::Callback(void* self, uint8_t* stream, int length)
+{
+	SdlAudio& audio = *static_cast<SdlAudio*>(self);
+	int16_t* out = reinterpret_cast<int16_t*>(stream);
+	size_t wanted = (size_t)length / sizeof(int16_t);
+	size_t got = 0;
+
+	if (!audio.playing && audio.ring.Size() >= audio.startLevel) {
+		audio.playing = true;
+	}
+	if (audio.playing) {
+		got = audio.ring.Pop(out, wanted);
+		if (got < wanted) {
+			audio.playing = false;
+			audio.underruns.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	std::memset(out + got, 0, (wanted - got) * sizeof(int16_t));
+}
@@ -0,0 +1,43 @@
+//The sound card end of Audio.h. Beeper writes from the emulation thread, SDL's audio thread
+//pulls from its callback, and a lock-free RingBuffer sits between them so neither side waits.
+
+#ifndef CHIP_8_SDL_AUDIO_H
+#define CHIP_8_SDL_AUDIO_H
+
+#include "Audio.h"
+#include "RingBuffer.h"
+#include <atomic>
+#include <cstdint>
+
+class SdlAudio : public AudioSink
+{
+	public:
+		SdlAudio();
+		SdlAudio(SdlAudio const&) = delete;
+		SdlAudio& operator=(SdlAudio const&) = delete;
+		~SdlAudio() override;
+
+		//Opens the default device. It may pick another rate, SampleRate() is what the Beeper must use.
+		//Playback starts (and restarts after running dry) only once `startLevel` samples are queued.
+		bool Open(unsigned int sampleRate = DEFAULT_SAMPLE_RATE, size_t startLevel = DEFAULT_SAMPLE_RATE / 20);
+		unsigned int SampleRate() const { return sampleRate; }
+
+		void Write(int16_t const* samples, size_t count) override;	//whatever does not fit is dropped
+		size_t Buffered() const override { return ring.Size(); }
+		bool Realtime() const override { return true; }
+
+		uint64_t Underruns() const { return underruns.load(std::memory_order_relaxed); }
+
+	private:
+		static void Callback(void* self, uint8_t* stream, int length);
+
+		uint32_t device{};
+		unsigned int sampleRate{};
+		size_t startLevel{};
+		RingBuffer<int16_t> ring;
+
+		bool playing{};						//callback only
+		std::atomic<uint64_t> underruns{};	//callbacks that ran out mid-buffer
+};
+
+#endif
@@ -0,0 +1,37 @@
+//Save state: everything a Chip8 needs to continue exactly where it was, as one fixed-size POD.
+//Saving and restoring is a straight copy, so it is cheap enough to do every frame (rewind, fuzzing restarts).
+//Files are this struct written as-is (little-endian on every platform we build for).
+//Bump SNAPSHOT_VERSION whenever the layout changes; older files are then refused rather than misread.
+
+#ifndef CHIP_8_SNAPSHOT_H
+#define CHIP_8_SNAPSHOT_H
+
+#include "Chip8.h"
+#include <cstdint>
+#include <type_traits>
+
+const uint32_t SNAPSHOT_MAGIC = 0x53533843;		//"C8SS"
+const uint32_t SNAPSHOT_VERSION = 1;
+
+struct Snapshot
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t random;					//Random::state
+	uint16_t index;
+	uint16_t counter;
+	uint8_t registers[REGISTER_COUNT];
+	uint16_t stack[STACK_SIZE];
+	uint8_t sPtr;
+	uint8_t delay;
+	uint8_t sound;
+	uint8_t reserved[5];				//keeps the layout free of padding
+	uint8_t input[KEY_COUNT];
+	uint64_t display[VIDEO_HEIGHT];		//packed rows, as in Chip8::display
+	uint8_t memory[MEMORY_SIZE];
+};
+
+static_assert(std::is_trivially_copyable<Snapshot>::value, "Snapshot must stay plain data");
+static_assert(sizeof(Snapshot) == 4440, "Snapshot layout changed, bump SNAPSHOT_VERSION");
+
+#endif
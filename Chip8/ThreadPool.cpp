@@ -0,0 +1,100 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threads)
+{
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+	}
+	if (threads == 0) {
+		threads = 1;
+	}
+
+	for (unsigned int i = 0; i < threads; i++) {
+		queues.push_back(std::unique_ptr<Queue>(new Queue));
+	}
+	for (unsigned int i = 0; i < threads; i++) {
+		workers.emplace_back(&ThreadPool::Worker, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+//Tasks are dealt round-robin, stealing evens things out afterwards.
+void ThreadPool::Submit(std::function<void()> task)
+{
+	pending++;
+
+	Queue& queue = *queues[nextQueue++ % queues.size()];
+	{
+		std::lock_guard<std::mutex> guard(queue.lock);
+		queue.tasks.push_back(std::move(task));
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		queued++;
+	}
+	wake.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> guard(sleepLock);
+	finished.wait(guard, [this] { return pending == 0; });
+}
+
+//Own queue first (newest task, still warm in cache), then the oldest task of every other queue.
+bool ThreadPool::Take(unsigned int id, std::function<void()>& task)
+{
+	for (size_t i = 0; i < queues.size(); i++) {
+		Queue& queue = *queues[(id + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(queue.lock);
+
+		if (!queue.tasks.empty()) {
+			if (i == 0) {
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			} else {
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::Worker(unsigned int id)
+{
+	for (;;) {
+		std::function<void()> task;
+
+		if (Take(id, task)) {
+			task();
+
+			if (--pending == 0) {
+				std::lock_guard<std::mutex> guard(sleepLock);
+				finished.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(sleepLock);
+		wake.wait(guard, [this] { return stopping || queued > 0; });
+		if (stopping && queued == 0) {
+			return;
+		}
+	}
+}
@@ -0,0 +1,51 @@
+//Work-stealing thread pool used by the batch runner.
+//Each worker owns a queue and takes its own work from the back; when that is empty it steals
+//from the front of the other queues, so long and short tasks balance out across all cores.
+
+#ifndef CHIP_8_THREAD_POOL_H
+#define CHIP_8_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+	public:
+		explicit ThreadPool(unsigned int threads = 0);	//0 = one worker per hardware thread
+		~ThreadPool();
+
+		void Submit(std::function<void()> task);
+		void Wait();	//blocks until every submitted task has finished
+
+		unsigned int Threads() const { return (unsigned int)workers.size(); }
+
+	private:
+		struct Queue
+		{
+			std::mutex lock;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		void Worker(unsigned int id);
+		bool Take(unsigned int id, std::function<void()>& task);
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+
+		std::mutex sleepLock;
+		std::condition_variable wake;		//work was queued, or the pool is stopping
+		std::condition_variable finished;	//pending dropped to zero
+		std::atomic<size_t> queued{};		//tasks sitting in a queue
+		std::atomic<size_t> pending{};		//tasks submitted and not finished yet
+		std::atomic<unsigned int> nextQueue{};
+		bool stopping{};
+};
+
+#endif
@@ -0,0 +1,42 @@
+//Hands the newest value of something (a finished frame) from one thread to another without locks.
+//Three slots: the writer fills one, the reader holds one, and the third is the latest published.
+//Publishing swaps the writer's slot with that one, and the reader swaps it for its own only when
+//it is newer, so the writer never waits on the reader and the reader only ever skips stale values.
+
+#ifndef CHIP_8_TRIPLE_BUFFER_H
+#define CHIP_8_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer
+{
+	public:
+		T& Back() { return slots[back]; }		//writer: fill this, then Publish()
+		void Publish()
+		{
+			back = shared.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+		}
+
+		//Reader: true if a newer value was published since the last call, Front() is then that value.
+		bool Update()
+		{
+			if (!(shared.load(std::memory_order_relaxed) & FRESH)) {
+				return false;
+			}
+			front = shared.exchange(front, std::memory_order_acq_rel) & INDEX;
+			return true;
+		}
+		T const& Front() const { return slots[front]; }
+
+	private:
+		static const unsigned int INDEX = 3u;
+		static const unsigned int FRESH = 4u;	//set by Publish(), cleared by Update()
+
+		T slots[3]{};
+		unsigned int back{ 0 };						//writer only
+		unsigned int front{ 1 };					//reader only
+		std::atomic<unsigned int> shared{ 2 };		//the middle slot, plus FRESH
+};
+
+#endif
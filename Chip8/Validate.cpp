@@ -0,0 +1,459 @@
+//Runs every ROM in a directory on every core in lockstep with the table core (the reference)
+//and reports the first instruction count where any machine state, or the faults raised, differs.
+//SUPER-CHIP and XO-CHIP have no reference core, so they run small hand-assembled ROMs instead.
+
+#include "Chip8.h"
+#include "ExtendedChip8.h"
+#include "RomLibrary.h"
+#include "Snapshot.h"
+#include "WideChip8.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef CHIP8_ROM_DIR
+#define CHIP8_ROM_DIR "ROM Tests"
+#endif
+
+const uint64_t VALIDATE_INSTRUCTIONS = 2000000;
+const unsigned int VALIDATE_MAX_CHUNK = 64;	//instructions per Run() call before states are compared
+
+struct ValidateCore
+{
+	char const* name;
+	Chip8::Core core;
+	bool skipIdle;		//SkipIdle() before every chunk, which must not change the outcome
+};
+
+ValidateCore const validateCores[] = {
+	{ "switch", Chip8::Core::Switch, false },
+	{ "cached", Chip8::Core::Cached, false },
+	{ "jit", Chip8::Core::Jit, false },
+	{ "aot", Chip8::Core::Aot, false },
+	{ "idle", Chip8::Core::Switch, true },
+};
+
+//Random chunk sizes make block boundaries land everywhere, random key presses cover Ex9E/ExA1/Fx0A.
+static bool Validate(std::string const& path, ValidateCore const& candidate)
+{
+	Chip8 reference;
+	reference.SetCore(Chip8::Core::Table);
+	reference.LoadROM(path.c_str());
+
+	Chip8 machine = reference;		//copy, so both share the same RNG state
+	machine.SetCore(candidate.core);
+
+	std::mt19937 rng(1234);
+	uint64_t executed = 0;
+	while (executed < VALIDATE_INSTRUCTIONS) {
+		uint64_t chunk = 1 + rng() % VALIDATE_MAX_CHUNK;
+		reference.Run(chunk);
+		machine.Run(candidate.skipIdle ? chunk - machine.SkipIdle(chunk) : chunk);
+		executed += chunk;
+
+		//Timers only tick now and then, so delay-polling loops spin for many chunks before they exit
+		if (rng() % 8 == 0) {
+			reference.TickTimers();
+			machine.TickTimers();
+		}
+
+		if (rng() % 32 == 0) {
+			unsigned int key = rng() % KEY_COUNT;
+			uint8_t state = rng() % 2;
+			reference.input[key] = state;
+			machine.input[key] = state;
+		}
+
+		//Faults are taken every chunk, so one raised in a different chunk is a divergence too
+		if (!machine.SameState(reference) || machine.TakeFaults() != reference.TakeFaults()) {
+			std::printf("FAIL %-20s %-8s diverged within instructions %llu-%llu\n", path.c_str(), candidate.name,
+				(unsigned long long)(executed - chunk), (unsigned long long)executed);
+			return false;
+		}
+	}
+
+	std::printf("ok   %-20s %-8s %llu instructions\n", path.c_str(), candidate.name, (unsigned long long)executed);
+	return true;
+}
+
+//0x200 RET, 0x202 CALL 0x206, 0x204 0000 (no-op on a blank display), 0x206 RET
+uint8_t const stackRom[] = { 0x00, 0xEE, 0x22, 0x06, 0x00, 0x00, 0x00, 0xEE };
+
+struct StackCase
+{
+	char const* name;
+	uint8_t sPtr;				//depth to start from, with every stack slot holding 0x202
+	uint16_t counter;
+	uint8_t faults[3];			//expected from TakeFaults() after each of three instructions
+	uint16_t counters[3];		//and the program counter
+};
+
+StackCase const stackCases[] = {
+	//Underflow wraps the depth below 0; the CALL that brings it back is not an overflow
+	{ "underflow, call", 0, 0x200,
+		{ Chip8::FAULT_STACK_UNDERFLOW, 0, Chip8::FAULT_STACK_UNDERFLOW }, { 0x202, 0x206, 0x204 } },
+	//Overflow overwrites the oldest slot; the RET after it is not an underflow
+	{ "overflow, return", STACK_SIZE, 0x202,
+		{ Chip8::FAULT_STACK_OVERFLOW, 0, 0 }, { 0x206, 0x204, 0x206 } },
+};
+
+//The machine state a stack case starts from, taken from a machine with stackRom loaded.
+static Snapshot StackSnapshot(Chip8 const& machine, StackCase const& test)
+{
+	Snapshot snapshot;
+	machine.SaveState(snapshot);
+	snapshot.sPtr = test.sPtr;
+	snapshot.counter = test.counter;
+	for (uint16_t& slot : snapshot.stack) {
+		slot = 0x202;
+	}
+	return snapshot;
+}
+
+//Stack faults against fixed expectations rather than the table core, so a fault every core gets
+//wrong the same way is still caught. The states are set up through a snapshot.
+static bool ValidateStack(ValidateCore const& candidate)
+{
+	for (StackCase const& test : stackCases) {
+		Chip8 machine;
+		machine.SetCore(candidate.core);
+		machine.LoadROM(stackRom, sizeof(stackRom));
+		machine.LoadState(StackSnapshot(machine, test));
+
+		for (unsigned int step = 0; step < 3; step++) {
+			machine.Run(1);
+			uint8_t faults = machine.TakeFaults();
+			if (faults != test.faults[step] || machine.ProgramCounter() != test.counters[step]) {
+				std::printf("FAIL %-20s %-8s step %u: faults %u pc 0x%03X, expected faults %u pc 0x%03X\n", test.name,
+					candidate.name, step, faults, machine.ProgramCounter(), test.faults[step], test.counters[step]);
+				return false;
+			}
+		}
+	}
+
+	std::printf("ok   %-20s %-8s %zu cases\n", "stack faults", candidate.name, sizeof(stackCases) / sizeof(stackCases[0]));
+	return true;
+}
+
+//The stack cases in every lane of the wide core at once.
+static bool ValidateWideStack()
+{
+	static WideChip8 wide;		//too large for the stack
+	for (StackCase const& test : stackCases) {
+		Chip8 machine;
+		machine.LoadROM(stackRom, sizeof(stackRom));
+		Snapshot const snapshot = StackSnapshot(machine, test);
+
+		wide = WideChip8();
+		wide.LoadROM(stackRom, sizeof(stackRom));
+		for (unsigned int l = 0; l < WIDE_LANES; l++) {
+			wide.LoadState(l, snapshot);
+		}
+
+		for (unsigned int step = 0; step < 3; step++) {
+			wide.Run(1);
+			for (unsigned int l = 0; l < WIDE_LANES; l++) {
+				uint8_t faults = wide.TakeFaults(l);
+				if (faults != test.faults[step] || wide.ProgramCounter(l) != test.counters[step]) {
+					std::printf("FAIL %-20s %-8s lane %u step %u: faults %u pc 0x%03X, expected faults %u pc 0x%03X\n",
+						test.name, "wide", l, step, faults, wide.ProgramCounter(l), test.faults[step], test.counters[step]);
+					return false;
+				}
+			}
+		}
+	}
+
+	std::printf("ok   %-20s %-8s %zu cases x %u lanes\n", "stack faults", "wide", sizeof(stackCases) / sizeof(stackCases[0]),
+		WIDE_LANES);
+	return true;
+}
+
+//Fx29 then Dxy5 for every digit, 4 pixels apart along the top row, then a halt
+uint8_t const fontRom[] = {
+	0x60, 0x00, 0x61, 0x00, 0xF0, 0x29, 0xD1, 0x25, 0x70, 0x01, 0x71, 0x04, 0x30, 0x10, 0x12, 0x04, 0x12, 0x10,
+};
+
+//A new machine must start with the fontset at FONTSET_START: the table core is checked against the
+//fontset bytes themselves, every wide lane against the table core by drawing all 16 digits.
+static bool ValidateFontset()
+{
+	Chip8 machine;
+	Snapshot snapshot;
+	machine.SaveState(snapshot);
+	if (std::memcmp(&snapshot.memory[FONTSET_START], fontset, FONTSET_SIZE) != 0) {
+		std::printf("FAIL %-20s %-8s not at 0x%03X in a new machine\n", "fontset", "table", FONTSET_START);
+		return false;
+	}
+
+	static WideChip8 wide;		//too large for the stack
+	wide = WideChip8();
+	machine.SetCore(Chip8::Core::Table);
+	machine.LoadROM(fontRom, sizeof(fontRom));
+	wide.LoadROM(fontRom, sizeof(fontRom));
+	machine.Run(16 * 6);
+	wide.Run(16 * 6);
+	for (unsigned int l = 0; l < WIDE_LANES; l++) {
+		if (wide.DisplayHash(l) != machine.DisplayHash()) {
+			std::printf("FAIL %-20s %-8s lane %u draws different digits\n", "fontset", "wide", l);
+			return false;
+		}
+	}
+
+	std::printf("ok   %-20s %-8s 16 digits\n", "fontset", "wide");
+	return true;
+}
+
+struct PixelProbe
+{
+	unsigned int x, y;		//framebuffer pixel (128x64 in both modes), first plane
+	bool on;
+};
+
+struct RegisterProbe
+{
+	unsigned int i;
+	uint8_t value;
+};
+
+struct ExtendedCase
+{
+	char const* name;
+	RomProfile variant;			//SuperChip or XoChip
+	std::vector<uint8_t> rom;
+	uint64_t instructions;		//at most, the ROMs that end in 00FD stop there
+	unsigned int lit;			//framebuffer pixels set in the first plane
+	std::vector<PixelProbe> pixels;
+	std::vector<RegisterProbe> registers;
+	int index;					//expected I, or -1 for any
+	uint8_t faults;				//expected from TakeFaults()
+};
+
+//Sprites are drawn from I = 0x20C or 0x20E, right after the code. Lores cases start with 6200
+//where the hires ones have 00FF, so both share addresses.
+ExtendedCase const extendedCases[] = {
+	{ "hires Dxy0", RomProfile::SuperChip,
+		{ 0x00, 0xFF, 0xA2, 0x0C, 0x60, 0x00, 0x61, 0x00, 0xD0, 0x10, 0x00, 0xFD,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF },
+		100, 16 * 16, { { 15, 15, true }, { 16, 0, false }, { 0, 16, false } }, { { 0xF, 0 } }, -1, 0 },
+	{ "lores Dxy0", RomProfile::SuperChip,
+		{ 0x62, 0x00, 0xA2, 0x0C, 0x60, 0x00, 0x61, 0x00, 0xD0, 0x10, 0x00, 0xFD,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF },
+		100, 32 * 32, { { 31, 31, true }, { 32, 0, false }, { 0, 32, false } }, { { 0xF, 0 } }, -1, 0 },
+	//An 8 pixel row at x = 124: SUPER-CHIP drops what passes the edge, XO-CHIP wraps it
+	{ "hires clip", RomProfile::SuperChip,
+		{ 0x00, 0xFF, 0xA2, 0x0C, 0x60, 0x7C, 0x61, 0x00, 0xD0, 0x11, 0x00, 0xFD, 0xFF },
+		100, 4, { { 124, 0, true }, { 127, 0, true }, { 0, 0, false } }, {}, -1, 0 },
+	{ "hires wrap", RomProfile::XoChip,
+		{ 0x00, 0xFF, 0xA2, 0x0C, 0x60, 0x7C, 0x61, 0x00, 0xD0, 0x11, 0x00, 0xFD, 0xFF },
+		100, 8, { { 127, 0, true }, { 0, 0, true }, { 3, 0, true }, { 4, 0, false } }, {}, -1, 0 },
+	{ "lores clip", RomProfile::SuperChip,
+		{ 0x62, 0x00, 0xA2, 0x0C, 0x60, 0x3C, 0x61, 0x00, 0xD0, 0x11, 0x00, 0xFD, 0xFF },
+		100, 16, { { 120, 0, true }, { 127, 1, true }, { 0, 0, false } }, {}, -1, 0 },
+	//Scrolls of an 8 pixel row drawn at (V0, V1). The horizontal ones cross the middle word boundary.
+	{ "00C3 scroll down", RomProfile::SuperChip,
+		{ 0x00, 0xFF, 0xA2, 0x0E, 0x60, 0x00, 0x61, 0x00, 0xD0, 0x11, 0x00, 0xC3, 0x00, 0xFD, 0xFF },
+		100, 8, { { 0, 3, true }, { 7, 3, true }, { 0, 0, false } }, {}, -1, 0 },
+	{ "lores 00C1", RomProfile::SuperChip,
+		{ 0x62, 0x00, 0xA2, 0x0E, 0x60, 0x00, 0x61, 0x00, 0xD0, 0x11, 0x00, 0xC1, 0x00, 0xFD, 0xFF },
+		100, 32, { { 0, 2, true }, { 15, 3, true }, { 0, 1, false } }, {}, -1, 0 },
+	{ "00FB scroll right", RomProfile::SuperChip,
+		{ 0x00, 0xFF, 0xA2, 0x0E, 0x60, 0x3C, 0x61, 0x00, 0xD0, 0x11, 0x00, 0xFB, 0x00, 0xFD, 0xFF },
+		100, 8, { { 64, 0, true }, { 71, 0, true }, { 63, 0, false }, { 72, 0, false } }, {}, -1, 0 },
+	{ "00FC scroll left", RomProfile::SuperChip,
+		{ 0x00, 0xFF, 0xA2, 0x0E, 0x60, 0x40, 0x61, 0x00, 0xD0, 0x11, 0x00, 0xFC, 0x00, 0xFD, 0xFF },
+		100, 8, { { 60, 0, true }, { 67, 0, true }, { 59, 0, false }, { 68, 0, false } }, {}, -1, 0 },
+	{ "00D3 scroll up", RomProfile::XoChip,
+		{ 0x00, 0xFF, 0xA2, 0x0E, 0x60, 0x00, 0x61, 0x05, 0xD0, 0x11, 0x00, 0xD3, 0x00, 0xFD, 0xFF },
+		100, 8, { { 0, 2, true }, { 7, 2, true }, { 0, 5, false } }, {}, -1, 0 },
+	//3001 skips F000 1234 whole, were it only 2 bytes 1234 would run as a jump. Then I = 0xABC.
+	{ "F000 nnnn skip", RomProfile::XoChip,
+		{ 0x60, 0x01, 0x30, 0x01, 0xF0, 0x00, 0x12, 0x34, 0x61, 0x05, 0xF0, 0x00, 0x0A, 0xBC, 0x00, 0xFD },
+		100, 0, {}, { { 1, 0x05 } }, 0xABC, 0 },
+	//5022 saves V0-V2 at 0x300, 5203 loads them back in reverse (V2 from 0x300), I unchanged
+	{ "5xy2/5xy3", RomProfile::XoChip,
+		{ 0x60, 0x11, 0x61, 0x22, 0x62, 0x33, 0xA3, 0x00, 0x50, 0x22,
+		0x60, 0x00, 0x61, 0x00, 0x62, 0x00, 0x52, 0x03, 0x00, 0xFD },
+		100, 0, {}, { { 0, 0x33 }, { 1, 0x22 }, { 2, 0x11 } }, 0x300, 0 },
+	{ "Fx75/Fx85", RomProfile::SuperChip,
+		{ 0x60, 0x07, 0x61, 0x08, 0xF1, 0x75, 0x60, 0x00, 0x61, 0x00, 0xF1, 0x85, 0x00, 0xFD },
+		100, 0, {}, { { 0, 0x07 }, { 1, 0x08 } }, -1, 0 },
+	//Like Chip8's stack cases: 00EE on an empty stack, and a 17th nested 2200
+	{ "stack underflow", RomProfile::SuperChip, { 0x00, 0xEE }, 1, 0, {}, {}, -1, Chip8::FAULT_STACK_UNDERFLOW },
+	{ "stack overflow", RomProfile::XoChip, { 0x22, 0x00 }, STACK_SIZE, 0, {}, {}, -1, 0 },
+	{ "stack overflow", RomProfile::XoChip, { 0x22, 0x00 }, STACK_SIZE + 1, 0, {}, {}, -1, Chip8::FAULT_STACK_OVERFLOW },
+};
+
+template <typename Machine>
+static bool ValidateExtended(ExtendedCase const& test)
+{
+	std::unique_ptr<Machine> machine = std::make_unique<Machine>();	//XO-CHIP's 64 KB, too large for the stack
+	machine->LoadROM(test.rom.data(), test.rom.size());
+	machine->Run(test.instructions);
+
+	std::string failure;
+	unsigned int lit = 0;
+	for (auto const& row : machine->display[0]) {
+		for (uint64_t word : row) {
+			lit += (unsigned int)__builtin_popcountll(word);
+		}
+	}
+	if (lit != test.lit) {
+		failure = std::to_string(lit) + " pixels set, expected " + std::to_string(test.lit);
+	}
+	for (PixelProbe const& pixel : test.pixels) {
+		bool on = (machine->display[0][pixel.y][pixel.x / 64u] >> (63u - pixel.x % 64u)) & 1u;
+		if (on != pixel.on) {
+			failure = "pixel (" + std::to_string(pixel.x) + ", " + std::to_string(pixel.y) + ") " + (on ? "on" : "off");
+		}
+	}
+	for (RegisterProbe const& reg : test.registers) {
+		if (machine->Register(reg.i) != reg.value) {
+			failure = "V" + std::to_string(reg.i) + " = " + std::to_string(machine->Register(reg.i))
+				+ ", expected " + std::to_string(reg.value);
+		}
+	}
+	if (test.index >= 0 && machine->Index() != test.index) {
+		failure = "I = " + std::to_string(machine->Index()) + ", expected " + std::to_string(test.index);
+	}
+	uint8_t faults = machine->TakeFaults();
+	if (faults != test.faults) {
+		failure = "faults " + std::to_string(faults) + ", expected " + std::to_string(test.faults);
+	}
+
+	if (!failure.empty()) {
+		std::printf("FAIL %-20s %-8s %s\n", test.name, RomProfileName(test.variant), failure.c_str());
+		return false;
+	}
+	return true;
+}
+
+//Each case against fixed expectations: display, registers, I and faults after the ROM has run.
+static bool ValidateExtended()
+{
+	bool passed = true;
+	for (ExtendedCase const& test : extendedCases) {
+		if (test.variant == RomProfile::SuperChip) {
+			passed = ValidateExtended<SuperChip8>(test) && passed;
+		} else {
+			passed = ValidateExtended<XoChip8>(test) && passed;
+		}
+	}
+
+	if (passed) {
+		std::printf("ok   %-20s %-8s %zu cases\n", "extended", "schip/xo", sizeof(extendedCases) / sizeof(extendedCases[0]));
+	}
+	return passed;
+}
+
+//Every lane of the wide core against its own table-core machine with the same seed and keys.
+//Timers tick between chunks so Fx07 loops and key waits take different paths per lane.
+static bool ValidateWide(std::string const& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	static WideChip8 wide;		//too large for the stack
+	wide = WideChip8();
+	wide.LoadROM(rom.data(), rom.size());
+
+	std::vector<Chip8> lanes(WIDE_LANES);
+	for (unsigned int l = 0; l < WIDE_LANES; l++) {
+		lanes[l].SetCore(Chip8::Core::Table);
+		lanes[l].LoadROM(rom.data(), rom.size());
+		lanes[l].Seed(l + 1);
+		wide.Seed(l, l + 1);
+	}
+
+	std::mt19937 rng(1234);
+	uint64_t executed = 0;
+	while (executed < VALIDATE_INSTRUCTIONS / 8) {
+		uint64_t chunk = 1 + rng() % VALIDATE_MAX_CHUNK;
+		wide.Run(chunk);
+		wide.TickTimers();
+		executed += chunk;
+
+		for (unsigned int l = 0; l < WIDE_LANES; l++) {
+			Chip8& lane = lanes[l];
+			lane.Run(chunk);
+			lane.TickTimers();
+
+			if (rng() % 32 == 0) {
+				unsigned int key = rng() % KEY_COUNT;
+				uint8_t state = rng() % 2;
+				lane.input[key] = state;
+				wide.input[l][key] = state;
+			}
+
+			bool same = lane.ProgramCounter() == wide.ProgramCounter(l) && lane.Index() == wide.Index(l)
+				&& lane.DisplayHash() == wide.DisplayHash(l) && lane.TakeFaults() == wide.TakeFaults(l);
+			for (unsigned int i = 0; i < REGISTER_COUNT; i++) {
+				same = same && lane.Register(i) == wide.Register(l, i);
+			}
+			if (!same) {
+				std::printf("FAIL %-20s %-8s lane %u diverged within instructions %llu-%llu\n", path.c_str(), "wide", l,
+					(unsigned long long)(executed - chunk), (unsigned long long)executed);
+				return false;
+			}
+		}
+	}
+
+	std::printf("ok   %-20s %-8s %llu instructions x %u lanes (%s)\n", path.c_str(), "wide", (unsigned long long)executed,
+		WIDE_LANES, wide.UsingAvx2() ? "avx2" : "scalar");
+	return true;
+}
+
+//ARG consists of:
+//	Optional ROM directory (defaults to the one CMake points at)
+int main(int argc, char** argv)
+{
+	std::string romDir = (argc > 1) ? argv[1] : CHIP8_ROM_DIR;
+
+	std::vector<std::string> roms;
+	for (auto const& file : std::filesystem::directory_iterator(romDir)) {
+		if (file.path().extension() == ".ch8") {
+			roms.push_back(file.path().string());
+		}
+	}
+
+	int failures = 0;
+	if (!ValidateFontset()) {
+		failures++;
+	}
+	if (!ValidateStack(ValidateCore{ "table", Chip8::Core::Table, false })) {
+		failures++;
+	}
+	for (ValidateCore const& candidate : validateCores) {
+		if (!ValidateStack(candidate)) {
+			failures++;
+		}
+	}
+
+	if (!ValidateWideStack()) {
+		failures++;
+	}
+	if (!ValidateExtended()) {
+		failures++;
+	}
+
+	for (std::string const& rom : roms) {
+		for (ValidateCore const& candidate : validateCores) {
+			if (!Validate(rom, candidate)) {
+				failures++;
+			}
+		}
+		if (!ValidateWide(rom)) {
+			failures++;
+		}
+	}
+
+	return (failures == 0 && !roms.empty()) ? 0 : 1;
+}
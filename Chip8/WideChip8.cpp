@@ -0,0 +1,598 @@
+#include "WideChip8.h"
+#include <chrono>
+#include <cstring>
+
+//The AVX2 path is compiled for the function alone and only taken when the CPU has it,
+//so the binary still runs (on the scalar path) on older x86 and on other architectures.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(CHIP8_NO_AVX2)
+#define CHIP8_WIDE_AVX2
+#include <immintrin.h>
+#endif
+
+typedef uint32_t LaneMask;
+typedef uint8_t LaneRegisters[REGISTER_COUNT][WIDE_LANES];
+
+const LaneMask ALL_LANES = 0xFFFFFFFFu;
+
+static inline unsigned int FirstLane(LaneMask lanes)
+{
+#ifdef __GNUC__
+	return __builtin_ctz(lanes);
+#else
+	unsigned int lane = 0;
+	while (!(lanes & 1u)) {
+		lanes >>= 1;
+		lane++;
+	}
+	return lane;
+#endif
+}
+
+//Register opcodes one lane at a time, written exactly like RunSwitch. Reference for AluAvx2.
+//Returns the lanes that skip for 3xkk/4xkk/5xy0/9xy0.
+static LaneMask AluScalar(LaneRegisters& V, unsigned int op, LaneMask lanes)
+{
+	unsigned int x = (op >> 8u) & 0xFu;
+	unsigned int y = (op >> 4u) & 0xFu;
+	unsigned int kk = op & 0xFFu;
+	LaneMask skip = 0;
+
+	for (LaneMask m = lanes; m != 0; m &= m - 1) {
+		unsigned int l = FirstLane(m);
+
+		switch (op >> 12u)
+		{
+			case 0x3: skip |= (LaneMask)(V[x][l] == kk) << l; break;
+			case 0x4: skip |= (LaneMask)(V[x][l] != kk) << l; break;
+			case 0x5: skip |= (LaneMask)(V[x][l] == V[y][l]) << l; break;
+			case 0x9: skip |= (LaneMask)(V[x][l] != V[y][l]) << l; break;
+			case 0x6: V[x][l] = kk; break;
+			case 0x7: V[x][l] += kk; break;
+			case 0x8:
+				switch (op & 0xFu)
+				{
+					case 0x0: V[x][l] = V[y][l]; break;
+					case 0x1: V[x][l] |= V[y][l]; break;
+					case 0x2: V[x][l] &= V[y][l]; break;
+					case 0x3: V[x][l] ^= V[y][l]; break;
+					case 0x4:
+					{
+						unsigned int sum = V[x][l] + V[y][l];
+						V[0xF][l] = sum > 255u;
+						V[x][l] = sum & 0xFFu;
+					} break;
+					case 0x5:
+					{
+						V[0xF][l] = V[x][l] > V[y][l];
+						V[x][l] -= V[y][l];
+					} break;
+					case 0x6:
+					{
+						V[0xF][l] = V[x][l] & 0x1u;
+						V[x][l] >>= 1;
+					} break;
+					case 0x7:
+					{
+						V[0xF][l] = V[y][l] > V[x][l];
+						V[x][l] = V[y][l] - V[x][l];
+					} break;
+					case 0xE:
+					{
+						V[0xF][l] = (V[x][l] & 0x80u) >> 7u;
+						V[x][l] <<= 1;
+					} break;
+				}
+				break;
+		}
+	}
+
+	return skip;
+}
+
+#ifdef CHIP8_WIDE_AVX2
+//Same as AluScalar with one byte per lane: a register is a single __m256i and the lane mask
+//becomes a byte mask for blendv, so lanes outside `lanes` keep their values.
+__attribute__((target("avx2")))
+static LaneMask AluAvx2(LaneRegisters& V, unsigned int op, LaneMask lanes)
+{
+	unsigned int x = (op >> 8u) & 0xFu;
+	unsigned int y = (op >> 4u) & 0xFu;
+	__m256i* const R = reinterpret_cast<__m256i*>(V);
+
+	//Byte n of the mask is 0xFF when bit n of `lanes` is set.
+	const __m256i bits = _mm256_set1_epi64x(0x8040201008040201ll);
+	__m256i mask = _mm256_shuffle_epi8(_mm256_set1_epi32((int)lanes), _mm256_setr_epi8(
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+		2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3));
+	mask = _mm256_cmpeq_epi8(_mm256_and_si256(mask, bits), bits);
+
+	const __m256i one = _mm256_set1_epi8(1);
+	const __m256i kk = _mm256_set1_epi8((char)(op & 0xFFu));
+	__m256i vx = _mm256_load_si256(&R[x]);
+	__m256i vy = _mm256_load_si256(&R[y]);
+	__m256i flag;
+
+	switch (op >> 12u)
+	{
+		case 0x3: return (LaneMask)_mm256_movemask_epi8(_mm256_cmpeq_epi8(vx, kk)) & lanes;
+		case 0x4: return ~(LaneMask)_mm256_movemask_epi8(_mm256_cmpeq_epi8(vx, kk)) & lanes;
+		case 0x5: return (LaneMask)_mm256_movemask_epi8(_mm256_cmpeq_epi8(vx, vy)) & lanes;
+		case 0x9: return ~(LaneMask)_mm256_movemask_epi8(_mm256_cmpeq_epi8(vx, vy)) & lanes;
+		case 0x6: _mm256_store_si256(&R[x], _mm256_blendv_epi8(vx, kk, mask)); return 0;
+		case 0x7: _mm256_store_si256(&R[x], _mm256_blendv_epi8(vx, _mm256_add_epi8(vx, kk), mask)); return 0;
+		case 0x8: break;
+		default: return 0;
+	}
+
+	__m256i result;
+	switch (op & 0xFu)
+	{
+		case 0x0: result = vy; break;
+		case 0x1: result = _mm256_or_si256(vx, vy); break;
+		case 0x2: result = _mm256_and_si256(vx, vy); break;
+		case 0x3: result = _mm256_xor_si256(vx, vy); break;
+		case 0x4:
+		{
+			result = _mm256_add_epi8(vx, vy);	//carried out when the wrapped sum is below Vx
+			flag = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(result, vx), result), one);
+			_mm256_store_si256(&R[0xF], _mm256_blendv_epi8(_mm256_load_si256(&R[0xF]), flag, mask));
+		} break;
+
+		//VF is written first and may be Vx or Vy, so those are reloaded before the result is computed.
+		case 0x5:
+		{
+			flag = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(vx, vy), vy), one);	//Vx > Vy
+			_mm256_store_si256(&R[0xF], _mm256_blendv_epi8(_mm256_load_si256(&R[0xF]), flag, mask));
+			result = _mm256_sub_epi8(_mm256_load_si256(&R[x]), _mm256_load_si256(&R[y]));
+		} break;
+		case 0x6:
+		{
+			flag = _mm256_and_si256(vx, one);
+			_mm256_store_si256(&R[0xF], _mm256_blendv_epi8(_mm256_load_si256(&R[0xF]), flag, mask));
+			result = _mm256_and_si256(_mm256_srli_epi16(_mm256_load_si256(&R[x]), 1), _mm256_set1_epi8(0x7F));
+		} break;
+		case 0x7:
+		{
+			flag = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(vx, vy), vx), one);	//Vy > Vx
+			_mm256_store_si256(&R[0xF], _mm256_blendv_epi8(_mm256_load_si256(&R[0xF]), flag, mask));
+			result = _mm256_sub_epi8(_mm256_load_si256(&R[y]), _mm256_load_si256(&R[x]));
+		} break;
+		case 0xE:
+		{
+			flag = _mm256_and_si256(_mm256_srli_epi16(vx, 7), one);
+			_mm256_store_si256(&R[0xF], _mm256_blendv_epi8(_mm256_load_si256(&R[0xF]), flag, mask));
+			vx = _mm256_load_si256(&R[x]);
+			result = _mm256_add_epi8(vx, vx);
+		} break;
+		default: return 0;
+	}
+
+	vx = _mm256_load_si256(&R[x]);
+	_mm256_store_si256(&R[x], _mm256_blendv_epi8(vx, result, mask));
+	return 0;
+}
+
+//Lane n of the 16-lane half `half` is 0xFFFF when bit n of `lanes` is set.
+__attribute__((target("avx2")))
+static inline __m256i CounterMask(LaneMask lanes, unsigned int half)
+{
+	const __m256i bits = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, -32768);
+	__m256i mask = _mm256_set1_epi16((short)(lanes >> (16u * half)));
+	return _mm256_cmpeq_epi16(_mm256_and_si256(mask, bits), bits);
+}
+
+__attribute__((target("avx2")))
+static LaneMask LanesAtAvx2(uint16_t const* counter, uint16_t pc)
+{
+	__m256i target = _mm256_set1_epi16((short)pc);
+	__m256i low = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(counter)), target);
+	__m256i high = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(counter + 16)), target);
+	//packs interleaves the 128-bit halves, the permute puts lanes 0-31 back in order.
+	__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8);
+	return (LaneMask)_mm256_movemask_epi8(packed);
+}
+
+//Lowest counter among `lanes` (which must not be empty).
+__attribute__((target("avx2")))
+static uint16_t LowestCounterAvx2(uint16_t const* counter, LaneMask lanes)
+{
+	const __m256i all = _mm256_set1_epi16(-1);
+	__m256i low = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(counter)),
+		_mm256_andnot_si256(CounterMask(lanes, 0), all));
+	__m256i high = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(counter + 16)),
+		_mm256_andnot_si256(CounterMask(lanes, 1), all));
+	__m256i both = _mm256_min_epu16(low, high);
+	__m128i half = _mm_min_epu16(_mm256_castsi256_si128(both), _mm256_extracti128_si256(both, 1));
+	return (uint16_t)_mm_cvtsi128_si32(_mm_minpos_epu16(half));
+}
+
+//executed += 1 on the lanes in `lanes`. Returns the lanes that reached `target`.
+__attribute__((target("avx2")))
+static LaneMask AdvanceAvx2(uint32_t* executed, LaneMask lanes, uint32_t target)
+{
+	const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	LaneMask finished = 0;
+
+	for (unsigned int quarter = 0; quarter < 4; quarter++) {
+		__m256i* counts = reinterpret_cast<__m256i*>(executed + 8u * quarter);
+		__m256i mask = _mm256_set1_epi32((int)((lanes >> (8u * quarter)) & 0xFFu));
+		mask = _mm256_cmpeq_epi32(_mm256_and_si256(mask, bits), bits);
+
+		__m256i updated = _mm256_sub_epi32(_mm256_load_si256(counts), mask);	//mask lanes are -1
+		_mm256_store_si256(counts, updated);
+
+		__m256i done = _mm256_cmpeq_epi32(updated, _mm256_set1_epi32((int)target));
+		finished |= (LaneMask)_mm256_movemask_ps(_mm256_castsi256_ps(done)) << (8u * quarter);
+	}
+	return finished;
+}
+
+//counter = set ? value : counter + add, on the lanes in `lanes`.
+__attribute__((target("avx2")))
+static void UpdateCountersAvx2(uint16_t* counter, LaneMask lanes, bool set, uint16_t value)
+{
+	for (unsigned int half = 0; half < 2; half++) {
+		__m256i* pcs = reinterpret_cast<__m256i*>(counter + 16u * half);
+		__m256i current = _mm256_loadu_si256(pcs);
+		__m256i updated = set ? _mm256_set1_epi16((short)value) : _mm256_add_epi16(current, _mm256_set1_epi16((short)value));
+		_mm256_storeu_si256(pcs, _mm256_blendv_epi8(current, updated, CounterMask(lanes, half)));
+	}
+}
+#endif
+
+//Scalar versions of the counter sweeps above.
+static LaneMask LanesAtScalar(uint16_t const* counter, uint16_t pc)
+{
+	LaneMask lanes = 0;
+	for (unsigned int l = 0; l < WIDE_LANES; l++) {
+		lanes |= (LaneMask)(counter[l] == pc) << l;
+	}
+	return lanes;
+}
+
+static uint16_t LowestCounterScalar(uint16_t const* counter, LaneMask lanes)
+{
+	uint16_t lowest = 0xFFFF;
+	for (LaneMask m = lanes; m != 0; m &= m - 1) {
+		unsigned int l = FirstLane(m);
+		lowest = (counter[l] < lowest) ? counter[l] : lowest;
+	}
+	return lowest;
+}
+
+static LaneMask AdvanceScalar(uint32_t* executed, LaneMask lanes, uint32_t target)
+{
+	LaneMask finished = 0;
+	for (LaneMask m = lanes; m != 0; m &= m - 1) {
+		unsigned int l = FirstLane(m);
+		finished |= (LaneMask)(++executed[l] == target) << l;
+	}
+	return finished;
+}
+
+static void UpdateCountersScalar(uint16_t* counter, LaneMask lanes, bool set, uint16_t value)
+{
+	for (LaneMask m = lanes; m != 0; m &= m - 1) {
+		unsigned int l = FirstLane(m);
+		counter[l] = set ? value : counter[l] + value;
+	}
+}
+
+WideChip8::WideChip8()
+{
+	uint32_t seed = (uint32_t)std::chrono::system_clock::now().time_since_epoch().count();
+
+	for (unsigned int l = 0; l < WIDE_LANES; l++) {
+		counter[l] = START_ADDRESS;
+		std::memcpy(&memory[l][FONTSET_START], fontset, FONTSET_SIZE);
+		random[l].Seed(seed + l);
+	}
+
+#ifdef CHIP8_WIDE_AVX2
+	avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool WideChip8::LoadROM(uint8_t const* data, size_t size)
+{
+	if (size > MEMORY_SIZE - START_ADDRESS) {
+		return false;
+	}
+
+	for (unsigned int l = 0; l < WIDE_LANES; l++) {
+		std::memcpy(&memory[l][START_ADDRESS], data, size);
+	}
+	std::memset(written, 0, sizeof(written));
+	return true;
+}
+
+void WideChip8::Seed(unsigned int lane, uint32_t seed)
+{
+	random[lane].Seed(seed);
+}
+
+bool WideChip8::LoadState(unsigned int lane, Snapshot const& snapshot)
+{
+	if (snapshot.magic != SNAPSHOT_MAGIC || snapshot.version != SNAPSHOT_VERSION) {
+		return false;
+	}
+
+	for (unsigned int address = 0; address < MEMORY_SIZE; address++) {
+		written[address] |= (memory[lane][address] != snapshot.memory[address]);
+		memory[lane][address] = snapshot.memory[address];
+	}
+
+	random[lane].state = snapshot.random;
+	index[lane] = snapshot.index;
+	counter[lane] = snapshot.counter;
+	for (unsigned int i = 0; i < REGISTER_COUNT; i++) {
+		registers[i][lane] = snapshot.registers[i];
+	}
+	std::memcpy(stack[lane], snapshot.stack, sizeof(stack[lane]));
+	sPtr[lane] = snapshot.sPtr;
+	delay[lane] = snapshot.delay;
+	sound[lane] = snapshot.sound;
+	std::memcpy(input[lane], snapshot.input, sizeof(input[lane]));
+	std::memcpy(display[lane], snapshot.display, sizeof(display[lane]));
+	return true;
+}
+
+//Lanes execute in groups: every lane at the lowest program counter that still has budget left,
+//minus any whose (self-modified) opcode differs. Lanes may get ahead of each other in instruction
+//count, which lets lanes that branched apart meet again at the same address, and Run only returns
+//once every lane has executed exactly `cycles` instructions.
+//Addresses are masked to 12 bits so a runaway lane can never touch another lane's memory.
+void WideChip8::Run(uint64_t cycles)
+{
+	while (cycles > 0) {
+		uint32_t chunk = (cycles > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (uint32_t)cycles;
+		alignas(32) uint32_t executed[WIDE_LANES]{};
+		LaneMask pending = ALL_LANES;
+
+		while (pending != 0) {
+			uint16_t pc = counter[FirstLane(pending)];
+			LaneMask group = LanesAt(pc) & pending;
+			if (group != pending) {		//lanes have diverged
+				pc = LowestCounter(pending);
+				group = LanesAt(pc) & pending;
+			}
+			unsigned int lead = FirstLane(group);
+			unsigned int address = pc & (MEMORY_SIZE - 1u);
+			unsigned int next = (address + 1u) & (MEMORY_SIZE - 1u);
+			unsigned int op = (memory[lead][address] << 8u) | memory[lead][next];
+
+			if (written[address] | written[next]) {		//some lane stored here, its opcode may differ
+				for (LaneMask m = group; m != 0; m &= m - 1) {
+					unsigned int l = FirstLane(m);
+					if ((((unsigned int)memory[l][address] << 8u) | memory[l][next]) != op) {
+						group &= ~(1u << l);
+					}
+				}
+			}
+
+			Execute(op, group);
+			pending &= ~Advance(executed, group, chunk);
+		}
+
+		cycles -= chunk;
+	}
+}
+
+WideChip8::LaneMask WideChip8::LanesAt(uint16_t pc) const
+{
+#ifdef CHIP8_WIDE_AVX2
+	if (avx2) {
+		return LanesAtAvx2(counter, pc);
+	}
+#endif
+	return LanesAtScalar(counter, pc);
+}
+
+uint16_t WideChip8::LowestCounter(LaneMask lanes) const
+{
+#ifdef CHIP8_WIDE_AVX2
+	if (avx2) {
+		return LowestCounterAvx2(counter, lanes);
+	}
+#endif
+	return LowestCounterScalar(counter, lanes);
+}
+
+WideChip8::LaneMask WideChip8::Advance(uint32_t* executed, LaneMask lanes, uint32_t target) const
+{
+#ifdef CHIP8_WIDE_AVX2
+	if (avx2) {
+		return AdvanceAvx2(executed, lanes, target);
+	}
+#endif
+	return AdvanceScalar(executed, lanes, target);
+}
+
+void WideChip8::UpdateCounters(LaneMask lanes, bool set, uint16_t value)
+{
+#ifdef CHIP8_WIDE_AVX2
+	if (avx2) {
+		UpdateCountersAvx2(counter, lanes, set, value);
+		return;
+	}
+#endif
+	UpdateCountersScalar(counter, lanes, set, value);
+}
+
+void WideChip8::Execute(unsigned int op, LaneMask lanes)
+{
+	unsigned int x = (op >> 8u) & 0xFu;
+	unsigned int y = (op >> 4u) & 0xFu;
+	unsigned int kk = op & 0xFFu;
+	unsigned int nnn = op & 0xFFFu;
+	uint8_t* const Vx = registers[x];
+
+	UpdateCounters(lanes, false, 2);
+
+//Body runs once for every lane l in `lanes`.
+#define FOR_EACH_LANE(...)										\
+	for (LaneMask m = lanes; m != 0; m &= m - 1) {				\
+		unsigned int l = FirstLane(m);							\
+		__VA_ARGS__;											\
+	}
+
+	switch (op >> 12u)
+	{
+		case 0x0:
+			if ((op & 0xFu) == 0x0u) {			//00E0 CLS
+				FOR_EACH_LANE(std::memset(display[l], 0, sizeof(display[l])));
+			} else if ((op & 0xFu) == 0xEu) {	//00EE RET
+				FOR_EACH_LANE(faults[l] |= ((int8_t)sPtr[l] <= 0) * Chip8::FAULT_STACK_UNDERFLOW;
+					--sPtr[l]; counter[l] = stack[l][sPtr[l] & STACK_MASK]);
+			}
+			break;
+
+		case 0x1:								//JP nnn
+			UpdateCounters(lanes, true, nnn);
+			break;
+
+		case 0x2:								//CALL nnn
+			FOR_EACH_LANE(faults[l] |= ((int8_t)sPtr[l] >= (int)STACK_SIZE) * Chip8::FAULT_STACK_OVERFLOW;
+				stack[l][sPtr[l] & STACK_MASK] = counter[l]; ++sPtr[l]; counter[l] = nnn);
+			break;
+
+		case 0x3: case 0x4: case 0x5: case 0x6: case 0x7: case 0x8: case 0x9:
+		{
+#ifdef CHIP8_WIDE_AVX2
+			LaneMask skip = avx2 ? AluAvx2(registers, op, lanes) : AluScalar(registers, op, lanes);
+#else
+			LaneMask skip = AluScalar(registers, op, lanes);
+#endif
+			if (skip != 0) {
+				UpdateCounters(skip, false, 2);
+			}
+		} break;
+
+		case 0xA:								//LD I, nnn
+			FOR_EACH_LANE(index[l] = nnn);
+			break;
+
+		case 0xB:								//JP V0, nnn
+			FOR_EACH_LANE(counter[l] = nnn + registers[0x0][l]);
+			break;
+
+		case 0xC:								//RND Vx, byte
+			FOR_EACH_LANE(Vx[l] = random[l].NextByte() & kk);
+			break;
+
+		case 0xD:								//DRW Vx, Vy, nibble
+			FOR_EACH_LANE(DrawSprite(l, x, y, op & 0xFu));
+			break;
+
+		case 0xE:
+			if ((op & 0xFu) == 0xEu) {			//Ex9E SKP Vx
+				FOR_EACH_LANE(counter[l] += input[l][Vx[l] & KEY_MASK] ? 2 : 0);
+			} else if ((op & 0xFu) == 0x1u) {	//ExA1 SKNP Vx
+				FOR_EACH_LANE(counter[l] += input[l][Vx[l] & KEY_MASK] ? 0 : 2);
+			}
+			break;
+
+		case 0xF:
+			switch (kk)
+			{
+				case 0x07: FOR_EACH_LANE(Vx[l] = delay[l]); break;
+				case 0x0A:
+				{
+					FOR_EACH_LANE(
+						unsigned int key = 0;
+						while (key < KEY_COUNT && !input[l][key]) {
+							key++;
+						}
+						if (key < KEY_COUNT) {
+							Vx[l] = key;
+						} else {
+							counter[l] -= 2;
+						}
+					);
+				} break;
+				case 0x15: FOR_EACH_LANE(delay[l] = Vx[l]); break;
+				case 0x18: FOR_EACH_LANE(sound[l] = Vx[l]); break;
+				case 0x1E: FOR_EACH_LANE(index[l] += Vx[l]); break;
+				case 0x29: FOR_EACH_LANE(index[l] = FONTSET_START + (5 * Vx[l])); break;
+				case 0x33:
+				{
+					FOR_EACH_LANE(
+						uint8_t value = Vx[l];
+						uint8_t digits[3] = { (uint8_t)(value / 100), (uint8_t)((value / 10) % 10), (uint8_t)(value % 10) };
+						for (unsigned int i = 0; i < 3; i++) {
+							unsigned int address = (index[l] + i) & (MEMORY_SIZE - 1u);
+							memory[l][address] = digits[i];
+							written[address] = 1;
+						}
+					);
+				} break;
+				case 0x55:
+				{
+					FOR_EACH_LANE(
+						for (unsigned int i = 0; i <= x; i++) {
+							unsigned int address = (index[l] + i) & (MEMORY_SIZE - 1u);
+							memory[l][address] = registers[i][l];
+							written[address] = 1;
+						}
+					);
+				} break;
+				case 0x65:
+				{
+					FOR_EACH_LANE(
+						for (unsigned int i = 0; i <= x; i++) {
+							registers[i][l] = memory[l][(index[l] + i) & (MEMORY_SIZE - 1u)];
+						}
+					);
+				} break;
+			}
+			break;
+	}
+
+#undef FOR_EACH_LANE
+}
+
+void WideChip8::DrawSprite(unsigned int lane, uint8_t Vx, uint8_t Vy, uint8_t nBytes)
+{
+	unsigned int posX = registers[Vx][lane] % VIDEO_WIDTH;
+	unsigned int posY = registers[Vy][lane] % VIDEO_HEIGHT;
+	uint64_t collision = 0;
+
+	for (unsigned int row = 0; row < nBytes; row++) {
+		uint64_t spriteRow = (uint64_t)memory[lane][(index[lane] + row) & (MEMORY_SIZE - 1u)] << (VIDEO_WIDTH - 8u);
+		spriteRow = (spriteRow >> posX) | (spriteRow << ((VIDEO_WIDTH - posX) % VIDEO_WIDTH));
+
+		unsigned int y = (posY + row) % VIDEO_HEIGHT;
+		collision |= display[lane][y] & spriteRow;
+		display[lane][y] ^= spriteRow;
+	}
+
+	registers[0xF][lane] = (collision != 0);
+}
+
+void WideChip8::TickTimers()
+{
+	for (unsigned int l = 0; l < WIDE_LANES; l++) {
+		delay[l] -= (delay[l] > 0);
+		sound[l] -= (sound[l] > 0);
+	}
+}
+
+//Same FNV-1a as Chip8::DisplayHash, so lanes can be compared against scalar runs.
+uint64_t WideChip8::DisplayHash(unsigned int lane) const
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (uint64_t row : display[lane]) {
+		for (unsigned int i = 0; i < sizeof(row); i++) {
+			hash ^= (row >> (i * 8u)) & 0xFFu;
+			hash *= 0x100000001B3ull;
+		}
+	}
+	return hash;
+}
+
+uint8_t WideChip8::TakeFaults(unsigned int lane)
+{
+	uint8_t raised = faults[lane];
+	faults[lane] = 0;
+	return raised;
+}
@@ -0,0 +1,69 @@
+//Lockstep core that runs WIDE_LANES Chip8 machines at once, structure-of-arrays style.
+//Meant for seed sweeps: the same ROM in every lane, different Cxkk seeds and inputs.
+//
+//Lanes are grouped by program counter (and opcode, in case a lane modified its code), and a group
+//executes one opcode together: register ALU opcodes, skips and jumps run on all 32 lanes at once
+//with AVX2 vectors and a lane mask, everything else loops over the lanes in the mask.
+//Lanes that diverge form more, smaller groups; the lowest address always runs first so they meet again.
+//
+//Every lane behaves exactly like a Chip8 seeded with the same value and given the same input.
+
+#ifndef CHIP_8_WIDE_H
+#define CHIP_8_WIDE_H
+
+#include "Chip8.h"
+#include "Snapshot.h"
+#include <cstddef>
+#include <cstdint>
+
+const unsigned int WIDE_LANES = 32;		//one byte per lane in a 256-bit register
+
+class WideChip8
+{
+	public:
+		WideChip8();
+		bool LoadROM(uint8_t const* data, size_t size);	//same program in every lane, false (nothing loaded) like Chip8::LoadROM
+		void Seed(unsigned int lane, uint32_t seed);
+		bool LoadState(unsigned int lane, Snapshot const& snapshot);	//Chip8::LoadState for one lane
+
+		void Run(uint64_t cycles);	//every lane executes `cycles` instructions
+		void TickTimers();
+
+		bool UsingAvx2() const { return avx2; }
+
+		uint8_t Register(unsigned int lane, unsigned int i) const { return registers[i][lane]; }
+		uint16_t ProgramCounter(unsigned int lane) const { return counter[lane]; }
+		uint16_t Index(unsigned int lane) const { return index[lane]; }
+		uint64_t DisplayHash(unsigned int lane) const;
+		uint8_t TakeFaults(unsigned int lane);	//Chip8::TakeFaults for one lane
+
+		uint8_t input[WIDE_LANES][KEY_COUNT]{};
+
+	private:
+		typedef uint32_t LaneMask;	//bit n = lane n
+
+		void Execute(unsigned int op, LaneMask lanes);
+		LaneMask LanesAt(uint16_t pc) const;							//lanes whose counter is `pc`
+		uint16_t LowestCounter(LaneMask lanes) const;
+		LaneMask Advance(uint32_t* executed, LaneMask lanes, uint32_t target) const;	//count one instruction, returns finished lanes
+		void UpdateCounters(LaneMask lanes, bool set, uint16_t value);	//jump to `value`, or skip ahead by it
+		void DrawSprite(unsigned int lane, uint8_t Vx, uint8_t Vy, uint8_t nBytes);
+
+		alignas(32) uint8_t registers[REGISTER_COUNT][WIDE_LANES]{};	//registers[x] is one vector
+		uint16_t counter[WIDE_LANES]{};
+		uint16_t index[WIDE_LANES]{};
+		uint16_t stack[WIDE_LANES][STACK_SIZE]{};
+		uint8_t sPtr[WIDE_LANES]{};
+		uint8_t faults[WIDE_LANES]{};		//Chip8::Fault bits per lane
+		uint8_t delay[WIDE_LANES]{};
+		uint8_t sound[WIDE_LANES]{};
+		uint64_t display[WIDE_LANES][VIDEO_HEIGHT]{};
+		uint8_t memory[WIDE_LANES][MEMORY_SIZE]{};
+		uint8_t written[MEMORY_SIZE]{};		//set once any lane stores to the byte, until then every lane holds the ROM's copy
+
+		Random random[WIDE_LANES];
+
+		bool avx2{};		//picked once at construction from what the host CPU supports
+};
+
+#endif